@@ -71,11 +71,24 @@
   #include "src/button.h"
   #include "src/rotaryKnob.h"
   #include "src/softTimer.h"     // library of code to access the processor's clock functions
+  #include "src/taskScheduler.h" // library of code to run each job of the main loop at its own rate, by deadline
+  #include "src/displayPipeline.h"  // library of code to send only the changed parts of the screen, from the second core
+  #include "src/profiler.h"      // library of code to time each stage of the loop (compiles out if PROFILING_ON is false)
+  #include "src/traceRecorder.h" // library of code to keep a binary log of recent note events (compiles out if TRACE_ON is false)
+  #include "src/arpeggiator.h"   // library of code to choose which held note to arpeggiate next, and when
+  #include "src/midiInput.h"     // library of code to queue incoming MIDI and decode SysEx commands
+  #include "src/scanCalibration.h" // library of code to work out how long each part of the key matrix takes to settle
+  #include "src/looper.h"        // library of code to record notes into a fixed arena (or a file) and play them back on repeat
+  #include "src/wheelStream.h"   // library of code to glide the wheels along a curve and pace their messages to each port
+  #include "src/audioEffects.h"  // library of code for the synth's filter and delay / chorus, in integer math
+  #include "src/synthSettings.h" // the synth's effect settings and FM presets, shared with the host tools that render them
+  #include "src/fmVoice.h"       // library of code for a two-operator FM synth voice, in integer math
+  #include "src/sampler.h"       // library of code to play recorded samples straight out of flash, and to build the sample bank from WAV files
+  #include "src/powerManager.h"  // library of code to decide when the board is idle and can slow down
   #include "src/microtonal.h"
 
   #include <numeric>              // need that GCD function, son
   #include <string>               // standard C++ library string classes (use "std::string" to invoke it); these do not cause the memory corruption that Arduino::String does.
-  #include <queue>                // standard C++ library construction to store open channels in microtonal mode (use "std::queue" to invoke it)
 
 
 // @defaults
@@ -94,12 +107,19 @@
   byte modSticky = 0;
   byte pbSticky = 0;
   byte velSticky = 1;
-  int modWheelSpeed = 8;
+  int modWheelSpeed = 1024;
   int pbWheelSpeed = 1024;
   int velWheelSpeed = 8;
+  byte wheelCurveShape = WHEEL_CURVE_LINEAR;
+  byte wheelRouting = WHEEL_TO_CH1;
 
   byte playbackMode = SYNTH_OFF;
   byte currWave = WAVEFORM_HYBRID;
+  byte fmPresetIndex = 0;             // which FM voice, when the waveform is FM
+  byte filterMode = FILTER_OFF;
+  byte delayMode = DELAY_OFF;
+  byte layoutTurns = 0;               // x 60 degrees clockwise
+  byte layoutMirror = 0;
   byte colorMode = RAINBOW_MODE;
   byte animationType = ANIMATE_NONE;
   byte globalBrightness = BRIGHT_MID;
@@ -128,6 +148,26 @@
     loopTime = runTime;                                 // Update previousTime variable to give us a reference point for next loop
     runTime = getTheCurrentTime();   // Store the current time in a uniform variable for this program loop
   }
+  /*
+    The main loop's jobs are run by a scheduler
+    (see @mainLoop), each at its own rate.
+    The scheduler reads the time through this
+    clock so that it can be tried out on a computer
+    with a pretend one.
+  */
+  struct hardwareClock {
+    uint64_t now() {
+      return getTheCurrentTime();
+    }
+  };
+  hardwareClock mainClock;
+  taskScheduler tasks;
+  /*
+    Decides when the board is idle and can
+    run slower (see @power).
+  */
+  #define POWER_IDLE_AFTER 2000000      // microseconds of quiet before slowing down
+  powerPolicy power(POWER_IDLE_AFTER);
 
 // @fileSystem
   /*
@@ -137,6 +177,29 @@
     If so, this section might be relocated
   */
   #include "LittleFS.h"       // code to use flash drive space as a file system -- not implemented yet, as of May 2024
+  /*
+    The event trace (see src/traceRecorder.h) can be
+    saved to the file system, and then copied off
+    the board, or sent directly down the serial port.
+  */
+  #define TRACE_FILE "/trace.bin"
+  void saveTraceToFile() {
+    #if TRACE_ON
+    File f = LittleFS.open(TRACE_FILE, "w");
+    if (!f) {
+      sendToLog("could not open " TRACE_FILE " for writing");
+      return;
+    }
+    dumpTrace(f);
+    f.close();
+    sendToLog("event trace saved to " TRACE_FILE);
+    #endif
+  }
+  void sendTraceToSerial() {
+    #if TRACE_ON
+    dumpTrace(Serial);
+    #endif
+  }
   void setupFileSystem() {
     Serial.begin(115200);     // Set serial to make uploads work without bootsel button
     LittleFSConfig cfg;       // Configure file system defaults
@@ -200,7 +263,32 @@
     int16_t  bend = 0;            // in microtonal mode, the pitch bend for this note needed to be tuned correctly
     byte     MIDIch = 0;          // what MIDI channel this note is playing on
     byte     synthCh = 0;         // what synth polyphony ch this is playing on
+    byte     synthHeld = 0;       // refs this hex holds on its pitch's synth note: one each for the key, the looper and incoming MIDI
+    byte     MIDIin = 0;          // velocity of an incoming MIDI note mapped to this hex, 0 if none
+    byte     loopVelocity = 0;    // velocity, if the looper is playing this note
     float    frequency = 0.0;     // what frequency to ring on the synther
+    byte     pitchNum = 0;        // which entry in pitches[] this hex plays
+  };
+  /*
+    Isomorphic layouts put the same pitch on more than
+    one hex. Each distinct pitch gets an entry here
+    (built in applyLayout), which owns the MIDI channel
+    and note, and the synth voice, while any of its hexes
+    are sounding. A second hex with a pitch that is
+    already sounding shares them (copying them into its
+    own buttonDef, so it lights up and is found like any
+    other playing hex), and the note only stops when the
+    last of them lets go. So duplicates don't use up
+    channels or voices, and releasing one doesn't cut
+    off the other.
+  */
+  class pitchDef {
+  public:
+    byte     lead = 0;            // the first hex with this pitch; it stands for the pitch in the arpeggiator
+    byte     MIDIrefs = 0;        // hexes sounding this pitch over MIDI
+    byte     MIDIch = 0;
+    byte     synthRefs = 0;       // keys, looper notes and incoming MIDI notes sounding this pitch on the synth
+    byte     synthCh = 0;         // poly voice, if any
   };
   /*
     This class is like a virtual wheel.
@@ -217,11 +305,20 @@
     code, only needing to modify the
     range of output and the connected
     buttons to operate it.
+
+    The value glides to its target at
+    the chosen speed, along the chosen
+    curve (see src/wheelStream.h), and
+    is read off the curve each time the
+    wheels task runs (TASK_WHEELS_PERIOD).
+    Sending it over MIDI is paced
+    separately, per port.
   */
   class wheelDef {
   public:
     byte* alternateMode; // two ways to control
     byte* isSticky;      // TRUE if you leave value unchanged when no buttons pressed
+    byte* curve;         // shape of each glide, WHEEL_CURVE_*
     byte* topBtn;        // pointer to the key Status of the button you use as this button
     byte* midBtn;
     byte* botBtn;
@@ -231,11 +328,11 @@
     int16_t defValue;    // snapback value
     int16_t curValue;
     int16_t targetValue;
-    uint64_t timeLastChanged;
+    wheelGlide glide;
     void setTargetValue() {
       if (*alternateMode) {
         if (*midBtn >> 1) { // middle button toggles target (0) vs. step (1) mode
-          int16_t temp = curValue;
+          int16_t temp = targetValue;    // taps add up, even while the wheel is still gliding
               if (*topBtn == 1)     {temp += *stepValue;} // tap button
               if (*botBtn == 1)     {temp -= *stepValue;} // tap button
               if (temp > maxValue)  {temp  = maxValue;} 
@@ -263,23 +360,22 @@
         }
       }
     }
+    // returns TRUE if the value changed
     bool updateValue(uint64_t givenTime) {
-      int16_t temp = targetValue - curValue;
-      if (temp != 0) {
-        if ((givenTime - timeLastChanged) >= CC_MSG_COOLDOWN_MICROSECONDS ) {
-          timeLastChanged = givenTime;
-          if (abs(temp) < *stepValue) {
-            curValue = targetValue;
-          } else {
-            curValue = curValue + (*stepValue * (temp / abs(temp)));
-          }
-          return 1;
-        } else {
-          return 0;
+      if (targetValue != glide.target()) {
+        uint32_t distance = abs(targetValue - curValue);
+        uint32_t duration = 0;     // the fastest speed on the menu jumps straight there
+        if (*stepValue < (maxValue - minValue)) {
+          duration = distance * WHEEL_SPEED_MICROSECONDS / *stepValue;
         }
-      } else {
+        glide.moveTo(curValue, targetValue, givenTime, duration);
+      }
+      int16_t temp = glide.valueAt(givenTime, *curve);
+      if (temp == curValue) {
         return 0;
       }
+      curValue = temp;
+      return 1;
     }   
   };
   const byte mPin[] = { 
@@ -301,18 +397,20 @@
     button with the LED address = i.
   */
   buttonDef h[BTN_COUNT];
+  pitchDef pitches[BTN_COUNT];
+  byte pitchCount = 0;
   
-  wheelDef modWheel = { &wheelMode, &modSticky,
+  wheelDef modWheel = { &wheelMode, &modSticky, &wheelCurveShape,
     &h[assignCmd[4]].btnState, &h[assignCmd[5]].btnState, &h[assignCmd[6]].btnState,
-    0, 127, &modWheelSpeed, 0, 0, 0, 0
+    0, MOD_WHEEL_MAX, &modWheelSpeed, 0, 0, 0
   };
-  wheelDef pbWheel =  { &wheelMode, &pbSticky, 
+  wheelDef pbWheel =  { &wheelMode, &pbSticky, &wheelCurveShape,
     &h[assignCmd[4]].btnState, &h[assignCmd[5]].btnState, &h[assignCmd[6]].btnState,
-    -8192, 8191, &pbWheelSpeed, 0, 0, 0, 0
+    -8192, 8191, &pbWheelSpeed, 0, 0, 0
   };
-  wheelDef velWheel = { &wheelMode, &velSticky, 
+  wheelDef velWheel = { &wheelMode, &velSticky, &wheelCurveShape,
     &h[assignCmd[0]].btnState, &h[assignCmd[1]].btnState, &h[assignCmd[2]].btnState,
-    0, 127, &velWheelSpeed, 96, 96, 96, 0
+    0, 127, &velWheelSpeed, 96, 96, 96
   };
   
   bool toggleWheel = 0; // 0 for mod, 1 for pb
@@ -326,11 +424,148 @@
     }
     sendToLog("Pins mounted");
   }
+  /*
+    The key scan waits after each row change for the
+    column line to settle. That wait is now measured for
+    each column and group of rows (see src/scanCalibration.h)
+    rather than fixed at 14 microseconds everywhere.
+    The profile is measured the first time the HexBoard
+    boots (don't hold any keys down), saved to the file
+    system, and can be redone from the Advanced menu.
+    While the board is idle (see @power: nothing held,
+    sounding, looping or on screen), one column is
+    re-checked every few seconds in case the board has
+    got slower. The check has interrupts off for a few
+    milliseconds at a time, and saving the profile
+    stalls both cores while the flash is written, so
+    it has a low-priority task of its own, and a
+    changed profile is saved on a later run, if the
+    board is still idle.
+  */
+  #include "hardware/sync.h"      // library of code to briefly mask interrupts while shared data is changed
+  #define SCAN_CAL_FILE "/scan.cal"
+  #define SCAN_VERIFY_INTERVAL 4000000      // in microseconds
+  #define SCAN_VERIFY_BUDGET 10000          // one column, measured and confirmed
+  scanCalibration scanSettle(COLCOUNT, ROWCOUNT);
+  byte scanVerifyColumn = 0;
+  bool scanProfileUnsaved = false;
+  /*
+    This is the probe the calibration uses to reach
+    the matrix. It pulls a column low, as a pressed
+    key would, lets go, and times how long it takes
+    to read high again with a given row selected.
+  */
+  class matrixProbe {
+  public:
+    void selectRow(byte r) {
+      for (byte d = 0; d < 4; d++) {
+        digitalWrite(mPin[d], (r >> d) & 1);
+      }
+    }
+    void pullColumnLow(byte p) {
+      pinMode(p, OUTPUT);
+      digitalWrite(p, LOW);
+      delayMicroseconds(5);
+    }
+    uint16_t recoveryTime(byte c, byte r) {
+      byte p = cPin[c];
+      selectRow(r);
+      pullColumnLow(p);
+      uint32_t irq = save_and_disable_interrupts();
+      uint32_t start = timer_hw->timerawl;
+      uint32_t elapsed = 0;
+      pinMode(p, INPUT_PULLUP);
+      while (digitalRead(p) == LOW) {
+        elapsed = timer_hw->timerawl - start;
+        if (elapsed > SCAN_MAX_SETTLE * 4) {
+          elapsed = SCAN_CAL_STUCK;     // probably a key held down
+          break;
+        }
+      }
+      restore_interrupts(irq);
+      pinMode(p, INPUT);
+      return elapsed;
+    }
+    bool readsClean(byte c, byte r, byte settle) {
+      byte p = cPin[c];
+      selectRow(r);
+      pullColumnLow(p);
+      pinMode(p, INPUT_PULLUP);
+      delayMicroseconds(settle);
+      bool clean = (digitalRead(p) == HIGH);
+      pinMode(p, INPUT);
+      return clean;
+    }
+  };
+  matrixProbe scanProbe;
+
+  bool loadScanCalibration() {
+    File f = LittleFS.open(SCAN_CAL_FILE, "r");
+    if (!f) return false;
+    byte header[4];
+    byte table[COLCOUNT][SCAN_ROW_GROUPS];
+    bool ok = (f.read(header, 4) == 4)
+      && (header[0] == 'H') && (header[1] == SCAN_CAL_VERSION)
+      && (header[2] == COLCOUNT) && (header[3] == SCAN_ROW_GROUPS)
+      && (f.read((byte*)table, sizeof(table)) == sizeof(table));
+    f.close();
+    if (!ok) return false;
+    for (byte c = 0; c < COLCOUNT; c++) {
+      for (byte g = 0; g < SCAN_ROW_GROUPS; g++) {
+        if ((table[c][g] < SCAN_MIN_SETTLE) || (table[c][g] > SCAN_MAX_SETTLE)) return false;
+      }
+    }
+    memcpy(scanSettle.settle, table, sizeof(table));
+    return true;
+  }
+  void saveScanCalibration() {
+    File f = LittleFS.open(SCAN_CAL_FILE, "w");
+    if (!f) {
+      sendToLog("could not open " SCAN_CAL_FILE " for writing");
+      return;
+    }
+    byte header[4] = {'H', SCAN_CAL_VERSION, COLCOUNT, SCAN_ROW_GROUPS};
+    f.write(header, 4);
+    for (byte c = 0; c < COLCOUNT; c++) {
+      f.write(scanSettle.settle[c], SCAN_ROW_GROUPS);
+    }
+    f.close();
+  }
+  bool calibrateScan() {
+    bool ok = scanSettle.calibrate(scanProbe);
+    if (ok) {
+      saveScanCalibration();
+      sendToLog("scan calibrated: " + std::to_string(scanSettle.totalSettle()) + "us of settling per scan");
+    } else {
+      sendToLog("scan calibration stopped: a key seems to be held down");
+    }
+    return ok;
+  }
+  void setupScanCalibration() {
+    if (loadScanCalibration()) {
+      sendToLog("scan profile loaded: " + std::to_string(scanSettle.totalSettle()) + "us of settling per scan");
+    } else {
+      calibrateScan();
+    }
+  }
+  void verifyScanCalibration() {   // a task, every SCAN_VERIFY_INTERVAL
+    if (power.mode != POWER_IDLE) return;
+    if (scanProfileUnsaved) {
+      saveScanCalibration();
+      scanProfileUnsaved = false;
+      return;
+    }
+    if (scanSettle.verifyColumn(scanProbe, scanVerifyColumn)) {
+      scanProfileUnsaved = true;
+      sendToLog("scan column " + std::to_string(scanVerifyColumn) + " got slower; profile updated");
+    }
+    scanVerifyColumn = (scanVerifyColumn + 1) % COLCOUNT;
+  }
 
   void setupGrid() {
     for (byte i = 0; i < BTN_COUNT; i++) {
-      h[i].coordRow = (i / 10);
-      h[i].coordCol = (2 * (i % 10)) + (h[i].coordRow & 1);
+      h[i].coordRow = hexRow(i);
+      h[i].coordCol = hexCol(i);
       h[i].isCmd = 0;
       h[i].note = UNUSED_NOTE;
       h[i].btnState = 0;
@@ -494,26 +729,26 @@
       strip.setPixelColor(assignCmd[6], getLEDcode(tempColor));
     } else {
       // mod blue / yellow
-      tempSat = byteLerp(SAT_BW,SAT_VIVID,0,64,abs(modWheel.curValue - 63));
+      tempSat = byteLerp(SAT_BW,SAT_VIVID,0,8192,abs(modWheel.curValue - 8191));
       tempColor = {
-        (float)((modWheel.curValue > 63) ? HUE_YELLOW : HUE_INDIGO), 
+        (float)((modWheel.curValue > 8191) ? HUE_YELLOW : HUE_INDIGO), 
         tempSat, 
         (byte)(127 + (tempSat / 2))
       };
       strip.setPixelColor(assignCmd[6], getLEDcode(tempColor));
 
-      if (modWheel.curValue <= 63) {
+      if (modWheel.curValue <= 8191) {
         tempColor.val = 127 - (tempSat / 2);
       }
       strip.setPixelColor(assignCmd[5], getLEDcode(tempColor));
       
-      tempColor.val = tempSat * (modWheel.curValue > 63);
+      tempColor.val = tempSat * (modWheel.curValue > 8191);
       strip.setPixelColor(assignCmd[4], getLEDcode(tempColor));
     }
   }
   uint32_t applyNotePixelColor(byte x) {
            if (h[x].animate) { return h[x].LEDcodeAnim;
-    } else if (h[x].MIDIch)  { return h[x].LEDcodePlay;
+    } else if (h[x].MIDIch || h[x].MIDIin) { return h[x].LEDcodePlay;
     } else if (h[x].inScale) { return h[x].LEDcodeRest;
     } else if (scaleLock)    { return h[x].LEDcodeOff;
     } else                   { return h[x].LEDcodeDim;
@@ -562,7 +797,7 @@
   // What program change number we last sent (General MIDI/Roland MT-32)
   byte programChange = 0;
 
-  std::queue<byte> MPEchQueue;
+  channelQueue MPEchQueue;
   byte MPEpitchBendsNeeded; 
 
   float freqToMIDI(float Hz) {             // formula to convert from Hz to MIDI note
@@ -648,49 +883,192 @@
       if(midiD&MIDID_SER)SMIDI.sendControlChange(123, 0, i);
       setPitchBendRange(i, MPEpitchBendSemis);   
     }
+    resetWheelPorts();
   }
 
-  void sendMIDImodulationToCh1() {
-    if(midiD&MIDID_USB)UMIDI.sendControlChange(1, modWheel.curValue, 1);
-    if(midiD&MIDID_SER)SMIDI.sendControlChange(1, modWheel.curValue, 1);
-    sendToLog("sent mod value " + std::to_string(modWheel.curValue) + " to ch 1");
-  }
+  /*
+    The wheels go out to each port as fast as its byte
+    budget allows (see src/wheelStream.h), and only when
+    what a channel was last sent is out of date.
+
+    Normally they go to channel 1. With "Wheels to: Per
+    note", and notes on channels of their own (MPE), each
+    channel with a note held gets them instead, for synths
+    that don't follow the MPE master channel: modulation
+    as it is, and pitch bend added to the bend that tunes
+    the note. A note starting on a channel gets the wheels
+    along with it.
+  */
+  #define WHEEL_PORT_USB 0
+  #define WHEEL_PORT_SER 1
+  struct wheelPort {
+    byte port;                  // MIDID_USB or MIDID_SER
+    byteBudget budget;
+    int16_t modSent[16];        // by channel
+    int16_t bendSent[16];
+  };
+  wheelPort wheelOut[] = {
+    { MIDID_USB, byteBudget(WHEEL_USB_BYTES_PER_SECOND, WHEEL_BURST_BYTES) },
+    { MIDID_SER, byteBudget(WHEEL_SER_BYTES_PER_SECOND, WHEEL_BURST_BYTES) }
+  };
 
-  void sendMIDIpitchBendToCh1() {
-    if(midiD&MIDID_USB)UMIDI.sendPitchBend(pbWheel.curValue, 1);
-    if(midiD&MIDID_SER)SMIDI.sendPitchBend(pbWheel.curValue, 1);
-    sendToLog("sent pb wheel value " + std::to_string(pbWheel.curValue) + " to ch 1");
+  // run when what the receivers last got is unknown
+  void resetWheelPorts() {
+    for (byte p = 0; p < 2; p++) {
+      for (byte c = 0; c < 16; c++) {
+        wheelOut[p].modSent[c] = CC14_NEVER_SENT;
+        wheelOut[p].bendSent[c] = PITCH_BEND_NEVER_SENT;
+      }
+    }
+  }
+  bool wheelsPerNote() {
+    return (wheelRouting == WHEEL_PER_NOTE) && (MPEpitchBendsNeeded > 1);
+  }
+  // pitch bend for a note's channel, with the wheel added in
+  int16_t bendWithWheel(int16_t noteBend) {
+    int32_t b = noteBend + ((int32_t)pbWheel.curValue * PITCH_BEND_SEMIS) / MPEpitchBendSemis;
+    return (b < -8192) ? -8192 : ((b > 8191) ? 8191 : b);
+  }
+  // channels 1-16 as bits 0-15, and the bend each channel's notes need
+  uint16_t channelsWithNotes(int16_t* bend) {
+    uint16_t chs = 0;
+    for (byte i = 0; i < BTN_COUNT; i++) {
+      if (h[i].MIDIch && !(h[i].isCmd)) {
+        chs |= (1u << (h[i].MIDIch - 1));
+        bend[h[i].MIDIch - 1] = h[i].bend;
+      }
+    }
+    return chs;
+  }
+  void sendCC(byte port, byte cc, byte value, byte ch) {
+    if (port == MIDID_USB) {
+      UMIDI.sendControlChange(cc, value, ch);
+    } else {
+      SMIDI.sendControlChange(cc, value, ch);
+    }
+  }
+  void sendBend(byte port, int16_t bend, byte ch) {
+    if (port == MIDID_USB) {
+      UMIDI.sendPitchBend(bend, ch);
+    } else {
+      SMIDI.sendPitchBend(bend, ch);
+    }
+  }
+  // CC 1 and CC 33 (top and bottom 7 bits), only the halves that changed
+  void sendModTo(byte p, byte ch) {
+    wheelPort& out = wheelOut[p];
+    byte parts = cc14Parts(out.modSent[ch - 1], modWheel.curValue);
+    if (parts & CC14_MSB) sendCC(out.port, 1, modWheel.curValue >> 7, ch);
+    if (parts & CC14_LSB) sendCC(out.port, 33, modWheel.curValue & 0x7F, ch);
+    out.modSent[ch - 1] = modWheel.curValue;
+  }
+  void sendBendTo(byte p, int16_t bend, byte ch) {
+    wheelPort& out = wheelOut[p];
+    if (out.bendSent[ch - 1] != bend) {
+      sendBend(out.port, bend, ch);
+      out.bendSent[ch - 1] = bend;
+    }
+  }
+
+  void sendMIDImodulation(byte p, uint64_t now) {
+    wheelPort& out = wheelOut[p];
+    if (!(midiD & out.port)) return;
+    int16_t bend[16];
+    uint16_t chs = (wheelsPerNote() ? channelsWithNotes(bend) : 1);
+    uint16_t bytes = 0;
+    for (byte c = 0; c < 16; c++) {
+      if ((chs >> c) & 1) bytes += cc14Bytes(cc14Parts(out.modSent[c], modWheel.curValue));
+    }
+    if (!bytes || !out.budget.spend(now, bytes)) return;
+    for (byte c = 0; c < 16; c++) {
+      if ((chs >> c) & 1) sendModTo(p, c + 1);
+    }
+  }
+  void sendMIDIpitchBend(byte p, uint64_t now) {
+    wheelPort& out = wheelOut[p];
+    if (!(midiD & out.port)) return;
+    int16_t bend[16];
+    bool perNote = wheelsPerNote();
+    uint16_t chs = (perNote ? channelsWithNotes(bend) : 1);
+    uint16_t bytes = 0;
+    for (byte c = 0; c < 16; c++) {
+      if ((chs >> c) & 1) {
+        bend[c] = (perNote ? bendWithWheel(bend[c]) : pbWheel.curValue);
+        if (bend[c] != out.bendSent[c]) bytes += 3;
+      }
+    }
+    if (!bytes || !out.budget.spend(now, bytes)) return;
+    for (byte c = 0; c < 16; c++) {
+      if ((chs >> c) & 1) sendBendTo(p, bend[c], c + 1);
+    }
+  }
+  void sendMIDIwheels(uint64_t now) {
+    for (byte p = 0; p < 2; p++) {
+      sendMIDImodulation(p, now);
+      sendMIDIpitchBend(p, now);
+    }
+  }
+  /*
+    The pitch bend (and, per note, the modulation) a
+    channel needs as a note starts on it. Channel 1 is
+    only used for notes when no retuning is needed, so
+    the wheel is all the bend it gets.
+  */
+  void sendNoteWheels(byte x, byte p) {
+    wheelPort& out = wheelOut[p];
+    if (!(midiD & out.port)) return;
+    byte ch = h[x].MIDIch;
+    int16_t bend = h[x].bend;
+    if (wheelsPerNote()) {
+      bend = bendWithWheel(bend);
+      out.budget.charge(getTheCurrentTime(), cc14Bytes(cc14Parts(out.modSent[ch - 1], modWheel.curValue)));
+      sendModTo(p, ch);
+    } else if (ch == 1) {
+      bend = pbWheel.curValue;
+    }
+    if (out.bendSent[ch - 1] != bend) {
+      out.budget.charge(getTheCurrentTime(), 3);
+    }
+    sendBendTo(p, bend, ch);
   }
   
+  /*
+    Note on / off happen in the middle of the key scan,
+    so they are traced in binary rather than logged as
+    text; see src/traceRecorder.h.
+  */
   void tryMIDInoteOn(byte x) {
     // this gets called on any non-command hex
     // that is not scale-locked.
     if (!(h[x].MIDIch)) {    
+      pitchDef& p = pitches[h[x].pitchNum];
+      if (p.MIDIrefs) {     // another hex is already playing this pitch; share its note
+        p.MIDIrefs++;
+        h[x].MIDIch = p.MIDIch;
+        return;
+      }
       if (MPEpitchBendsNeeded == 1) {
         h[x].MIDIch = 1;
       } else if (MPEpitchBendsNeeded <= 15) {
         h[x].MIDIch = 2 + positiveMod(h[x].stepsFromC, MPEpitchBendsNeeded);
       } else {
         if (MPEchQueue.empty()) {   // if there aren't any open channels
-          sendToLog("MPE queue was empty so did not play a midi note");
+          TRACE(TRACE_DROPPED, TRACE_DROPPED_MIDI, x);
         } else {
           h[x].MIDIch = MPEchQueue.front();   // value in MIDI terms (1-16)
           MPEchQueue.pop();
-          sendToLog("popped " + std::to_string(h[x].MIDIch) + " off the MPE queue");
+          TRACE(TRACE_CH_ALLOC, h[x].MIDIch, x);
         }
       }
       if (h[x].MIDIch) {
-        if(midiD&MIDID_USB)UMIDI.sendNoteOn(h[x].note, velWheel.curValue, h[x].MIDIch); // ch 1-16
-        if(midiD&MIDID_SER)SMIDI.sendNoteOn(h[x].note, velWheel.curValue, h[x].MIDIch); // ch 1-16
-
-        if(midiD&MIDID_USB)UMIDI.sendPitchBend(h[x].bend, h[x].MIDIch); // ch 1-16
-        if(midiD&MIDID_SER)SMIDI.sendPitchBend(h[x].bend, h[x].MIDIch); // ch 1-16
-        sendToLog(
-          "sent MIDI noteOn: " + std::to_string(h[x].note) +
-          " pb "  + std::to_string(h[x].bend) +
-          " vel " + std::to_string(velWheel.curValue) +
-          " ch "  + std::to_string(h[x].MIDIch)
-        );
+        p.MIDIrefs = 1;
+        p.MIDIch = h[x].MIDIch;
+        byte velocity = (h[x].loopVelocity ? h[x].loopVelocity : velWheel.curValue);
+        if(midiD&MIDID_USB)UMIDI.sendNoteOn(h[x].note, velocity, h[x].MIDIch); // ch 1-16
+        sendNoteWheels(x, WHEEL_PORT_USB);
+        if(midiD&MIDID_SER)SMIDI.sendNoteOn(h[x].note, velocity, h[x].MIDIch); // ch 1-16
+        sendNoteWheels(x, WHEEL_PORT_SER);
+        TRACE(TRACE_MIDI_ON, h[x].note, (h[x].MIDIch << 8) | velocity);
       } 
     }
   } 
@@ -699,26 +1077,125 @@
     // this gets called on any non-command hex
     // that is not scale-locked.
     if (h[x].MIDIch) {    // but just in case, check
+      pitchDef& p = pitches[h[x].pitchNum];
+      if (p.MIDIrefs > 1) {   // another hex is still playing this pitch
+        p.MIDIrefs--;
+        h[x].MIDIch = 0;
+        return;
+      }
+      p.MIDIrefs = 0;
       if(midiD&MIDID_USB)UMIDI.sendNoteOff(h[x].note, velWheel.curValue, h[x].MIDIch);
       if(midiD&MIDID_SER)SMIDI.sendNoteOff(h[x].note, velWheel.curValue, h[x].MIDIch);
-      sendToLog(
-        "sent note off: " + std::to_string(h[x].note) +
-        " pb " + std::to_string(h[x].bend) +
-        " vel " + std::to_string(velWheel.curValue) +
-        " ch " + std::to_string(h[x].MIDIch)
-      );
+      TRACE(TRACE_MIDI_OFF, h[x].note, (h[x].MIDIch << 8) | velWheel.curValue);
       if (MPEpitchBendsNeeded > 15) {
         MPEchQueue.push(h[x].MIDIch);
-        sendToLog("pushed " + std::to_string(h[x].MIDIch) + " on the MPE queue");
+        TRACE(TRACE_CH_FREE, h[x].MIDIch, x);
       }
       h[x].MIDIch = 0;
     }
   }
 
+  /*
+    Incoming MIDI is handled once per loop, within a
+    fixed time budget so that a flood of input cannot
+    stall the key scan. First, messages are read from
+    both ports in turn and copied into a small queue
+    (src/midiInput.h); then the queue is acted on.
+    Whatever doesn't fit waits in the library's buffer
+    (or the queue) until the next loop.
+
+    Clock, start, stop and continue are the exception:
+    they go straight to the arpeggiator as they are
+    read (see setupMIDI), because their timing matters.
+  */
+  #define MIDI_IN_TIME_BUDGET 400   // in microseconds per loop
+  midiInQueue midiIn;
+  noteToHexMap noteToHex;   // which hex an incoming note lights up, see buildNoteToHexIndex()
+
+  void readMIDI() {
+    uint64_t start = getTheCurrentTime();
+    bool more = true;
+    while (more && !midiIn.full() && (getTheCurrentTime() - start < MIDI_IN_TIME_BUDGET)) {
+      more = false;
+      if (UMIDI.read()) {
+        midiIn.pushMessage(UMIDI.getType(), UMIDI.getChannel(), UMIDI.getData1(), UMIDI.getData2(),
+          UMIDI.getSysExArray(), UMIDI.getSysExArrayLength());
+        more = true;
+      }
+      if (SMIDI.read()) {
+        midiIn.pushMessage(SMIDI.getType(), SMIDI.getChannel(), SMIDI.getData1(), SMIDI.getData2(),
+          SMIDI.getSysExArray(), SMIDI.getSysExArrayLength());
+        more = true;
+      }
+    }
+    midiInEvent e;
+    while ((getTheCurrentTime() - start < MIDI_IN_TIME_BUDGET) && midiIn.pop(e)) {
+      switch (e.type) {
+        case MIDI_IN_NOTE_ON:
+          receiveNoteOn(e.data1, e.data2);
+          break;
+        case MIDI_IN_NOTE_OFF:
+          receiveNoteOff(e.data1);
+          break;
+        case MIDI_IN_SYSEX: {
+          sysExCommand c;
+          if (midiIn.takeSysExCommand(e.data1, c)) {
+            receiveSysExCommand(c);
+          }
+          break;
+        }
+        default:
+          break;
+      }
+    }
+  }
+  /*
+    Incoming notes light up their hex (see applyNotePixelColor)
+    and play on the synth, but are not sent back out.
+    An incoming note takes a ref on its pitch's voice of
+    its own, just as a key does (see pitchDef), so if its
+    hex is also being pressed, the voice lasts until both
+    have let go, whichever goes first.
+  */
+  void receiveNoteOn(byte note, byte velocity) {
+    byte x = noteToHex.hexFor(note);
+    if (x == UNUSED_NOTE) return;
+    updatePower(POWER_BUSY_VOICES);   // back to full speed before it sounds
+    bool alreadyIn = h[x].MIDIin;
+    h[x].MIDIin = velocity;
+    if (!alreadyIn) {
+      trySynthNoteOn(x);
+    }
+  }
+  void receiveNoteOff(byte note) {
+    byte x = noteToHex.hexFor(note);
+    if ((x == UNUSED_NOTE) || !(h[x].MIDIin)) return;
+    h[x].MIDIin = 0;
+    trySynthNoteOff(x);
+  }
+  void releaseIncomingNotes() {
+    for (byte i = 0; i < BTN_COUNT; i++) {
+      if (h[i].MIDIin) {
+        h[i].MIDIin = 0;
+        trySynthNoteOff(i);
+      }
+    }
+  }
+
   void setupMIDI() {
     usb_midi.setStringDescriptor("HexBoard MIDI");  // Initialize MIDI, and listen to all MIDI channels
     UMIDI.begin(MIDI_CHANNEL_OMNI);                 // This will also call usb_midi's begin()
     SMIDI.begin(MIDI_CHANNEL_OMNI);
+    UMIDI.turnThruOff();                            // don't echo what we read back out
+    SMIDI.turnThruOff();
+    UMIDI.setHandleClock(receiveMIDIclock);
+    SMIDI.setHandleClock(receiveMIDIclock);
+    UMIDI.setHandleStart(receiveMIDIstart);
+    SMIDI.setHandleStart(receiveMIDIstart);
+    UMIDI.setHandleStop(receiveMIDIstop);
+    SMIDI.setHandleStop(receiveMIDIstop);
+    UMIDI.setHandleContinue(receiveMIDIcontinue);
+    SMIDI.setHandleContinue(receiveMIDIcontinue);
     resetTuningMIDI();
     sendToLog("setupMIDI okay");
   }
@@ -893,17 +1370,203 @@
     uint16_t ab = 0;
     uint16_t cd = 0;
     byte eq = 0;
+    fmVoice fm;             // the modulator, for the FM waveform
+    samplerVoice sample;    // the recording being played, for the sampler waveform
+    float frequency = 0;    // after pitch bend, so the sampler can pick a zone when the note starts
   };
   oscillator synth[POLYPHONY_LIMIT];          // maximum polyphony
-  std::queue<byte> synthChQueue;
+  channelQueue synthChQueue;
   const byte attenuation[] = {64,24,17,14,12,11,10,9,8}; // full volume in mono mode; equalized volume in poly.
 
   byte arpeggiatingNow = UNUSED_NOTE;         // if this is 255, set to off (0% duty cycle)
-  uint64_t arpeggiateTime = 0;                // Used to keep track of when this note started playing in ARPEG mode
-  uint64_t arpeggiateLength = 65536;         // in microseconds. approx a 1/32 note at 114 BPM
+  /*
+    The mix can be run through a low-pass filter and
+    then a chorus or echo (see src/audioEffects.h),
+    which take the edge off the raw waveforms on the
+    headphone jack. The mod wheel closes the filter:
+    at rest it is wide open, at the top it is dark.
+
+    The delay buffer is the biggest thing in RAM. It is
+    taken from the heap once, at start-up, as the largest
+    power of 2 that leaves FX_HEAP_RESERVE free, up to
+    FX_DELAY_MAX_SAMPLES (about 0.8 seconds at this sample
+    rate); an echo longer than the buffer is shortened to
+    fit. If there isn't room even for a chorus, the delay
+    stays off. The settings of each effect are in
+    src/synthSettings.h.
+  */
+  #define FX_SAMPLE_RATE (1000000.0 / POLL_INTERVAL_IN_MICROSECONDS)
+  #define FX_HEAP_RESERVE 49152       // bytes left for files, the menu and the sample importer
+  svFilter synthFilter;
+  delayLine synthDelay;
+  /*
+    The FM waveform (see src/fmVoice.h) has a few
+    voices to choose from; each sets the modulator's
+    frequency ratio and how the brightness settles
+    after the start of a note. Settling by 1/2^n per
+    sample takes about 2^n samples, so 12 is about a
+    tenth of a second. The mod wheel brightens the
+    sound on top of that, up to FM_WHEEL_INDEX. The
+    presets are in src/synthSettings.h.
+  */
+  // copied from the chosen preset and the mod wheel, for the synth interrupt
+  volatile uint16_t fmRestIndex = fmPresets[0].restIndex;
+  volatile byte fmSettle = fmPresets[0].settle;
+  volatile uint16_t fmWheelIndex = 0;
+  /*
+    The sampler waveform (see src/sampler.h) plays a bank
+    of recordings kept in the flash between the end of the
+    firmware and the start of the file system, up to
+    SAMPLER_BANK_BYTES of it. The voices read it through
+    the uncached alias of the flash, so streaming samples
+    doesn't push the program out of the XIP cache.
+
+    The bank is built by importing WAV files copied into
+    SAMPLE_FOLDER on the file system (LittleFS scatters a
+    file around its blocks, so each one is copied into the
+    bank in one run). A file that doesn't say its pitch is
+    taken to be the MIDI note at the end of its name, e.g.
+    "piano_60.wav", or middle C if there isn't one.
+
+    Flash can't be read while it is being written, so the
+    second core is paused, interrupts are off, and the
+    synth is silenced for the import.
+  */
+  #include "hardware/flash.h"     // library of code to erase and program the flash chip
+  #define SAMPLER_BANK_BYTES (4 * 1024 * 1024)
+  #define SAMPLE_FOLDER "/samples"
+  #define SAMPLE_DEFAULT_NOTE 60
+  extern "C" uint8_t _FS_start;
+  extern "C" uint8_t __flash_binary_end;
+  sampleBank sampleSet;
+  uint32_t sampleBankStart = 0;    // offset into the flash chip; 0 = no room
+  uint32_t sampleBankSize = 0;
+  byte sampleImportResult = 0;     // 0 = fine, else how many files were skipped
+
+  struct sampleFlashWriter {
+    bool erase(uint32_t offset, uint32_t bytes) {
+      if ((uint64_t)offset + bytes > sampleBankSize) return false;
+      rp2040.idleOtherCore();
+      noInterrupts();
+      flash_range_erase(sampleBankStart + offset, bytes);
+      interrupts();
+      rp2040.resumeOtherCore();
+      return true;
+    }
+    bool program(uint32_t offset, const uint8_t* data, uint32_t bytes) {
+      if ((uint64_t)offset + bytes > sampleBankSize) return false;
+      rp2040.idleOtherCore();
+      noInterrupts();
+      flash_range_program(sampleBankStart + offset, data, bytes);
+      interrupts();
+      rp2040.resumeOtherCore();
+      return true;
+    }
+  };
+  // a LittleFS file, as the bank builder wants to read it
+  struct sampleFileReader {
+    File f;
+    uint32_t read(uint8_t* buffer, uint32_t bytes) {
+      return f.read(buffer, bytes);
+    }
+    bool seek(uint32_t position) {
+      return f.seek(position);
+    }
+    uint32_t size() {
+      return f.size();
+    }
+  };
+
+  void attachSampleBank() {
+    sampleSet.attach((const uint8_t*)(uintptr_t)(XIP_NOCACHE_NOALLOC_BASE + sampleBankStart), sampleBankSize);
+  }
+  void setupSampler() {
+    uint32_t fsStart = (uintptr_t)&_FS_start - XIP_BASE;
+    uint32_t codeEnd = ((uintptr_t)&__flash_binary_end - XIP_BASE + FLASH_SECTOR_SIZE - 1) & ~(uint32_t)(FLASH_SECTOR_SIZE - 1);
+    if (fsStart < codeEnd + SAMPLER_SECTOR) return;   // no room between the firmware and the file system
+    sampleBankSize = fsStart - codeEnd;
+    if (sampleBankSize > SAMPLER_BANK_BYTES) sampleBankSize = SAMPLER_BANK_BYTES;
+    sampleBankStart = fsStart - sampleBankSize;
+    attachSampleBank();
+  }
+  // the MIDI note number at the end of a file name, before the extension
+  float sampleRootFromName(const std::string& name) {
+    size_t dot = name.rfind('.');
+    size_t end = (dot == std::string::npos) ? name.size() : dot;
+    size_t start = end;
+    while ((start > 0) && isdigit(name[start - 1])) --start;
+    byte note = SAMPLE_DEFAULT_NOTE;
+    if ((start < end) && (end - start <= 3)) {
+      int n = atoi(name.substr(start, end - start).c_str());
+      if (n < 128) note = n;
+    }
+    return 440.0 * exp2((note - 69) / 12.0);
+  }
+  bool isWavFile(const std::string& name) {
+    if (name.size() < 4) return false;
+    std::string ext = name.substr(name.size() - 4);
+    for (char& ch : ext) ch = tolower(ch);
+    return ext == ".wav";
+  }
+  /*
+    Rebuild the bank from the WAV files in SAMPLE_FOLDER,
+    in the order the file system lists them. Returns false
+    if there is nowhere to put the bank or nothing could
+    be imported.
+  */
+  bool importSamples() {
+    sampleImportResult = 0;
+    if (!sampleBankSize) return false;
+    resetSynthFreqs();
+    for (byte i = 0; i < POLYPHONY_LIMIT; i++) {
+      synth[i].sample.stop();
+    }
+    sampleSet.detach();
+    sampleFlashWriter flash;
+    sampleBankBuilder* builder = new sampleBankBuilder;   // only needed while importing
+    bool ok = builder->begin(flash, sampleBankSize);
+    Dir dir = LittleFS.openDir(SAMPLE_FOLDER);
+    while (ok && dir.next()) {
+      std::string name = dir.fileName().c_str();
+      if (!isWavFile(name)) continue;
+      sampleFileReader wav = { dir.openFile("r") };
+      if (!wav.f || !builder->add(wav, flash, sampleRootFromName(name))) {
+        ++sampleImportResult;
+        sendToLog(("could not import " + name).c_str());
+      }
+      wav.f.close();
+    }
+    ok = ok && builder->zoneCount() && builder->finish(flash);
+    delete builder;
+    attachSampleBank();
+    return ok;
+  }
+  /*
+    The arpeggiator steps are timed by their own
+    hardware alarm, whose interrupt runs on the
+    first core. Each step is scheduled at an
+    absolute time (the previous step plus one step
+    length), so steps don't drift or jitter with
+    how long the main loop takes.
+
+    The held notes (in src/arpeggiator.h) and the
+    mono synth voice are shared between the main
+    loop and that interrupt, so the main loop masks
+    interrupts briefly whenever it changes them.
+  */
+  #define ARP_ALARM_NUM 1
+  #define ARP_ALARM_IRQ TIMER_IRQ_1
+  #define ARP_MIN_LEAD_TIME 4     // in microseconds. an alarm set any closer than this might already be in the past
+  arpeggiator arp;
+  byte arpPattern = ARP_PATTERN_UP;
+  int arpBPM = 120;
+  byte arpDivision = 32;                      // steps per whole note, i.e. 1/32 notes
+  byte arpSync = ARP_SYNC_INTERNAL;
+  uint64_t arpNextStep = 0;                   // 0 = not scheduled
 
   // RUN ON CORE 2
   void poll() {
+    PROFILE_POLL_START(ALARM_NUM);
     hw_clear_bits(&timer_hw->intr, 1u << ALARM_NUM);
     timer_hw->alarm[ALARM_NUM] = getTheCurrentTime() + POLL_INTERVAL_IN_MICROSECONDS;
     uint32_t mix = 0;
@@ -911,6 +1574,7 @@
     uint16_t p;
     byte t;
     byte level = 0;
+    int8_t fetches = SAMPLER_FETCHES;   // shared by the sampler voices (see src/sampler.h)
     for (byte i = 0; i < POLYPHONY_LIMIT; i++) {
       if (synth[i].increment) {
         synth[i].counter += synth[i].increment; // should loop from 65536 -> 0        
@@ -919,7 +1583,7 @@
         switch (currWave) {
           case WAVEFORM_SAW:                                                            break;
           case WAVEFORM_TRIANGLE: p = 2 * ((p >> 15) ? p : (65535 - p));                break;
-          case WAVEFORM_SQUARE:   p = 0 - (p > (32768 - modWheel.curValue * 7 * 16));   break;
+          case WAVEFORM_SQUARE:   p = 0 - (p > (32768 - ((modWheel.curValue * 7) >> 3)));   break;
           case WAVEFORM_HYBRID:   if (t <= synth[i].a) {
                                     p = 0;
                                   } else if (t < synth[i].b) {
@@ -932,6 +1596,8 @@
           case WAVEFORM_SINE:     p = sine[t] << 8;                                   break;
           case WAVEFORM_STRINGS:  p = strings[t] << 8;                                break;
           case WAVEFORM_CLARINET: p = clarinet[t] << 8;                               break;
+          case WAVEFORM_FM:       p = synth[i].fm.next(p, fmRestIndex, fmSettle, fmWheelIndex);  break;
+          case WAVEFORM_SAMPLER:  p = synth[i].sample.next(fetches);                  break;
           default:                                                                  break;
         }
         mix += (p * synth[i].eq);  // P[16bit] * EQ[3bit] =[19bit]
@@ -941,9 +1607,17 @@
     }
     mix *= attenuation[(playbackMode == SYNTH_POLY) * voices]; // [19bit]*atten[6bit] = [25bit]
     mix *= velWheel.curValue; // [25bit]*vel[7bit]=[32bit], poly+ 
-    level = mix >> 24;  // [32bit] - [8bit] = [24bit]
+    if (synthFilter.bypass && synthDelay.bypass) {
+      level = mix >> 24;  // [32bit] - [8bit] = [24bit]
+    } else {
+      int32_t s = (int32_t)(mix >> 16) - 32768;    // [16bit] signed, silence = the bottom
+      if (!synthFilter.bypass) s = synthFilter.process(s);
+      if (!synthDelay.bypass)  s = synthDelay.process(s);
+      level = (fxClip(s) + 32768) >> 8;
+    }
     if(audioD&AUDIO_PIEZO)pwm_set_chan_level(PIEZO_SLICE, PIEZO_CHNL, level);
     if(audioD&AUDIO_AJACK)pwm_set_chan_level(AJACK_SLICE, AJACK_CHNL, level);
+    PROFILE_POLL_END(POLL_INTERVAL_IN_MICROSECONDS);
   }
   // RUN ON CORE 1
   byte isoTwoTwentySix(float f) {
@@ -981,6 +1655,13 @@
     synth[c].counter = 0;
     synth[c].increment = round(f * POLL_INTERVAL_IN_MICROSECONDS * 0.065536);   // cycle 0-65535 at resultant frequency
     synth[c].eq = isoTwoTwentySix(f);
+    synth[c].frequency = f;
+    if (currWave == WAVEFORM_SAMPLER) {
+      synth[c].sample.tune(f);
+    }
+    if (currWave == WAVEFORM_FM) {
+      synth[c].fm.tune(synth[c].increment, fmPresets[fmPresetIndex].ratio);
+    }
     if (currWave == WAVEFORM_HYBRID) {
       if (f < TRANSITION_SQUARE) {
         synth[c].b = 128;
@@ -1009,32 +1690,51 @@
     }
   }
 
-  // USE THIS IN MONO OR ARPEG MODE ONLY
-
-  byte findNextHeldNote() {
-    byte n = UNUSED_NOTE;
-    for (byte i = 1; i <= BTN_COUNT; i++) {
-      byte j = positiveMod(arpeggiatingNow + i, BTN_COUNT);
-      if ((h[j].MIDIch) && (!h[j].isCmd)) {
-        n = j;
-        break;
-      }
+  /*
+    Start an FM note bright, or a sample from the top;
+    the other waveforms don't change over a note.
+  */
+  void triggerSynthVoice(byte channel) {
+    if (currWave == WAVEFORM_FM) {
+      synth[channel - 1].fm.trigger(fmPresets[fmPresetIndex].peakIndex);
     }
-    return n;
+    if (currWave == WAVEFORM_SAMPLER) {
+      synth[channel - 1].sample.start(sampleSet, synth[channel - 1].frequency, FX_SAMPLE_RATE);
+    }
+  }
+  void applyFMpreset() {
+    fmRestIndex = fmPresets[fmPresetIndex].restIndex;
+    fmSettle = fmPresets[fmPresetIndex].settle;
+    resetSynthFreqs();
   }
+  void updateFMwheel() {
+    fmWheelIndex = ((uint32_t)modWheel.curValue * FM_WHEEL_INDEX) / MOD_WHEEL_MAX;
+  }
+
+  // USE THIS IN MONO OR ARPEG MODE ONLY
+
   void replaceMonoSynthWith(byte x) {
     if (arpeggiatingNow == x) return;
-    h[arpeggiatingNow].synthCh = 0;
+    if (arpeggiatingNow != UNUSED_NOTE) {
+      h[arpeggiatingNow].synthCh = 0;
+      TRACE(TRACE_VOICE_OFF, 1, arpeggiatingNow);
+    }
     arpeggiatingNow = x;
     if (arpeggiatingNow != UNUSED_NOTE) {
       h[arpeggiatingNow].synthCh = 1;
       setSynthFreq(h[arpeggiatingNow].frequency, 1);
+      triggerSynthVoice(1);
+      TRACE(TRACE_VOICE_ON, 1, arpeggiatingNow);
     } else {
       setSynthFreq(0, 1);
     }
   }
 
   void resetSynthFreqs() {
+    uint32_t irq = save_and_disable_interrupts();
+    arpNextStep = 0;
+    arpeggiatingNow = UNUSED_NOTE;
+    restore_interrupts(irq);
     while (!synthChQueue.empty()) {
       synthChQueue.pop();
     }
@@ -1044,12 +1744,14 @@
     }
     for (byte i = 0; i < BTN_COUNT; i++) {
       h[i].synthCh = 0;
+      pitches[i].synthCh = 0;
     }
     if (playbackMode == SYNTH_POLY) {
       for (byte i = 0; i < POLYPHONY_LIMIT; i++) {
         synthChQueue.push(i + 1);
       }
     }
+    restartArpeggiator();
   }
   void sendProgramChange() {
     if(midiD&MIDID_USB)UMIDI.sendProgramChange(programChange - 1, 1);
@@ -1057,8 +1759,7 @@
   }
   
   void updateSynthWithNewFreqs() {
-    if(midiD&MIDID_USB)UMIDI.sendPitchBend(pbWheel.curValue, 1);
-    if(midiD&MIDID_SER)SMIDI.sendPitchBend(pbWheel.curValue, 1);
+    uint32_t irq = save_and_disable_interrupts();   // so an arpeggiator step can't move the voice mid-update
     for (byte i = 0; i < BTN_COUNT; i++) {
       if (!(h[i].isCmd)) {
         if (h[i].synthCh) {
@@ -1066,44 +1767,140 @@
         }
       }
     }
+    restore_interrupts(irq);
   }
   
+  /*
+    The arpeggiator and mono synth see each pitch once,
+    by its lead hex (see pitchDef), however many of its
+    hexes are held.
+  */
   void trySynthNoteOn(byte x) {
+    pitchDef& p = pitches[h[x].pitchNum];
+    h[x].synthHeld++;
+    bool first = !(p.synthRefs++);
+    if (first && (h[x].MIDIch || h[x].MIDIin)) {
+      // held notes are tracked in every mode, so switching modes mid-chord works
+      uint32_t irq = save_and_disable_interrupts();
+      bool added = arp.add(p.lead, h[x].stepsFromC);
+      restore_interrupts(irq);
+      if (!added) {
+        TRACE(TRACE_DROPPED, TRACE_DROPPED_ARP, x);
+      }
+    }
     if (playbackMode != SYNTH_OFF) {
       if (playbackMode == SYNTH_POLY) {
         // operate independently of MIDI
-        if (synthChQueue.empty()) {
-          sendToLog("synth channels all firing, so did not add one");
+        if (p.synthCh) {
+          h[x].synthCh = p.synthCh;     // share the voice another hex is playing this pitch on
+        } else if (synthChQueue.empty()) {
+          TRACE(TRACE_DROPPED, TRACE_DROPPED_SYNTH, x);
         } else {
           h[x].synthCh = synthChQueue.front();
           synthChQueue.pop();
-          sendToLog("popped " + std::to_string(h[x].synthCh) + " off the synth queue");
+          p.synthCh = h[x].synthCh;
           setSynthFreq(h[x].frequency, h[x].synthCh);
+          triggerSynthVoice(h[x].synthCh);
+          TRACE(TRACE_VOICE_ON, h[x].synthCh, x);
         }
-      } else {    
+      } else if (playbackMode == SYNTH_MONO) {
         // operate in lockstep with MIDI
-        if (h[x].MIDIch) {
-          replaceMonoSynthWith(x);
+        if (h[x].MIDIch || h[x].MIDIin) {
+          replaceMonoSynthWith(p.lead);
         }
       }
+      // in arpeggio mode, the note waits for its turn (see arpeggiatorStep)
     }
   }
 
   void trySynthNoteOff(byte x) {
-    if (playbackMode && (playbackMode != SYNTH_POLY)) {
-      if (arpeggiatingNow == x) {
-        replaceMonoSynthWith(findNextHeldNote());
+    if (!(h[x].synthHeld)) return;     // e.g. a key let go after applyLayout released its note
+    h[x].synthHeld--;
+    pitchDef& p = pitches[h[x].pitchNum];
+    if (p.synthRefs > 1) {     // another hex, or another source on this one, is still playing this pitch
+      p.synthRefs--;
+      if ((playbackMode == SYNTH_POLY) && !(h[x].synthHeld)) {
+        h[x].synthCh = 0;
+      }
+      return;
+    }
+    byte voice = (p.synthCh ? p.synthCh : h[x].synthCh);    // whichever hex started it, the voice belongs to the pitch
+    p.synthRefs = 0;
+    p.synthCh = 0;
+    uint32_t irq = save_and_disable_interrupts();
+    arp.remove(p.lead);
+    if (arpeggiatingNow == p.lead) {
+      if (playbackMode == SYNTH_MONO) {
+        replaceMonoSynthWith(arp.mostRecent());   // fall back to the last note still held
+      } else if (playbackMode == SYNTH_ARPEGGIO) {
+        replaceMonoSynthWith(UNUSED_NOTE);        // rest until the next step
       }
     }
+    restore_interrupts(irq);
     if (playbackMode == SYNTH_POLY) {
-      if (h[x].synthCh) {
-        setSynthFreq(0, h[x].synthCh);
-        synthChQueue.push(h[x].synthCh);
-        h[x].synthCh = 0;
+      if (voice) {
+        setSynthFreq(0, voice);
+        synthChQueue.push(voice);
+        TRACE(TRACE_VOICE_OFF, voice, x);
       }
+      h[x].synthCh = 0;
     }
   }
 
+  // filter cutoff follows the mod wheel
+  void updateFilterCutoff() {
+    float hz = FILTER_OPEN_HZ * exp2(log2(FILTER_CLOSED_HZ / FILTER_OPEN_HZ) * modWheel.curValue / MOD_WHEEL_MAX);
+    synthFilter.set(
+      round(FX_ONE * 2.0 * sin(PI * hz / FX_SAMPLE_RATE)),
+      (filterMode == FILTER_RESONANT) ? FILTER_RESONANT_DAMPING : FILTER_SOFT_DAMPING
+    );
+  }
+  /*
+    Run when either effect is changed via the menu.
+    The filter is switched off (bypass) while it is
+    cleared and changed. The delay takes its new
+    settings and clears its own buffer on the other
+    core (see src/audioEffects.h), so nothing here
+    writes to the buffer the synth interrupt reads.
+  */
+  void applyEffects() {
+    synthFilter.bypass = true;
+    synthFilter.clear();
+    updateFilterCutoff();
+    switch (delayMode) {
+      case DELAY_CHORUS:
+        synthDelay.setChorus(
+          round(CHORUS_CENTRE_MS * FX_SAMPLE_RATE / 1000.0),
+          round(CHORUS_DEPTH_MS * FX_SAMPLE_RATE / 1000.0),
+          round(CHORUS_RATE_HZ * 4294967296.0 / FX_SAMPLE_RATE),
+          CHORUS_WET);
+        break;
+      case DELAY_ECHO:
+        synthDelay.setEcho(round(ECHO_MS * FX_SAMPLE_RATE / 1000.0), ECHO_FEEDBACK, ECHO_WET);
+        break;
+      case DELAY_LONG_ECHO:
+        synthDelay.setEcho(round(LONG_ECHO_MS * FX_SAMPLE_RATE / 1000.0), LONG_ECHO_FEEDBACK, LONG_ECHO_WET);
+        break;
+      default:
+        break;
+    }
+    synthFilter.bypass = (filterMode == FILTER_OFF);
+    synthDelay.bypass = (delayMode == DELAY_OFF) || !synthDelay.samples();
+  }
+  void setupEffects() {
+    uint32_t heap = rp2040.getFreeHeap();
+    uint32_t room = (heap > FX_HEAP_RESERVE) ? (heap - FX_HEAP_RESERVE) / sizeof(int16_t) : 0;
+    uint32_t samples = FX_DELAY_MAX_SAMPLES;
+    while (samples > room) samples >>= 1;
+    int16_t* buffer = (samples >= FX_DELAY_MIN_SAMPLES) ? (int16_t*)malloc(samples * sizeof(int16_t)) : nullptr;
+    if (!buffer) {
+      sendToLog("effects: no room for the delay");
+      return;
+    }
+    synthDelay.begin(buffer, samples);   // kept for good
+    sendToLog("effects: delay of " + std::to_string(samples) + " samples");
+  }
+
   void setupSynth(byte pin, byte slice) {
     gpio_set_function(pin, GPIO_FUNC_PWM);      // set that pin as PWM
     pwm_set_phase_correct(slice, true);           // phase correct sounds better
@@ -1119,13 +1916,319 @@
     sendToLog("synth is ready.");
   }
 
-  void arpeggiate() {
-    if (playbackMode == SYNTH_ARPEGGIO) {
-      if (runTime - arpeggiateTime > arpeggiateLength) {
-        arpeggiateTime = runTime;
-        replaceMonoSynthWith(findNextHeldNote());
+  // call with interrupts masked, unless from inside the alarm interrupt itself
+  void armArpeggiatorAlarm() {
+    uint64_t earliest = getTheCurrentTime() + ARP_MIN_LEAD_TIME;
+    timer_hw->alarm[ARP_ALARM_NUM] = (uint32_t)((arpNextStep > earliest) ? arpNextStep : earliest);
+  }
+
+  // RUN ON CORE 1, AS AN INTERRUPT
+  void arpeggiatorStep() {
+    hw_clear_bits(&timer_hw->intr, 1u << ARP_ALARM_NUM);
+    if ((playbackMode != SYNTH_ARPEGGIO) || !arpNextStep) return;
+    uint64_t now = getTheCurrentTime();
+    if (now < arpNextStep) {    // the alarm only compares the low 32 bits of the timer
+      armArpeggiatorAlarm();
+      return;
+    }
+    replaceMonoSynthWith(arp.step(arpPattern));
+    arpNextStep = arp.followingStep(arpNextStep, now, arpSync, arpBPM, arpDivision);
+    if (arpNextStep) {
+      armArpeggiatorAlarm();
+    }
+  }
+
+  // run whenever the synth mode or arpeggiator sync changes
+  void restartArpeggiator() {
+    uint32_t irq = save_and_disable_interrupts();
+    arpNextStep = 0;
+    if ((playbackMode == SYNTH_ARPEGGIO) && (arpSync == ARP_SYNC_INTERNAL)) {
+      arpNextStep = getTheCurrentTime() + ARP_MIN_LEAD_TIME;
+      armArpeggiatorAlarm();
+    }   // with MIDI clock, the next tick will schedule the first step
+    restore_interrupts(irq);
+  }
+
+  void receiveMIDIclock() {
+    uint64_t next;
+    uint32_t irq = save_and_disable_interrupts();
+    if (arp.clockTick(getTheCurrentTime(), next)
+      && (playbackMode == SYNTH_ARPEGGIO) && (arpSync == ARP_SYNC_MIDI_CLOCK)) {
+      arpNextStep = next;
+      armArpeggiatorAlarm();
+    }
+    restore_interrupts(irq);
+  }
+  void receiveMIDIstart() {
+    uint64_t next;
+    uint32_t irq = save_and_disable_interrupts();
+    bool scheduled = arp.clockStart(getTheCurrentTime(), next);
+    if ((playbackMode == SYNTH_ARPEGGIO) && (arpSync == ARP_SYNC_MIDI_CLOCK)) {
+      arpNextStep = scheduled ? next : 0;   // a step due on the old count won't play
+      if (arpNextStep) {
+        armArpeggiatorAlarm();
       }
     }
+    restore_interrupts(irq);
+  }
+  void receiveMIDIcontinue() {
+    uint64_t next;
+    uint32_t irq = save_and_disable_interrupts();
+    if (arp.clockContinue(getTheCurrentTime(), next)
+      && (playbackMode == SYNTH_ARPEGGIO) && (arpSync == ARP_SYNC_MIDI_CLOCK)) {
+      arpNextStep = next;
+      armArpeggiatorAlarm();
+    }
+    restore_interrupts(irq);
+  }
+  void receiveMIDIstop() {
+    uint32_t irq = save_and_disable_interrupts();
+    arp.clockStop();
+    if ((playbackMode == SYNTH_ARPEGGIO) && (arpSync == ARP_SYNC_MIDI_CLOCK)) {
+      arpNextStep = 0;
+      replaceMonoSynthWith(UNUSED_NOTE);
+    }
+    restore_interrupts(irq);
+  }
+
+  void setupArpeggiator() {
+    hw_set_bits(&timer_hw->inte, 1u << ARP_ALARM_NUM);
+    irq_set_exclusive_handler(ARP_ALARM_IRQ, arpeggiatorStep);   // installed from core 1, so it runs on core 1
+    irq_set_enabled(ARP_ALARM_IRQ, true);
+    restartArpeggiator();
+    sendToLog("arpeggiator is ready.");
+  }
+
+// @looper
+  /*
+    The looper (src/looper.h) records the notes played
+    on the keys and plays them back on repeat, through
+    the same note on / off procedures the keys use, so
+    they go out over MIDI, play on the synth and light up.
+
+    Playback is timed by another hardware alarm, whose
+    interrupt runs on the first core. The interrupt only
+    queues what has fallen due, with the time it was due
+    (see loopDueQueue); the looper task plays the queue
+    through the same procedures as the keys, so notes and
+    MIDI only ever go out from the main loop. After each
+    run the task moves its own deadline to the next event
+    (tasks.setDeadline), and the scheduler then holds back
+    any task, such as the LED refresh, that would still be
+    running when it falls due. The main loop holds the
+    interrupt off (holdLooper) only while it changes the
+    looper's state.
+
+    A long take is kept in LOOP_FILE. The file is opened
+    when recording is armed and left open, so nothing is
+    allocated while recording or playing. Writing to flash
+    pauses both cores briefly, so the synth may click
+    while a long take is being recorded; playing it back
+    only reads.
+  */
+  #define LOOPER_ALARM_NUM 0
+  #define LOOPER_ALARM_IRQ TIMER_IRQ_0
+  #define LOOP_FILE "/loop.bin"
+  class loopFile {
+  public:
+    File f;
+    bool writeChunk(uint32_t chunk, const loopEvent* events, uint8_t count) {
+      size_t bytes = count * sizeof(loopEvent);
+      return f && f.seek(chunk * LOOPER_CHUNK_EVENTS * sizeof(loopEvent))
+        && (f.write((const uint8_t*)events, bytes) == bytes);
+    }
+    bool readChunk(uint32_t chunk, loopEvent* events, uint8_t count) {
+      size_t bytes = count * sizeof(loopEvent);
+      return f && f.seek(chunk * LOOPER_CHUNK_EVENTS * sizeof(loopEvent))
+        && (f.read((uint8_t*)events, bytes) == bytes);
+    }
+  };
+  looper loopTake;
+  loopFile loopStore;
+  loopDueQueue looperDue;
+  byte looperTask = TASK_NONE;
+  byte looperQuantize = 0;                    // steps per whole note at the arpeggiator's BPM, 0 = off
+  byte looperHeld = 0;
+  volatile bool looperWaiting = false;        // playback is waiting for a chunk to be read from the file
+
+  void holdLooper() {
+    if (!looperHeld++) {
+      irq_set_enabled(LOOPER_ALARM_IRQ, false);
+    }
+  }
+  void releaseLooper() {
+    if (looperHeld && !--looperHeld) {
+      irq_set_enabled(LOOPER_ALARM_IRQ, true);
+    }
+  }
+
+  // call with the looper held, unless from inside its interrupt
+  void armLooperAlarm(uint64_t due) {
+    uint64_t earliest = getTheCurrentTime() + ARP_MIN_LEAD_TIME;
+    timer_hw->alarm[LOOPER_ALARM_NUM] = (uint32_t)((due > earliest) ? due : earliest);
+  }
+
+  byte hexWithPitch(int16_t pitch) {
+    for (byte i = 0; i < BTN_COUNT; i++) {
+      if (!(h[i].isCmd) && (h[i].stepsFromC == pitch)) return i;
+    }
+    return UNUSED_NOTE;
+  }
+  /*
+    A note already sounding on its hex (held down, or
+    coming in over MIDI) is left alone. If the layout has
+    changed since the loop was recorded, the note plays
+    on whichever hex now has its pitch.
+  */
+  void playLoopEvent(const loopEvent& e) {
+    byte x = e.hex;
+    if ((x >= BTN_COUNT) || h[x].isCmd || (h[x].stepsFromC != e.pitch)) {
+      x = hexWithPitch(e.pitch);
+      if (x == UNUSED_NOTE) return;
+    }
+    if (e.velocity) {
+      if (h[x].loopVelocity || h[x].MIDIin || (h[x].btnState & 1)) return;
+      if (!(h[x].inScale || (!scaleLock))) return;
+      h[x].loopVelocity = e.velocity;
+      tryMIDInoteOn(x);
+      trySynthNoteOn(x);
+    } else if (h[x].loopVelocity) {
+      h[x].loopVelocity = 0;
+      tryMIDInoteOff(x);
+      trySynthNoteOff(x);
+    }
+  }
+  void releaseLooperNotes() {
+    for (byte i = 0; i < BTN_COUNT; i++) {
+      if (h[i].loopVelocity) {
+        h[i].loopVelocity = 0;
+        tryMIDInoteOff(i);
+        trySynthNoteOff(i);
+      }
+    }
+  }
+
+  // RUN ON CORE 1, AS AN INTERRUPT
+  void looperStep() {
+    hw_clear_bits(&timer_hw->intr, 1u << LOOPER_ALARM_NUM);
+    uint64_t due;
+    byte step = loopTake.queueDue(getTheCurrentTime(), looperDue, due);
+    if (step == LOOPER_STEP_WAIT) {
+      looperWaiting = true;     // re-armed once the chunk is in, or the queue has room
+    } else if (step == LOOPER_STEP_NOTE) {
+      armLooperAlarm(due);      // also catches the alarm firing early, as it only compares the low 32 bits
+    }
+  }
+
+  // call with the looper held: wakes the looper task when the next event falls due
+  void scheduleLooperTask() {
+    loopEvent e;
+    uint64_t due;
+    byte step = loopTake.peek(e, due);
+    if ((step == LOOPER_STEP_NOTE) || (step == LOOPER_STEP_CYCLE_END)) {
+      tasks.setDeadline(looperTask, due);
+    }
+  }
+  void taskLooper() {
+    loopDue d;
+    while (looperDue.pop(d, getTheCurrentTime())) {
+      if (d.step == LOOPER_STEP_CYCLE_END) {
+        releaseLooperNotes();
+      } else {
+        playLoopEvent(d.e);
+      }
+    }
+    if (loopTake.state != LOOPER_PLAYING) return;
+    holdLooper();
+    if (looperWaiting && !loopTake.waitingForFile()) {
+      looperWaiting = false;
+      armLooperAlarm(0);
+    }
+    scheduleLooperTask();
+    releaseLooper();
+  }
+
+  // call with the looper held
+  void startLoop() {
+    updatePower(POWER_BUSY_LOOPER);   // back to full speed before the first note
+    loopTake.start(getTheCurrentTime() + ARP_MIN_LEAD_TIME);
+    if (!loopTake.load(loopStore)) {
+      sendToLog("looper: could not read " LOOP_FILE);
+      loopTake.stop();
+      return;
+    }
+    armLooperAlarm(0);
+    scheduleLooperTask();
+  }
+  void stopLoop() {
+    holdLooper();
+    loopTake.stop();
+    looperDue.clear();
+    releaseLooper();
+    releaseLooperNotes();
+  }
+  /*
+    The record button arms the looper (recording starts
+    with the next note), and when pressed again ends the
+    take and starts playing it. Pressed while armed, it
+    cancels.
+  */
+  void looperRecord() {
+    if (loopTake.state == LOOPER_RECORDING) {   // not playing, so the interrupt leaves it alone until startLoop
+      if (loopTake.finish(getTheCurrentTime(), loopStore)) {
+        holdLooper();
+        startLoop();
+        releaseLooper();
+      } else {
+        sendToLog("looper: could not save " LOOP_FILE);
+      }
+    } else if (loopTake.state == LOOPER_ARMED) {
+      loopTake.clear();
+    } else {
+      stopLoop();
+      loopStore.f.close();
+      loopStore.f = LittleFS.open(LOOP_FILE, "w+");
+      loopTake.arm(looperQuantize ? arpeggiator::stepLength(arpBPM, looperQuantize) : 0);
+    }
+  }
+  void looperPlayStop() {
+    if (loopTake.state == LOOPER_PLAYING) {
+      stopLoop();
+    } else if (loopTake.state == LOOPER_STOPPED) {
+      holdLooper();
+      startLoop();
+      releaseLooper();
+    }
+  }
+  /*
+    Run once per loop: saves the oldest part of a long
+    take while recording, and reads ahead while playing.
+  */
+  void serviceLooper() {
+    if (loopTake.state == LOOPER_RECORDING) {
+      if (!loopTake.save(loopStore)) {
+        sendToLog("looper: could not save " LOOP_FILE);
+        loopTake.clear();
+      }
+    } else if (loopTake.state == LOOPER_PLAYING) {
+      if (!loopTake.load(loopStore)) {
+        sendToLog("looper: could not read " LOOP_FILE);
+        stopLoop();
+      } else if (looperWaiting && !looperDue.full()) {
+        holdLooper();
+        looperWaiting = false;
+        armLooperAlarm(0);
+        scheduleLooperTask();
+        releaseLooper();
+      }
+    }
+  }
+
+  void setupLooper() {
+    hw_set_bits(&timer_hw->inte, 1u << LOOPER_ALARM_NUM);
+    irq_set_exclusive_handler(LOOPER_ALARM_IRQ, looperStep);   // installed from core 1, so it runs on core 1
+    irq_set_enabled(LOOPER_ALARM_IRQ, true);
+    sendToLog("looper is ready.");
   }
 
 // @animate
@@ -1256,8 +2359,27 @@
         );
       }
     }
+    buildNoteToHexIndex();
     sendToLog("assignPitches complete.");
   }
+  /*
+    Incoming MIDI notes are shown on (and played from)
+    the hex that sounds closest to that note. Several
+    hexes may qualify; the one nearest to middle C
+    on the layout wins. The lookup table is rebuilt
+    whenever the pitches change.
+  */
+  void buildNoteToHexIndex() {
+    releaseIncomingNotes();     // the old mapping is about to go away
+    noteToHex.clear();
+    for (byte i = 0; i < LED_COUNT; i++) {
+      if ((h[i].isCmd) || (h[i].note == UNUSED_NOTE)) continue;
+      uint16_t err = abs(h[i].bend) * MPEpitchBendSemis / 8;    // bend is in 1/8192 of the bend range, err in 1/1024 semitones
+      byte dist = abs(h[i].coordCol - h[current.layout().hexMiddleC].coordCol)
+                + abs(h[i].coordRow - h[current.layout().hexMiddleC].coordRow);
+      noteToHex.offer(h[i].note, i, err, dist);
+    }
+  }
   void applyScale() {
     sendToLog("applyScale was called:");
     for (byte i = 0; i < LED_COUNT; i++) {
@@ -1265,18 +2387,7 @@
         if (current.scale().tuning == ALL_TUNINGS) {
           h[i].inScale = 1;
         } else {
-          byte degree = current.keyDegree(h[i].stepsFromC); 
-          if (degree == 0) {
-            h[i].inScale = 1;    // the root is always in the scale
-          } else {
-            byte tempSum = 0;
-            byte iterator = 0;
-            while (degree > tempSum) {
-              tempSum += current.scale().pattern[iterator];
-              iterator++;
-            }  // add the steps in the scale, and you're in scale
-            h[i].inScale = (tempSum == degree);   // if the note lands on one of those sums
-          }
+          h[i].inScale = current.scale().hasDegree(current.keyDegree(h[i].stepsFromC));
         }
         sendToLog(
           "hex #" + std::to_string(i) + ", " +
@@ -1290,25 +2401,53 @@
     setLEDcolorCodes();
     sendToLog("applyScale complete.");
   }
+  /*
+    Renumbering the pitches forgets which notes and voices
+    they own, and a held hex may get a new note number,
+    so everything sounding is let go first. Keys held
+    through the change stay silent until pressed again.
+  */
+  void releaseAllNotes() {
+    releaseLooperNotes();
+    releaseIncomingNotes();
+    for (byte i = 0; i < BTN_COUNT; i++) {
+      if (h[i].isCmd) continue;
+      tryMIDInoteOff(i);
+      while (h[i].synthHeld) {
+        trySynthNoteOff(i);
+      }
+    }
+  }
   void applyLayout() {       // call this function when the layout changes
     sendToLog("buildLayout was called:");
+    releaseAllNotes();
+    byte t = hexLayoutTransform(layoutTurns, layoutMirror);   // turned and/or flipped about the middle C hex
     for (byte i = 0; i < LED_COUNT; i++) {
       if (!(h[i].isCmd)) {        
-        int8_t distCol = h[i].coordCol - h[current.layout().hexMiddleC].coordCol;
-        int8_t distRow = h[i].coordRow - h[current.layout().hexMiddleC].coordRow;
-        h[i].stepsFromC = (
-          (distCol * current.layout().acrossSteps) + 
-          (distRow * (
-            current.layout().acrossSteps + 
-            (2 * current.layout().dnLeftSteps)
-          ))
-        ) / 2;  
+        h[i].stepsFromC = hexStepsFrom(current.layout().hexMiddleC, i, t,
+          current.layout().acrossSteps, current.layout().dnLeftSteps);
         sendToLog(
           "hex #" + std::to_string(i) + ", " +
           "steps from C4=" + std::to_string(h[i].stepsFromC) + "."
         );
       }
     }
+    // number the distinct pitches, so hexes that share one share its note and voice (see pitchDef)
+    pitchCount = 0;
+    for (byte i = 0; i < BTN_COUNT; i++) {
+      if (h[i].isCmd) continue;
+      byte n = 0;
+      while ((n < pitchCount) && (h[pitches[n].lead].stepsFromC != h[i].stepsFromC)) {
+        n++;
+      }
+      if (n == pitchCount) {
+        pitches[n] = pitchDef();
+        pitches[n].lead = i;
+        pitchCount++;
+      }
+      h[i].pitchNum = n;
+    }
+    sendToLog(std::to_string(pitchCount) + " distinct pitches.");
     applyScale();        // when layout changes, have to re-apply scale and re-apply LEDs
     assignPitches();     // same with pitches
     sendToLog("buildLayout complete.");
@@ -1355,8 +2494,18 @@
   #define MENU_VALUES_LEFT_OFFSET 78
   #define CONTRAST_AWAKE 63
   #define CONTRAST_SCREENSAVER 1
+  #define DISPLAY_BUS_CLOCK 1000000   // I2C Hz
   // Create an instance of the U8g2 graphics library.
   U8G2_SH1107_SEEED_128X128_F_HW_I2C u8g2(U8G2_R2, /* reset=*/ U8X8_PIN_NONE);
+  /*
+    U8g2 still renders each menu frame on the first core,
+    but it only draws into memory. The display pipeline
+    works out which 8x8 tiles changed since the last frame
+    that made it to the screen, and the second core sends
+    just those tiles over I2C, a few at a time, between
+    knob reads. See src/displayPipeline.h.
+  */
+  displayPipeline screenPipeline;
   // Create menu object of class GEM_u8g2. Supply its constructor with reference to u8g2 object we created earlier
   GEM_u8g2 menu(
     u8g2, GEM_POINTER_ROW, GEM_ITEMS_COUNT_AUTO, 
@@ -1364,6 +2513,7 @@
   );
   bool screenSaverOn = 0;                         
   uint64_t screenTime = 0;                        // GFX timer to count if screensaver should go on
+  uint64_t screenCheckTime = 0;                   // when the screensaver last checked
   const uint64_t screenSaverTimeout = (1u << 23); // 2^23 microseconds ~ 8 seconds
   /*
     Create menu page object of class GEMPage. 
@@ -1392,6 +2542,9 @@
   GEMPage  menuPageSynth("Synth options");
   GEMItem  menuGotoSynth("Synth options", menuPageSynth);
   GEMItem  menuSynthBack("<< Back", menuPageMain);
+  GEMPage  menuPageLooper("Looper");
+  GEMItem  menuGotoLooper("Looper", menuPageLooper);
+  GEMItem  menuLooperBack("<< Back", menuPageMain);
   GEMPage  menuPageControl("Control wheel");
   GEMItem  menuGotoControl("Control wheel", menuPageControl);
   GEMItem  menuControlBack("<< Back", menuPageMain);
@@ -1399,6 +2552,10 @@
   GEMItem  menuGotoAdvanced("Advanced", menuPageAdvanced);
   GEMItem  menuAdvancedBack("<< Back", menuPageMain);
   GEMPage  menuPageReboot("Ready to flash firmware!");
+  #if PROFILING_ON
+  GEMPage  menuPageDiagnostics("Diagnostics");
+  GEMItem  menuDiagnosticsBack("<< Back", menuPageAdvanced);
+  #endif
   /*
     We haven't written the code for some procedures,
     but the menu item needs to know the address
@@ -1410,6 +2567,17 @@
   */
   void changeTranspose();
   void rebootToBootloader();
+  void saveTraceToFile();
+  void sendTraceToSerial();
+  void recalibrateScan();
+  void pressLooperRecord();
+  void pressLooperPlay();
+  void pressImportSamples();
+  #if PROFILING_ON
+  void showDiagnostics();
+  void dumpDiagnostics();
+  void resetDiagnostics();
+  #endif
   /*
     This GEMItem is meant to just be a read-only text label.
     To be honest I don't know how to get just a plain text line to show here other than this!
@@ -1427,6 +2595,42 @@
     We must declare or define that procedure first.
   */
   GEMItem  menuItemUSBBootloader("Update Firmware", rebootToBootloader);
+  /*
+    Redo the key scan calibration (hands off the keys!)
+    and show how long each scan now spends waiting.
+  */
+  char scanWaitText[GEM_STR_LEN];
+  GEMItem  menuItemScanWait("Scan wait:", scanWaitText, GEM_READONLY);
+  GEMItem  menuItemScanCalibrate("Calibrate keys", recalibrateScan);
+  #if TRACE_ON
+  GEMItem  menuItemTraceSave("Save trace", saveTraceToFile);
+  GEMItem  menuItemTraceSend("Send trace", sendTraceToSerial);
+  #endif
+  /*
+    The diagnostics page shows average / 99th percentile
+    time in microseconds for each pass of loop() that
+    ran a task, then for each task on its own.
+    The values are text, refreshed each time the page
+    is opened (or the refresh item is selected).
+  */
+  #if PROFILING_ON
+  GEMItem  menuGotoDiagnostics("Diagnostics", showDiagnostics);
+  GEMItem  menuItemDiagRefresh("Refresh", showDiagnostics);
+  char diagText[PROFILE_STAGE_COUNT + 3][GEM_STR_LEN];
+  GEMItem  menuItemDiagLoop(  "Loop avg/99",  diagText[PROFILE_STAGE_LOOP],       GEM_READONLY);
+  GEMItem  menuItemDiagScan(  "Scan",         diagText[PROFILE_STAGE_SCAN],       GEM_READONLY);
+  GEMItem  menuItemDiagMIDIin("MIDI in",      diagText[PROFILE_STAGE_MIDI_IN],    GEM_READONLY);
+  GEMItem  menuItemDiagWheels("Wheels",       diagText[PROFILE_STAGE_WHEELS],     GEM_READONLY);
+  GEMItem  menuItemDiagAnim(  "Animate",      diagText[PROFILE_STAGE_ANIMATE],    GEM_READONLY);
+  GEMItem  menuItemDiagLEDs(  "LEDs",         diagText[PROFILE_STAGE_LEDS],       GEM_READONLY);
+  GEMItem  menuItemDiagMenu(  "Menu",         diagText[PROFILE_STAGE_MENU],       GEM_READONLY);
+  GEMItem  menuItemDiagPoll(  "Synth IRQ",    diagText[PROFILE_STAGE_POLL],       GEM_READONLY);
+  GEMItem  menuItemDiagLate(  "Late/overrun", diagText[PROFILE_STAGE_COUNT],      GEM_READONLY);
+  GEMItem  menuItemDiagScreen("Screen ms",    diagText[PROFILE_STAGE_COUNT + 1],  GEM_READONLY);
+  GEMItem  menuItemDiagTasks( "Missed/over",  diagText[PROFILE_STAGE_COUNT + 2],  GEM_READONLY);
+  GEMItem  menuItemDiagDump(  "Dump stats",   dumpDiagnostics);
+  GEMItem  menuItemDiagReset( "Reset stats",  resetDiagnostics);
+  #endif
   /*
     Tunings, layouts, scales, and keys are defined
     earlier in this code. We should not have to
@@ -1447,6 +2651,7 @@
   GEMItem* menuItemScales[scaleCount];       
   GEMSelect* selectKey[TUNINGCOUNT];         
   GEMItem* menuItemKeys[TUNINGCOUNT];       
+  SelectOptionInt keyChoiceOptions[MAX_SCALE_DIVISIONS];  // key names of the current tuning, shared by all key selectors
   /*
     We are now creating some GEMItems that let you
     1) select a value from a list of options,
@@ -1477,6 +2682,10 @@
   SelectOptionByte optionByteYesOrNo[] =  { { "No", 0 }, { "Yes" , 1 } };
   GEMSelect selectYesOrNo( sizeof(optionByteYesOrNo)  / sizeof(SelectOptionByte), optionByteYesOrNo);
   GEMItem  menuItemScaleLock( "Scale lock?", scaleLock, selectYesOrNo);
+  GEMItem  menuItemLayoutMirror( "Mirror?", layoutMirror, selectYesOrNo, updateLayoutAndRotate);
+  SelectOptionByte optionByteLayoutTurns[] = { { "None", 0 }, { "60", 1 }, { "120", 2 }, { "180", 3 }, { "240", 4 }, { "300", 5 } };
+  GEMSelect selectLayoutTurns( sizeof(optionByteLayoutTurns) / sizeof(SelectOptionByte), optionByteLayoutTurns);
+  GEMItem  menuItemLayoutTurns( "Turn:", layoutTurns, selectLayoutTurns, updateLayoutAndRotate);
   GEMItem  menuItemPercep( "Fix color:", perceptual, selectYesOrNo, setLEDcolorCodes);
   GEMItem  menuItemShiftColor( "ColorByKey", paletteBeginsAtKeyCenter, selectYesOrNo, setLEDcolorCodes);
   GEMItem  menuItemWheelAlt( "Alt wheel?", wheelMode, selectYesOrNo);
@@ -1493,6 +2702,35 @@
   GEMSelect selectPlayback(sizeof(optionBytePlayback) / sizeof(SelectOptionByte), optionBytePlayback);
   GEMItem  menuItemPlayback(  "Synth mode:",       playbackMode,  selectPlayback, resetSynthFreqs);
 
+  SelectOptionByte optionByteArpPattern[] = { { "Up", ARP_PATTERN_UP }, { "Down", ARP_PATTERN_DOWN }, { "Up/Down", ARP_PATTERN_UPDOWN },
+    { "Random", ARP_PATTERN_RANDOM }, { "Played", ARP_PATTERN_PLAYED } };
+  GEMSelect selectArpPattern(sizeof(optionByteArpPattern) / sizeof(SelectOptionByte), optionByteArpPattern);
+  GEMItem  menuItemArpPattern("Arp order:", arpPattern, selectArpPattern);
+
+  SelectOptionInt optionIntArpBPM[] = { { "60", 60 }, { "72", 72 }, { "80", 80 }, { "90", 90 }, { "100", 100 }, { "110", 110 },
+    { "120", 120 }, { "132", 132 }, { "140", 140 }, { "150", 150 }, { "160", 160 }, { "180", 180 }, { "200", 200 } };
+  GEMSelect selectArpBPM(sizeof(optionIntArpBPM) / sizeof(SelectOptionInt), optionIntArpBPM);
+  GEMItem  menuItemArpBPM("Arp BPM:", arpBPM, selectArpBPM);
+
+  SelectOptionByte optionByteArpDivision[] = { { "1/4", 4 }, { "1/8", 8 }, { "1/8T", 12 }, { "1/16", 16 }, { "1/16T", 24 }, { "1/32", 32 } };
+  GEMSelect selectArpDivision(sizeof(optionByteArpDivision) / sizeof(SelectOptionByte), optionByteArpDivision);
+  GEMItem  menuItemArpDivision("Arp step:", arpDivision, selectArpDivision);
+
+  SelectOptionByte optionByteArpSync[] = { { "Internal", ARP_SYNC_INTERNAL }, { "MIDI clk", ARP_SYNC_MIDI_CLOCK } };
+  GEMSelect selectArpSync(sizeof(optionByteArpSync) / sizeof(SelectOptionByte), optionByteArpSync);
+  GEMItem  menuItemArpSync("Arp sync:", arpSync, selectArpSync, restartArpeggiator);
+  /*
+    Looper controls. Quantizing uses the arpeggiator's
+    BPM, and applies to the next take.
+  */
+  GEMItem  menuItemLooperRecord("Record", pressLooperRecord);
+  GEMItem  menuItemLooperPlay("Play / stop", pressLooperPlay);
+  SelectOptionByte optionByteLooperQuantize[] = { { "Off", 0 }, { "1/4", 4 }, { "1/8", 8 }, { "1/16", 16 }, { "1/32", 32 } };
+  GEMSelect selectLooperQuantize(sizeof(optionByteLooperQuantize) / sizeof(SelectOptionByte), optionByteLooperQuantize);
+  GEMItem  menuItemLooperQuantize("Quantize:", looperQuantize, selectLooperQuantize);
+  char looperStatusText[GEM_STR_LEN];
+  GEMItem  menuItemLooperStatus("Loop:", looperStatusText, GEM_READONLY);
+
   // Hardware V1.2-only
   SelectOptionByte optionByteAudioD[] =  {
     { "Buzzer", AUDIO_PIEZO }, { "Jack" , AUDIO_AJACK }, { "Both", AUDIO_BOTH }
@@ -1653,20 +2891,46 @@
   GEMItem menuItemBright( "Brightness", globalBrightness, selectBright, setLEDcolorCodes);
 
   SelectOptionByte optionByteWaveform[] = { { "Hybrid", WAVEFORM_HYBRID }, { "Square", WAVEFORM_SQUARE }, { "Saw", WAVEFORM_SAW },
-  {"Triangl", WAVEFORM_TRIANGLE}, {"Sine", WAVEFORM_SINE}, {"Strings", WAVEFORM_STRINGS}, {"Clrinet", WAVEFORM_CLARINET} };
+  {"Triangl", WAVEFORM_TRIANGLE}, {"Sine", WAVEFORM_SINE}, {"Strings", WAVEFORM_STRINGS}, {"Clrinet", WAVEFORM_CLARINET}, {"FM", WAVEFORM_FM}, {"Sampler", WAVEFORM_SAMPLER} };
   GEMSelect selectWaveform(sizeof(optionByteWaveform) / sizeof(SelectOptionByte), optionByteWaveform);
   GEMItem  menuItemWaveform( "Waveform:", currWave, selectWaveform, resetSynthFreqs);
 
-  SelectOptionInt optionIntModWheel[] = { { "too slo", 1 }, { "Turtle", 2 }, { "Slow", 4 }, 
+  SelectOptionByte optionByteFMpreset[] = { { fmPresets[0].name, 0 }, { fmPresets[1].name, 1 }, { fmPresets[2].name, 2 },
+  { fmPresets[3].name, 3 }, { fmPresets[4].name, 4 } };
+  GEMSelect selectFMpreset(sizeof(optionByteFMpreset) / sizeof(SelectOptionByte), optionByteFMpreset);
+  GEMItem  menuItemFMpreset( "FM voice:", fmPresetIndex, selectFMpreset, applyFMpreset);
+
+  char samplesText[GEM_STR_LEN];
+  GEMItem  menuItemSamples("Samples:", samplesText, GEM_READONLY);
+  GEMItem  menuItemImportSamples("Import WAVs", pressImportSamples);
+
+  SelectOptionByte optionByteFilter[] = { { "Off", FILTER_OFF }, { "Soft", FILTER_SOFT }, { "Reso", FILTER_RESONANT } };
+  GEMSelect selectFilter(sizeof(optionByteFilter) / sizeof(SelectOptionByte), optionByteFilter);
+  GEMItem  menuItemFilter( "Filter:", filterMode, selectFilter, applyEffects);
+
+  SelectOptionByte optionByteDelay[] = { { "Off", DELAY_OFF }, { "Chorus", DELAY_CHORUS }, { "Echo", DELAY_ECHO }, { "Long", DELAY_LONG_ECHO } };
+  GEMSelect selectDelay(sizeof(optionByteDelay) / sizeof(SelectOptionByte), optionByteDelay);
+  GEMItem  menuItemDelay( "Delay:", delayMode, selectDelay, applyEffects);
+
+  SelectOptionInt optionIntVelWheel[] = { { "too slo", 1 }, { "Turtle", 2 }, { "Slow", 4 }, 
     { "Medium",    8 }, { "Fast",     16 }, { "Cheetah",  32 }, { "Instant", 127 } };
-  GEMSelect selectModSpeed(sizeof(optionIntModWheel) / sizeof(SelectOptionInt), optionIntModWheel);
-  GEMItem  menuItemModSpeed( "Mod wheel:", modWheelSpeed, selectModSpeed);
-  GEMItem  menuItemVelSpeed( "Vel wheel:", velWheelSpeed, selectModSpeed);
+  GEMSelect selectVelSpeed(sizeof(optionIntVelWheel) / sizeof(SelectOptionInt), optionIntVelWheel);
+  GEMItem  menuItemVelSpeed( "Vel wheel:", velWheelSpeed, selectVelSpeed);
 
+  // the mod and pitch bend wheels both have a 14 bit range
   SelectOptionInt optionIntPBWheel[] =  { { "too slo", 128 }, { "Turtle", 256 }, { "Slow", 512 },  
     { "Medium", 1024 }, { "Fast", 2048 }, { "Cheetah", 4096 },  { "Instant", 16384 } };
   GEMSelect selectPBSpeed(sizeof(optionIntPBWheel) / sizeof(SelectOptionInt), optionIntPBWheel);
   GEMItem  menuItemPBSpeed( "PB wheel:", pbWheelSpeed, selectPBSpeed);
+  GEMItem  menuItemModSpeed( "Mod wheel:", modWheelSpeed, selectPBSpeed);
+
+  SelectOptionByte optionByteWheelCurve[] = { { "Linear", WHEEL_CURVE_LINEAR }, { "Ease", WHEEL_CURVE_EASE }, { "Smooth", WHEEL_CURVE_SMOOTH } };
+  GEMSelect selectWheelCurve(sizeof(optionByteWheelCurve) / sizeof(SelectOptionByte), optionByteWheelCurve);
+  GEMItem  menuItemWheelCurve( "Curve:", wheelCurveShape, selectWheelCurve);
+
+  SelectOptionByte optionByteWheelRouting[] = { { "Ch 1", WHEEL_TO_CH1 }, { "Per note", WHEEL_PER_NOTE } };
+  GEMSelect selectWheelRouting(sizeof(optionByteWheelRouting) / sizeof(SelectOptionByte), optionByteWheelRouting);
+  GEMItem  menuItemWheelRouting( "Wheels to:", wheelRouting, selectWheelRouting);
 
   // Call this procedure to return to the main menu
   void menuHome() {
@@ -1674,9 +2938,58 @@
     menu.drawMenu();
   }
 
+  void showScanWait() {
+    snprintf(scanWaitText, GEM_STR_LEN, "%luus", (unsigned long)scanSettle.totalSettle());
+  }
+  void recalibrateScan() {
+    if (!calibrateScan()) {
+      snprintf(scanWaitText, GEM_STR_LEN, "key held");
+    } else {
+      showScanWait();
+    }
+    menu.drawMenu();
+  }
+
+  void showSamplerStatus() {
+    if (!sampleBankSize) {
+      snprintf(samplesText, GEM_STR_LEN, "no room");
+    } else if (sampleImportResult) {
+      snprintf(samplesText, GEM_STR_LEN, "%d, %d bad", sampleSet.zoneCount(), sampleImportResult);
+    } else {
+      snprintf(samplesText, GEM_STR_LEN, "%d", sampleSet.zoneCount());
+    }
+  }
+  void pressImportSamples() {
+    snprintf(samplesText, GEM_STR_LEN, "importing");
+    menu.drawMenu();
+    importSamples();
+    showSamplerStatus();
+    menu.drawMenu();
+  }
+  void showLooperStatus() {
+    switch (loopTake.state) {
+      case LOOPER_ARMED:     snprintf(looperStatusText, GEM_STR_LEN, "ready");     break;
+      case LOOPER_RECORDING: snprintf(looperStatusText, GEM_STR_LEN, "recording"); break;
+      case LOOPER_STOPPED:   snprintf(looperStatusText, GEM_STR_LEN, "stopped");   break;
+      case LOOPER_PLAYING:   snprintf(looperStatusText, GEM_STR_LEN, "playing");   break;
+      default:               snprintf(looperStatusText, GEM_STR_LEN, "empty");     break;
+    }
+  }
+  void pressLooperRecord() {
+    looperRecord();
+    showLooperStatus();
+    menu.drawMenu();
+  }
+  void pressLooperPlay() {
+    looperPlayStop();
+    showLooperStatus();
+    menu.drawMenu();
+  }
+
   void rebootToBootloader() {
     menu.setMenuPageCurrent(menuPageReboot);
     menu.drawMenu();
+    screenPipeline.waitUntilClean(250000); // let the other core finish sending the page before the reboot
     strip.clear();
     strip.show();
     rp2040.rebootToBootloader();
@@ -1716,8 +3029,16 @@
    
     It should run once after the key selectors are
     generated, and then once any time the tuning changes.
+    The key names live in flash with the tuning; they are
+    copied into the one list of choices that all the key
+    selectors share, so only the current tuning's names
+    take up RAM.
   */
   void showOnlyValidKeyChoices() { 
+    for (byte k = 0; k < current.tuning().cycleLength; k++) {
+      keyChoiceOptions[k].name = current.tuning().keyChoices[k].name;
+      keyChoiceOptions[k].val_int = current.tuning().keyChoices[k].stepsFromA;
+    }
     for (int T = 0; T < TUNINGCOUNT; T++) {
       menuItemKeys[T]->hide((T != current.tuningIndex));
     }
@@ -1729,18 +3050,28 @@
     u8g2.setDisplayRotation(current.layout().isPortrait ? U8G2_R2 : U8G2_R1);     // and landscape / portrait rotation
   }
   /*
+    The set...() procedures below change one setting
+    by its index, check that it's valid in the current
+    tuning, and redo whatever depends on it.
+    They are shared by the menu and by SysEx commands.
+    The change...() procedures are the menu callbacks.
+
     This procedure is run when a layout is selected via the menu.
     It sets the current layout to the selected value.
     If it's different from the previous one, then
     re-apply the layout to the grid. In any case, go to the
     main menu when done.
   */
-  void changeLayout(GEMCallbackData callbackData) {
-    byte selection = callbackData.valByte;
+  void setLayout(int selection) {
+    if ((selection < 0) || (selection >= layoutCount)) return;
+    if (layoutOptions[selection].tuning != current.tuningIndex) return;
     if (selection != current.layoutIndex) {
       current.layoutIndex = selection;
       updateLayoutAndRotate();
     }
+  }
+  void changeLayout(GEMCallbackData callbackData) {
+    setLayout(callbackData.valByte);
     menuHome();
   }
   /*
@@ -1750,12 +3081,16 @@
     re-apply the scale to the grid. In any case, go to the
     main menu when done.
   */
-  void changeScale(GEMCallbackData callbackData) {   // when you change the scale via the menu
-    int selection = callbackData.valInt;
+  void setScale(int selection) {
+    if ((selection < 0) || (selection >= scaleCount)) return;
+    if ((scaleOptions[selection].tuning != current.tuningIndex) && (scaleOptions[selection].tuning != ALL_TUNINGS)) return;
     if (selection != current.scaleIndex) {
       current.scaleIndex = selection;
       applyScale();
     }
+  }
+  void changeScale(GEMCallbackData callbackData) {   // when you change the scale via the menu
+    setScale(callbackData.valInt);
     menuHome();
   }
   /*
@@ -1767,6 +3102,15 @@
     The menu does not go home because the intent is to stay
     on the scale/key screen.
   */
+  void setKey(int stepsFromA) {
+    bool valid = false;
+    for (byte k = 0; k < current.tuning().cycleLength; k++) {
+      valid |= (current.tuning().keyChoices[k].stepsFromA == stepsFromA);
+    }
+    if (!valid) return;     // must be one of the key menu's choices
+    current.keyStepsFromA = stepsFromA;
+    applyScale();
+  }
   void changeKey() {     // when you change the key via the menu
     applyScale();
   }
@@ -1779,6 +3123,11 @@
     The procedure to re-assign pitches is therefore called.
     The menu doesn't change because the transpose is a spinner select.
   */
+  void setTranspose(int steps) {
+    if ((steps < -127) || (steps > 127)) return;   // same range as the menu
+    transposeSteps = steps;
+    changeTranspose();
+  }
   void changeTranspose() {     // when you change the transpose via the menu
     current.transpose = transposeSteps;
     assignPitches();
@@ -1790,8 +3139,8 @@
     quite a few items are reset, refreshed, and redone
     when the tuning changes.
   */
-  void changeTuning(GEMCallbackData callbackData) { 
-    byte selection = callbackData.valByte;
+  void setTuning(int selection) {
+    if ((selection < 0) || (selection >= TUNINGCOUNT)) return;
     if (selection != current.tuningIndex) {
       current.tuningIndex = selection;
       current.layoutIndex = current.layoutsBegin();        // reset layout to first in list
@@ -1804,8 +3153,56 @@
       resetTuningMIDI();  // clear out MIDI queue
       resetSynthFreqs();
     }
+  }
+  void changeTuning(GEMCallbackData callbackData) { 
+    setTuning(callbackData.valByte);
     menuHome();
   }
+  /*
+    SysEx commands (listed in src/midiInput.h) go through
+    the same procedures as the menu, and are checked the
+    same way, e.g. a layout has to belong to the tuning.
+  */
+  void receiveSysExCommand(sysExCommand c) {
+    switch (c.cmd) {
+      case SYSEX_CMD_TUNING:
+        setTuning(c.value);
+        break;
+      case SYSEX_CMD_LAYOUT:
+        setLayout(c.value);
+        break;
+      case SYSEX_CMD_SCALE:
+        setScale(c.value);
+        break;
+      case SYSEX_CMD_KEY:
+        setKey(c.value - SYSEX_TRANSPOSE_ZERO);
+        break;
+      case SYSEX_CMD_TRANSPOSE:
+        setTranspose(c.value - SYSEX_TRANSPOSE_ZERO);
+        break;
+      case SYSEX_CMD_SYNTH_MODE:
+        if (c.value <= SYNTH_POLY) {
+          playbackMode = c.value;
+          resetSynthFreqs();
+        }
+        break;
+      #if PROFILING_ON
+      case SYSEX_CMD_DIAGNOSTICS:
+        dumpDiagnostics();
+        break;
+      #endif
+      default:
+        return;
+    }
+    if (DIAGNOSTICS_ON) {
+      char text[32];
+      snprintf(text, sizeof(text), "SysEx command %c = %d", c.cmd, c.value);
+      sendToLog(text);
+    }
+    if (!screenSaverOn) {
+      menu.drawMenu();    // show the new settings if they're on screen
+    }
+  }
   /*
     The procedure below builds menu items for tuning,
     layout, scales, and keys based on what's preloaded.
@@ -1825,20 +3222,20 @@
   */
   void createTuningMenuItems() {
     for (byte T = 0; T < TUNINGCOUNT; T++) {
-      menuItemTuning[T] = new GEMItem(tuningOptions[T].name.c_str(), changeTuning, T);
+      menuItemTuning[T] = new GEMItem(tuningOptions[T].name, changeTuning, T);
       menuPageTuning.addMenuItem(*menuItemTuning[T]);
     }
   }
   void createLayoutMenuItems() {
     for (byte L = 0; L < layoutCount; L++) { // create pointers to all layouts
-      menuItemLayout[L] = new GEMItem(layoutOptions[L].name.c_str(), changeLayout, L);
+      menuItemLayout[L] = new GEMItem(layoutOptions[L].name, changeLayout, L);
       menuPageLayout.addMenuItem(*menuItemLayout[L]);
     }
     showOnlyValidLayoutChoices();
   }
   void createKeyMenuItems() {
     for (byte T = 0; T < TUNINGCOUNT; T++) {
-      selectKey[T] = new GEMSelect(tuningOptions[T].cycleLength, tuningOptions[T].keyChoices);
+      selectKey[T] = new GEMSelect(tuningOptions[T].cycleLength, keyChoiceOptions);
       menuItemKeys[T] = new GEMItem("Key:", current.keyStepsFromA, *selectKey[T], changeKey);
       menuPageScales.addMenuItem(*menuItemKeys[T]);
     }
@@ -1846,7 +3243,7 @@
   }
   void createScaleMenuItems() {
     for (int S = 0; S < scaleCount; S++) {  // create pointers to all scale items, filter them as you go
-      menuItemScales[S] = new GEMItem(scaleOptions[S].name.c_str(), changeScale, S);
+      menuItemScales[S] = new GEMItem(scaleOptions[S].name, changeScale, S);
       menuPageScales.addMenuItem(*menuItemScales[S]);
     }
     showOnlyValidScaleChoices();
@@ -1855,6 +3252,9 @@
   void setupMenu() { 
     menu.setSplashDelay(0);
     menu.init();
+    showScanWait();
+    showLooperStatus();
+    showSamplerStatus();
     /*
       addMenuItem procedure adds that GEM object to the given page.
       The menu items appear in the order they are added,
@@ -1864,6 +3264,8 @@
       createTuningMenuItems();
       menuPageTuning.addMenuItem(menuTuningBack);
     menuPageMain.addMenuItem(menuGotoLayout);
+      menuPageLayout.addMenuItem(menuItemLayoutTurns);
+      menuPageLayout.addMenuItem(menuItemLayoutMirror);
       createLayoutMenuItems();
       menuPageLayout.addMenuItem(menuLayoutBack);
     menuPageMain.addMenuItem(menuGotoScales);
@@ -1875,6 +3277,8 @@
       menuPageControl.addMenuItem(menuItemPBSpeed);
       menuPageControl.addMenuItem(menuItemModSpeed);
       menuPageControl.addMenuItem(menuItemVelSpeed);
+      menuPageControl.addMenuItem(menuItemWheelCurve);
+      menuPageControl.addMenuItem(menuItemWheelRouting);
       menuPageControl.addMenuItem(menuControlBack);
     menuPageMain.addMenuItem(menuGotoColors);
       menuPageColors.addMenuItem(menuItemColor);
@@ -1884,10 +3288,25 @@
     menuPageMain.addMenuItem(menuGotoSynth);
       menuPageSynth.addMenuItem(menuItemPlayback);  
       menuPageSynth.addMenuItem(menuItemWaveform);
+      menuPageSynth.addMenuItem(menuItemFMpreset);
+      menuPageSynth.addMenuItem(menuItemSamples);
+      menuPageSynth.addMenuItem(menuItemImportSamples);
       // menuItemAudioD added here for hardware V1.2
+      menuPageSynth.addMenuItem(menuItemFilter);
+      menuPageSynth.addMenuItem(menuItemDelay);
+      menuPageSynth.addMenuItem(menuItemArpPattern);
+      menuPageSynth.addMenuItem(menuItemArpBPM);
+      menuPageSynth.addMenuItem(menuItemArpDivision);
+      menuPageSynth.addMenuItem(menuItemArpSync);
       menuPageSynth.addMenuItem(menuItemRolandMT32);
       menuPageSynth.addMenuItem(menuItemGeneralMidi);
       menuPageSynth.addMenuItem(menuSynthBack);
+    menuPageMain.addMenuItem(menuGotoLooper);
+      menuPageLooper.addMenuItem(menuItemLooperRecord);
+      menuPageLooper.addMenuItem(menuItemLooperPlay);
+      menuPageLooper.addMenuItem(menuItemLooperQuantize);
+      menuPageLooper.addMenuItem(menuItemLooperStatus);
+      menuPageLooper.addMenuItem(menuLooperBack);
     menuPageMain.addMenuItem(menuItemTransposeSteps);
     menuPageMain.addMenuItem(menuGotoAdvanced);
       menuPageAdvanced.addMenuItem(menuItemVersion);
@@ -1900,18 +3319,136 @@
       menuPageAdvanced.addMenuItem(menuItemPBBehave);
       menuPageAdvanced.addMenuItem(menuItemModBehave);
       menuPageAdvanced.addMenuItem(menuItemUSBBootloader);
+      menuPageAdvanced.addMenuItem(menuItemScanCalibrate);
+      menuPageAdvanced.addMenuItem(menuItemScanWait);
+      #if TRACE_ON
+      menuPageAdvanced.addMenuItem(menuItemTraceSave);
+      menuPageAdvanced.addMenuItem(menuItemTraceSend);
+      #endif
+      #if PROFILING_ON
+      menuPageAdvanced.addMenuItem(menuGotoDiagnostics);
+        menuPageDiagnostics.addMenuItem(menuItemDiagRefresh);
+        menuPageDiagnostics.addMenuItem(menuItemDiagLoop);
+        menuPageDiagnostics.addMenuItem(menuItemDiagScan);
+        menuPageDiagnostics.addMenuItem(menuItemDiagMIDIin);
+        menuPageDiagnostics.addMenuItem(menuItemDiagWheels);
+        menuPageDiagnostics.addMenuItem(menuItemDiagAnim);
+        menuPageDiagnostics.addMenuItem(menuItemDiagLEDs);
+        menuPageDiagnostics.addMenuItem(menuItemDiagMenu);
+        menuPageDiagnostics.addMenuItem(menuItemDiagPoll);
+        menuPageDiagnostics.addMenuItem(menuItemDiagLate);
+        menuPageDiagnostics.addMenuItem(menuItemDiagScreen);
+        menuPageDiagnostics.addMenuItem(menuItemDiagTasks);
+        menuPageDiagnostics.addMenuItem(menuItemDiagDump);
+        menuPageDiagnostics.addMenuItem(menuItemDiagReset);
+        menuPageDiagnostics.addMenuItem(menuDiagnosticsBack);
+      #endif
       menuPageAdvanced.addMenuItem(menuAdvancedBack);
     menuHome();
   }
+  #if PROFILING_ON
+  /*
+    These procedures fill in the diagnostics page
+    and send the full statistics out for analysis.
+    The serial dump is human readable. The SysEx dump
+    uses the non-commercial manufacturer ID (0x7D),
+    then 'H' 'D' (HexBoard Diagnostics), then for each
+    stage five values (count, min, avg, p99, max), each
+    sent as five 7-bit groups, least significant first.
+  */
+  void showDiagnostics() {
+    for (byte s = 0; s < PROFILE_STAGE_COUNT; s++) {
+      snprintf(diagText[s], GEM_STR_LEN, "%lu/%lu",
+        (unsigned long)cyclesToMicros(stageStats[s].average()),
+        (unsigned long)cyclesToMicros(stageStats[s].percentile(99)));
+    }
+    snprintf(diagText[PROFILE_STAGE_COUNT], GEM_STR_LEN, "%lu/%lu",
+      (unsigned long)pollLateness.maxValue, (unsigned long)pollOverruns);
+    snprintf(diagText[PROFILE_STAGE_COUNT + 1], GEM_STR_LEN, "%lu/%lu",
+      (unsigned long)(screenPipeline.lastFrameLatency / 1000),
+      (unsigned long)(screenPipeline.maxFrameLatency / 1000));
+    snprintf(diagText[PROFILE_STAGE_COUNT + 2], GEM_STR_LEN, "%lu/%lu",
+      (unsigned long)tasks.totalMissed(), (unsigned long)tasks.totalOverBudget());
+    menu.setMenuPageCurrent(menuPageDiagnostics);
+    menu.drawMenu();
+  }
+  void resetDiagnostics() {
+    resetProfiler();
+    screenPipeline.resetStats();
+    for (byte t = 0; t < tasks.count; t++) {
+      tasks.resetStats(t);
+    }
+    showDiagnostics();
+  }
+  byte diagSysEx[3 + (PROFILE_STAGE_COUNT + 1) * 5 * 5];
+  void packSysEx28(byte*& p, uint32_t v) {
+    for (byte i = 0; i < 5; i++) {
+      *p++ = v & 0x7F;
+      v >>= 7;
+    }
+  }
+  void dumpDiagnostics() {
+    const char* stageName[] = {"loop","scan","midi in","wheels","animate","leds","menu","poll"};
+    Serial.println("stage        count    min_us   avg_us   p99_us   max_us");
+    byte* p = diagSysEx;
+    *p++ = 0x7D;
+    *p++ = 'H';
+    *p++ = 'D';
+    for (byte s = 0; s < PROFILE_STAGE_COUNT; s++) {
+      profileHistogram& st = stageStats[s];
+      uint32_t v[5] = {
+        st.count,
+        cyclesToMicros(st.count ? st.minValue : 0),
+        cyclesToMicros(st.average()),
+        cyclesToMicros(st.percentile(99)),
+        cyclesToMicros(st.maxValue)
+      };
+      Serial.printf("%-10s %7lu %9lu %8lu %8lu %8lu\n", stageName[s],
+        (unsigned long)v[0], (unsigned long)v[1], (unsigned long)v[2], (unsigned long)v[3], (unsigned long)v[4]);
+      for (byte i = 0; i < 5; i++) {
+        packSysEx28(p, v[i]);
+      }
+    }
+    uint32_t late[5] = {
+      pollOverruns, pollLateness.count ? pollLateness.minValue : 0,
+      pollLateness.average(), pollLateness.percentile(99), pollLateness.maxValue
+    };
+    Serial.printf("poll late  overruns %lu, avg %lu us, p99 %lu us, max %lu us\n",
+      (unsigned long)late[0], (unsigned long)late[2], (unsigned long)late[3], (unsigned long)late[4]);
+    for (byte i = 0; i < 5; i++) {
+      packSysEx28(p, late[i]);
+    }
+    Serial.printf("screen     frames %lu, tiles changed %lu, sent %lu, latency %lu us (max %lu)\n",
+      (unsigned long)screenPipeline.framesRendered, (unsigned long)screenPipeline.tilesChanged,
+      (unsigned long)screenPipeline.tilesSent, (unsigned long)screenPipeline.lastFrameLatency,
+      (unsigned long)screenPipeline.maxFrameLatency);
+    Serial.println("task         runs   missed  over_budget  worst_us  worst_late_us");
+    for (byte t = 0; t < tasks.count; t++) {
+      taskDef& k = tasks.tasks[t];
+      Serial.printf("%-10s %7lu %8lu %12lu %9lu %14lu\n", k.name,
+        (unsigned long)k.runs, (unsigned long)k.missed, (unsigned long)k.overBudget,
+        (unsigned long)k.worstRun, (unsigned long)k.worstLate);
+    }
+    Serial.printf("looper     late max %lu us, queue full %lu\n",
+      (unsigned long)looperDue.worstLate, (unsigned long)looperDue.overflows);
+    Serial.printf("power      idle %lu times, %lu s in all, clock refused %lu\n",
+      (unsigned long)power.idleCount, (unsigned long)(power.totalIdle(runTime) / 1000000),
+      (unsigned long)power.refusals);
+    if(midiD&MIDID_USB)UMIDI.sendSysEx(p - diagSysEx, diagSysEx);
+    if(midiD&MIDID_SER)SMIDI.sendSysEx(p - diagSysEx, diagSysEx);
+  }
+  #endif
   void setupGFX() {
     u8g2.begin();                       // Menu and graphics setup
-    u8g2.setBusClock(1000000);          // Speed up display
+    u8g2.setBusClock(DISPLAY_BUS_CLOCK);  // Speed up display
     u8g2.setContrast(CONTRAST_AWAKE);   // Set contrast
+    screenPipeline.begin(u8g2.getU8x8()); // from here on, the second core owns the I2C bus
     sendToLog("U8G2 graphics initialized.");
   }
-  void screenSaver() {
+  void screenSaver() {    // checked once a second, and right away when the knob is used
+    screenTime = screenTime + (runTime - screenCheckTime);
+    screenCheckTime = runTime;
     if (screenTime <= screenSaverTimeout) {
-      screenTime = screenTime + lapTime;
       if (screenSaverOn) {
         screenSaverOn = 0;
         u8g2.setContrast(CONTRAST_AWAKE);
@@ -1984,7 +3521,6 @@
     for (byte c = 0; c < COLCOUNT; c++) {      // Iterate through each of the column pins.
       byte p = cPin[c];                        // Hold the currently selected column pin in a variable.
       pinMode(p, INPUT_PULLUP);                // Set that column pin to INPUT_PULLUP mode (+3.3V / HIGH).
-      delayMicroseconds(0);                    // delay to energize column and stabilize (may need adjustment)
       for (byte r = 0; r < ROWCOUNT; r++) {    // Then iterate through each of the row pins on the multiplexing chip for the selected column.
        for (byte d = 0; d < 4; d++) {
           digitalWrite(mPin[d], (r >> d) & 1); // Selected multiplexer channel is pulled to ground.
@@ -1994,29 +3530,39 @@
         colorDef tempColor = {HUE_NONE, tempSat, (byte)(toggleWheel ? VALUE_SHADE : VALUE_LOW)};
         strip.setPixelColor(i, getLEDcode(tempColor));
         strip.show();*/
-        delayMicroseconds(14);                  // Delay to allow signal to settle and improve reliability (found this number by experimentation)                 
+        delayMicroseconds(scanSettle.delayFor(c, r));  // Delay to allow signal to settle (calibrated for this board; covers energizing the column too)
         bool didYouPressHex = (digitalRead(p) == LOW);  // hex is pressed if it returns LOW. else not pressed
         h[i].interpBtnPress(didYouPressHex);
         if (h[i].btnState == BTN_STATE_NEWPRESS) {
           h[i].timePressed = runTime;          // log the time
+          TRACE(TRACE_PRESS, i, 0);
+        } else if (h[i].btnState == BTN_STATE_RELEASED) {
+          TRACE(TRACE_RELEASE, i, 0);
         }
       }
       pinMode(p, INPUT);                     // Set the selected column pin back to INPUT mode (0V / LOW).
     }
+    updatePower(0);   // back to full speed before any new note goes out
     for (byte i = 0; i < BTN_COUNT; i++) {   // For all buttons in the deck
       switch (h[i].btnState) {
         case BTN_STATE_NEWPRESS: // just pressed
           if (h[i].isCmd) {
             cmdOn(i);
           } else if (h[i].inScale || (!scaleLock)) {
-            tryMIDInoteOn(i);
-            trySynthNoteOn(i);
+            loopTake.record(runTime, i, h[i].stepsFromC, velWheel.curValue);
+            if (h[i].loopVelocity) {
+              h[i].loopVelocity = 0;   // the key takes over the note the looper was playing
+            } else {
+              tryMIDInoteOn(i);
+              trySynthNoteOn(i);
+            }
           }
           break;
         case BTN_STATE_RELEASED: // just released
           if (h[i].isCmd) {
             cmdOff(i);
           } else if (h[i].inScale || (!scaleLock)) {
+            loopTake.record(runTime, i, h[i].stepsFromC, 0);
             tryMIDInoteOff(i);
             trySynthNoteOff(i); 
           }
@@ -2032,34 +3578,42 @@
     velWheel.setTargetValue();
     bool upd = velWheel.updateValue(runTime);
     if (upd) {
-      sendToLog("vel became " + std::to_string(velWheel.curValue));
+      TRACE(TRACE_WHEEL, TRACE_WHEEL_VEL, velWheel.curValue);
     }
     if (toggleWheel) {
       pbWheel.setTargetValue();
       upd = pbWheel.updateValue(runTime);
       if (upd) {
-        sendMIDIpitchBendToCh1();
+        TRACE(TRACE_WHEEL, TRACE_WHEEL_PB, pbWheel.curValue);
         updateSynthWithNewFreqs();
       }
     } else {
       modWheel.setTargetValue();
       upd = modWheel.updateValue(runTime);
       if (upd) {
-        sendMIDImodulationToCh1();
+        TRACE(TRACE_WHEEL, TRACE_WHEEL_MOD, modWheel.curValue);
+        if (!synthFilter.bypass) updateFilterCutoff();
+        updateFMwheel();
       }
     }
+    sendMIDIwheels(runTime);   // also catches up on anything a port's budget held back
   }
 
+  void wakeScreen() {
+    screenTime = 0;
+    screenCheckTime = runTime;
+    screenSaver();
+  }
   void dealWithRotary() {
     if (menu.readyForKey()) {
       if (knob.getClick()) {
         menu.registerKeyPress(GEM_KEY_OK);
-        screenTime = 0;
+        wakeScreen();
       }
       int getTurn = knob.getTurnFromBuffer();
       if (getTurn != 0) {
         menu.registerKeyPress((getTurn > 0) ? GEM_KEY_UP : GEM_KEY_DOWN);
-        screenTime = 0;
+        wakeScreen();
       }
     }
   }
@@ -2075,6 +3629,105 @@
     }
   }
 
+// @power
+  /*
+    This section of the code slows the board
+    down while nothing is happening, to make
+    a USB battery pack last longer on stage.
+
+    The board is idle when no key is down, the
+    synth is silent, the looper isn't running,
+    and the screensaver is on; src/powerManager.h
+    makes the call, once per key scan. Then:
+      - the system clock drops to POWER_IDLE_KHZ;
+      - the first core sleeps between tasks,
+        and the second between synth samples;
+      - the LEDs hold their last frame. The
+        NeoPixel library sets its timing from the
+        clock once, at the first show(), so the
+        strip is only sent to at full speed.
+    A key press is seen at the next scan, which
+    restores the full clock before the note is
+    sent or sounded; so do an incoming note and
+    starting the looper, as they happen.
+
+    The clock is changed on the second core,
+    since it owns the I2C bus to the screen and
+    can do it between transfers; the first core
+    waits until it's done. Changing the clock
+    resets the peripheral clock to match, which
+    would throw off the serial MIDI baud rate, so
+    that is put back on the fixed 48 MHz USB clock
+    each time (and at start-up, before serial
+    MIDI begins). The I2C rate is set again for
+    the new clock. The synth's PWM slows with the
+    clock, but it is silent while idle; the synth
+    and alarm timings run off the 1 MHz timer,
+    which doesn't change. If the clock can't be
+    set, the second core leaves it as it was and
+    says so, and the board stays at full speed.
+  */
+  #include "hardware/clocks.h"   // library of code to change the processor's clock speed
+  #include "pico/time.h"         // library of code to sleep until a set time
+  #define POWER_IDLE_KHZ 48000
+  #define POWER_PERI_HZ 48000000        // USB PLL
+  #define POWER_LED_LATCH 300           // microseconds for the last LED frame to finish sending
+  uint32_t fullSpeedKHz = 0;            // whatever the board started at
+  volatile byte powerWanted = POWER_FULL;   // set by the first core
+  volatile byte powerNow = POWER_FULL;      // set by the second core, once the clock has changed
+
+  void setupPower() {
+    fullSpeedKHz = clock_get_hz(clk_sys) / 1000;
+    clock_configure(clk_peri, 0, CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB, POWER_PERI_HZ, POWER_PERI_HZ);
+  }
+  byte powerActivity() {
+    byte busy = 0;
+    for (byte i = 0; i < BTN_COUNT; i++) {
+      if (h[i].btnState != BTN_STATE_OFF) {
+        busy |= POWER_BUSY_KEYS;
+        break;
+      }
+    }
+    for (byte i = 0; i < POLYPHONY_LIMIT; i++) {
+      if (synth[i].increment) {
+        busy |= POWER_BUSY_VOICES;
+        break;
+      }
+    }
+    if (!screenSaverOn) busy |= POWER_BUSY_SCREEN;
+    if ((loopTake.state == LOOPER_RECORDING) || (loopTake.state == LOOPER_PLAYING)) busy |= POWER_BUSY_LOOPER;
+    return busy;
+  }
+  // busy: POWER_BUSY_ flags for anything about to start that powerActivity() can't see yet
+  void updatePower(byte busy) {
+    byte want = power.update(runTime, powerActivity() | busy);
+    if (want == powerWanted) return;
+    if (want == POWER_IDLE) {
+      delayMicroseconds(POWER_LED_LATCH);
+    }
+    powerWanted = want;
+    while (powerWanted != powerNow) {
+      tight_loop_contents();   // the second core wakes at least once per synth sample
+    }
+    if (powerNow != want) {
+      power.refused(runTime);
+      sendToLog("power: could not set the clock; staying at full speed");
+    }
+  }
+  // RUN ON CORE 2, between screen transfers
+  void applyPowerMode() {
+    byte want = powerWanted;
+    if (want == powerNow) return;
+    if (!set_sys_clock_khz((want == POWER_IDLE) ? POWER_IDLE_KHZ : fullSpeedKHz, false)) {
+      powerWanted = powerNow;   // unchanged, which lets the first core stop waiting
+      return;
+    }
+    clock_configure(clk_peri, 0, CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB, POWER_PERI_HZ, POWER_PERI_HZ);
+    Wire.setClock(DISPLAY_BUS_CLOCK);
+    PROFILE_CLOCK_CHANGED();
+    powerNow = want;
+  }
+
 // @mainLoop
   /*
     An Arduino program runs
@@ -2091,41 +3744,147 @@
     On the HexBoard, the second core is
     dedicated to two timing-critical tasks:
     running the synth emulator, and tracking
-    the rotary knob inputs.
-    Everything else runs on the first core.
+    the rotary knob inputs. In between knob
+    reads it also sends changed parts of the
+    screen over I2C, so that the first core
+    never has to wait on the display.
+    Everything else runs on the first core,
+    including the arpeggiator and looper,
+    whose steps are timed by alarm interrupts
+    rather than by the loop.
+
+    On the first core, loop() no longer runs
+    every job in turn. Each job is a task with
+    its own period, priority and time budget
+    (see src/taskScheduler.h), and each pass of
+    loop() runs whichever task is due next:
+      looper    when the looper's next note is
+                due, ahead of everything else;
+                otherwise once a second
+      scan      keys, every 4 ms
+      MIDI in   every 2 ms, so the queue
+                filled by USB never backs up
+      wheels    every 4 ms, same as the keys
+      menu      every 10 ms; just reading the
+                knob's buffer if it hasn't moved
+      animate   at the animation frame rate
+      LEDs      at most 60 times a second; the
+                strip takes ~4 ms to send, so
+                sending it once per scan would
+                halve the scan rate
+      saver     the screensaver, once a second
+      scan cal  one column's settle time checked
+                every 4 seconds, only while idle
+    Because no task is interrupted, a key press
+    is seen at most one scan period plus the
+    longest task (the LED refresh) after it
+    happens. The diagnostics page counts missed
+    deadlines and runs that went over budget.
   */
+  #define TASK_LOOPER_PERIOD     1000000  // microseconds; sooner while a loop plays (see @looper)
+  #define TASK_LOOPER_BUDGET     300
+  #define TASK_SCAN_PERIOD       4000
+  #define TASK_SCAN_BUDGET       2500
+  #define TASK_MIDI_IN_PERIOD    2000
+  #define TASK_MIDI_IN_BUDGET    300
+  #define TASK_WHEELS_PERIOD     4000
+  #define TASK_WHEELS_BUDGET     300
+  #define TASK_MENU_PERIOD       10000
+  #define TASK_MENU_BUDGET       3000
+  #define TASK_ANIMATE_BUDGET    1000
+  #define TASK_LEDS_PERIOD       16667    // 60 fps
+  #define TASK_LEDS_BUDGET       5000
+  #define TASK_SAVER_PERIOD      1000000
+  #define TASK_SAVER_BUDGET      100
+  void taskScan() {
+    PROFILE_TASK_START();
+    readHexes();       // Read and store the digital button states of the scanning matrix
+    serviceLooper();   // save or read ahead the looper's file, if the take is long
+    PROFILE_LAP(PROFILE_STAGE_SCAN);
+  }
+  void taskMIDIin() {
+    PROFILE_TASK_START();
+    readMIDI();        // take in MIDI notes, clock and SysEx commands
+    PROFILE_LAP(PROFILE_STAGE_MIDI_IN);
+  }
+  void taskWheels() {
+    PROFILE_TASK_START();
+    updateWheels();   // deal with the pitch/mod wheel
+    PROFILE_LAP(PROFILE_STAGE_WHEELS);
+  }
+  void taskMenu() {
+    PROFILE_TASK_START();
+    dealWithRotary();  // deal with menu
+    PROFILE_LAP(PROFILE_STAGE_MENU);
+  }
+  void taskAnimate() {
+    PROFILE_TASK_START();
+    animateLEDs();     // deal with animations
+    PROFILE_LAP(PROFILE_STAGE_ANIMATE);
+  }
+  void taskLEDs() {
+    if (powerNow != POWER_FULL) return;   // hold the last frame while idle (see @power)
+    PROFILE_TASK_START();
+    lightUpLEDs();      // refresh LEDs
+    PROFILE_LAP(PROFILE_STAGE_LEDS);
+  }
+  void setupTasks() {   // highest priority first
+    uint64_t now = mainClock.now();
+    looperTask = tasks.add("looper", taskLooper, TASK_LOOPER_PERIOD, 7, TASK_LOOPER_BUDGET, now);
+    tasks.add("scan",    taskScan,    TASK_SCAN_PERIOD,    6, TASK_SCAN_BUDGET,    now);
+    tasks.add("midi in", taskMIDIin,  TASK_MIDI_IN_PERIOD, 5, TASK_MIDI_IN_BUDGET, now);
+    tasks.add("wheels",  taskWheels,  TASK_WHEELS_PERIOD,  4, TASK_WHEELS_BUDGET,  now);
+    tasks.add("menu",    taskMenu,    TASK_MENU_PERIOD,    3, TASK_MENU_BUDGET,    now);
+    tasks.add("animate", taskAnimate, (1UL << 20) / animationFPS, 2, TASK_ANIMATE_BUDGET, now);
+    tasks.add("leds",    taskLEDs,    TASK_LEDS_PERIOD,    2, TASK_LEDS_BUDGET,    now);
+    tasks.add("saver",   screenSaver, TASK_SAVER_PERIOD,   1, TASK_SAVER_BUDGET,   now);   // Reduces wear-and-tear on OLED panel
+    tasks.add("scan cal", verifyScanCalibration, SCAN_VERIFY_INTERVAL, 1, SCAN_VERIFY_BUDGET, now);
+  }
   void setup() {
     #if (defined(ARDUINO_ARCH_MBED) && defined(ARDUINO_ARCH_RP2040))
     TinyUSB_Device_Init(0);  // Manual begin() is required on core without built-in support for TinyUSB such as mbed rp2040
     #endif
+    setupPower();      // before serial MIDI begins
     setupMIDI();
     setupFileSystem();
+    setupSampler();
+    setupEffects();    // sized to what the heap has left by now
     Wire.setSDA(SDAPIN);
     Wire.setSCL(SCLPIN);
     setupPins();
+    setupScanCalibration();
     setupGrid();
     applyLayout();
     setupLEDs();
     setupGFX();
     setupMenu();
+    setupArpeggiator();
+    setupLooper();
+    setupTasks();
+    PROFILE_SETUP();
     for (byte i = 0; i < 5 && !TinyUSBDevice.mounted(); i++) {
       delay(1);  // wait until device mounted, maybe
     }
   }
   void loop() {   // run on first core
+    PROFILE_LOOP_START();
     timeTracker();  // Time tracking functions
-    screenSaver();  // Reduces wear-and-tear on OLED panel
-    readHexes();       // Read and store the digital button states of the scanning matrix
-    arpeggiate();      // arpeggiate if synth mode allows it
-    updateWheels();   // deal with the pitch/mod wheel
-    animateLEDs();     // deal with animations
-    lightUpLEDs();      // refresh LEDs
-    dealWithRotary();  // deal with menu
+    byte ran = tasks.runNext(mainClock);
+    PROFILE_LOOP_END(ran != TASK_NONE);
+    if ((ran == TASK_NONE) && (powerNow == POWER_IDLE)) {
+      best_effort_wfe_or_timeout(from_us_since_boot(tasks.nextDeadline()));   // sleep until the next task is due
+    }
   }
   void setup1() {  // set up on second core
+    PROFILE_SETUP_CORE2();
     setupSynth(PIEZO_PIN, PIEZO_SLICE);
     setupSynth(AJACK_PIN, AJACK_SLICE);
   }
   void loop1() {  // run on second core
     knob.update();
+    bool sent = screenPipeline.flush();  // send a few changed tiles of the menu screen, if any
+    applyPowerMode();        // slow down or speed up the clock, if the first core has asked
+    if (!sent && (powerNow == POWER_IDLE)) {
+      __wfe();               // sleep until the next synth sample's interrupt
+    }
   }
@@ -0,0 +1,430 @@
+/*
+  Arpeggiator engine
+
+  This class keeps track of which notes are held, and
+  works out which one to play next and when. It does not
+  touch any hardware: the sketch feeds it key presses,
+  releases, and incoming MIDI clock, and it answers with
+  hex numbers and microsecond timestamps. That way the
+  same code can be run in a simulation on a computer.
+
+  Held notes are kept twice, in small fixed arrays:
+  sorted by pitch (for up / down patterns) and in the
+  order they were pressed (for as-played, and for
+  last-note priority in mono mode). Adding or removing
+  a note shifts at most ARP_MAX_HELD entries; choosing
+  the next step is constant time.
+
+  Each ordering has its own cursor, the index of the note
+  to play next: pitchPos in byPitch (up, down, up/down)
+  and orderPos in byOrder (as played). When a note is
+  added or removed, each cursor is moved by where the
+  change was in its own array, so the pattern carries on
+  from the same note. A new note joins the pattern in
+  its place: next, if it falls between the last step and
+  the next one in the direction of travel.
+
+  Timing is either internal (BPM and a note division),
+  or follows MIDI clock at 24 ticks per quarter note.
+  With MIDI clock, ticks are only seen when the sketch
+  gets round to reading them, so the time each one is
+  read can be late by up to the MIDI task's period (and
+  then some), but never early. The sender's clock is
+  therefore a line under the read times: the earliest
+  reads are the closest to it.
+    The tempo (the line's slope) comes from the lowest
+    read of each beat: the last ARP_CLOCK_BEATS of them
+    are kept, and the slope is taken between the lowest
+    of the oldest quarter and the lowest of the newest.
+    Until there are two beats to go on, an average of
+    the time between ticks stands in for it, and if the
+    two ever differ by more than 1/64 the tempo has
+    changed and the beats are started again.
+    The phase (where the line is) follows each read that
+    is earlier than the line predicted, straight away.
+    At the end of each beat with no such read, the line
+    is raised by part of the smallest lateness seen in
+    it: all of it at first, settling down to 1/64.
+  Steps are scheduled from the line, not from the read
+  times, and Start and Continue schedule the next step
+  from it too, if the clock was already running.
+  tests/arpeggiatorTest.cpp simulates ticks read by a
+  2 ms task that itself runs up to 300 microseconds
+  late. After eight bars, every step is within 120
+  microseconds of the sender's own boundary (nine in
+  ten are within 35), and none is more than 40 early.
+*/
+#pragma once
+#include <stdint.h>
+
+#define ARP_MAX_HELD 32
+
+#define ARP_PATTERN_UP 0
+#define ARP_PATTERN_DOWN 1
+#define ARP_PATTERN_UPDOWN 2
+#define ARP_PATTERN_RANDOM 3
+#define ARP_PATTERN_PLAYED 4
+
+#define ARP_SYNC_INTERNAL 0
+#define ARP_SYNC_MIDI_CLOCK 1
+
+#define ARP_NONE 255                    // same as UNUSED_NOTE
+#define MIDI_CLOCKS_PER_WHOLE_NOTE 96   // 24 per quarter note
+#define MIDI_CLOCKS_PER_BEAT 24
+#define MIDI_CLOCK_TIMEOUT 250000       // microseconds without a tick before the clock counts as stopped
+#define ARP_CLOCK_BEATS 32              // beats kept for the tempo
+
+class arpeggiator {
+  public:
+    arpeggiator() {
+      clear();
+      seed = 0x2545F491;
+      tickInterval = 0;
+      interval256 = 0;
+      rawInterval16 = 0;
+      rawCount = 0;
+      settled = false;
+      chordSpan = 0;
+      beats = 0;
+      tickCount = 0;
+      nextBoundaryTick = 1;
+      tickTime256 = 0;
+      lastTickSeen = 0;
+      restartLine(0);
+      clockRunning = true;   // play along with a clock that was already running when we joined
+    }
+    void clear() {
+      held = 0;
+      pitchPos = 0;
+      orderPos = 0;
+      goingDown = false;
+      descending = false;
+    }
+    uint8_t count() {
+      return held;
+    }
+    bool add(uint8_t hex, int16_t pitch) {
+      if (held >= ARP_MAX_HELD) return false;
+      for (uint8_t i = 0; i < held; i++) {
+        if (byOrder[i] == hex) return true;
+      }
+      uint8_t i = held;
+      while ((i > 0) && (byPitch[i - 1].pitch > pitch)) {
+        byPitch[i] = byPitch[i - 1];
+        i--;
+      }
+      byPitch[i].hex = hex;
+      byPitch[i].pitch = pitch;
+      /*
+        Going up, a note put in at pitchPos lies between the
+        last step and the next one, so it is played next.
+        Going down, that is a note put in just above it.
+      */
+      if (held && ((i < pitchPos) || (descending && (i <= pitchPos + 1)))) {
+        pitchPos++;
+      }
+      byOrder[held] = hex;     // last in order, so orderPos still points at the same note
+      held++;
+      return true;
+    }
+    void remove(uint8_t hex) {
+      uint8_t i = indexOf(byOrder, hex);
+      if (i == ARP_NONE) return;
+      if (i < orderPos) {
+        orderPos--;            // if i == orderPos, the note after it moves into its place
+      }
+      for (; i + 1 < held; i++) {
+        byOrder[i] = byOrder[i + 1];
+      }
+      for (i = 0; (i < held) && (byPitch[i].hex != hex); i++) {}
+      if ((i < pitchPos) || ((i == pitchPos) && descending)) {
+        pitchPos = (pitchPos ? pitchPos : held) - 1;   // going down, the next note is the one below
+      }
+      for (; i + 1 < held; i++) {
+        byPitch[i] = byPitch[i + 1];
+      }
+      held--;
+      if (pitchPos >= held) {
+        pitchPos = (descending && held) ? held - 1 : 0;
+      }
+      if (orderPos >= held) {
+        orderPos = 0;
+      }
+    }
+    uint8_t mostRecent() {     // for last-note priority
+      return (held ? byOrder[held - 1] : ARP_NONE);
+    }
+    /*
+      Advance one step through the held notes in
+      the given pattern and return the hex to play.
+    */
+    uint8_t step(uint8_t pattern) {
+      if (!held) return ARP_NONE;
+      uint8_t result;
+      switch (pattern) {
+        case ARP_PATTERN_DOWN:
+          if (!descending) pitchPos = held - 1;   // start from the top
+          result = byPitch[pitchPos].hex;
+          pitchPos = (pitchPos ? pitchPos : held) - 1;
+          descending = true;
+          break;
+        case ARP_PATTERN_UPDOWN:
+          result = byPitch[pitchPos].hex;
+          if (held == 1) break;
+          if (goingDown) {
+            if (pitchPos == 0) {
+              goingDown = false;
+              pitchPos = 1;
+            } else {
+              pitchPos--;
+            }
+          } else {
+            if (pitchPos == held - 1) {
+              goingDown = true;
+              pitchPos--;
+            } else {
+              pitchPos++;
+            }
+          }
+          descending = goingDown;
+          break;
+        case ARP_PATTERN_RANDOM:
+          seed ^= seed << 13;   // xorshift32
+          seed ^= seed >> 17;
+          seed ^= seed << 5;
+          result = byPitch[seed % held].hex;
+          break;
+        case ARP_PATTERN_PLAYED:
+          result = byOrder[orderPos];
+          orderPos = (orderPos + 1) % held;
+          break;
+        default:   // ARP_PATTERN_UP
+          result = byPitch[pitchPos].hex;
+          pitchPos = (pitchPos + 1) % held;
+          descending = false;
+          break;
+      }
+      return result;
+    }
+    /*
+      Internal tempo. Division is the number of steps per
+      whole note: 4 = quarter notes, 8 = eighths, 12 = eighth
+      note triplets, 16 = sixteenths, and so on.
+    */
+    static uint32_t stepLength(uint16_t bpm, uint8_t division) {
+      if (!bpm || !division) return 0;
+      return 240000000UL / ((uint32_t)bpm * division);
+    }
+    static uint8_t ticksPerStep(uint8_t division) {
+      uint8_t t = (division ? MIDI_CLOCKS_PER_WHOLE_NOTE / division : 0);
+      return (t ? t : 1);
+    }
+    /*
+      MIDI clock. Call clockTick() for every 0xF8 received,
+      clockStart() for 0xFA and clockContinue() for 0xFB.
+      Each returns true if the step schedule changed, in
+      which case nextStep holds the new time for the next
+      step (it may already be in the past, meaning "now").
+      Otherwise, after Start or Continue, nothing is due
+      until the next tick is read.
+    */
+    bool clockStart(uint64_t now, uint64_t& nextStep) {
+      tickCount = 0;
+      nextBoundaryTick = 1;   // the first tick after Start is the downbeat
+      pitchPos = 0;
+      orderPos = 0;
+      goingDown = false;
+      descending = false;
+      clockRunning = true;
+      return stepFromLine(now, nextStep);
+    }
+    void clockStop() {
+      clockRunning = false;
+    }
+    bool clockContinue(uint64_t now, uint64_t& nextStep) {
+      clockRunning = true;
+      return stepFromLine(now, nextStep);
+    }
+    bool clockTick(uint64_t now, uint64_t& nextStep) {
+      if (lastTickSeen && (now - lastTickSeen < MIDI_CLOCK_TIMEOUT)) {
+        int32_t measured = now - lastTickSeen;
+        if (rawCount < 64) rawCount++;
+        rawInterval16 += (measured * 16 - rawInterval16) / rawCount;
+        int32_t drift = rawInterval16 * 16 - (int32_t)interval256;
+        if (settled && ((drift < 0 ? -drift : drift) > (int32_t)(interval256 / 64))) {
+          settled = false;    // the tempo has changed
+          anchorCount = 0;
+          beats = 0;
+          chordSpan = 0;
+          rawCount = 1;
+          rawInterval16 = measured * 16;
+        }
+        if (!settled) interval256 = rawInterval16 * 16;
+        followLine(now);
+      } else {
+        restartLine(now);
+      }
+      lastTickSeen = now;
+      tickInterval = interval256 / 256;
+      if (!clockRunning) return false;   // the song only moves on while it plays
+      tickCount++;
+      if (!tickInterval) return false;
+      if (tickCount >= nextBoundaryTick) {
+        nextStep = now;   // the tick arrived before the predicted step did
+      } else {
+        nextStep = lineAt(nextBoundaryTick - tickCount);
+      }
+      return true;
+    }
+    /*
+      Call when a step has just been played at stepTime.
+      Returns when the next one is due, or 0 if it is
+      not known yet (waiting for MIDI clock).
+    */
+    uint64_t followingStep(uint64_t stepTime, uint64_t now, uint8_t sync, uint16_t bpm, uint8_t division) {
+      if (sync == ARP_SYNC_MIDI_CLOCK) {
+        uint8_t tps = ticksPerStep(division);
+        do {
+          nextBoundaryTick += tps;   // the step just played was for the old boundary
+        } while (nextBoundaryTick <= tickCount);
+        if (!clockRunning || !tickInterval || (now - lastTickSeen > MIDI_CLOCK_TIMEOUT)) {
+          return 0;
+        }
+        return lineAt(nextBoundaryTick - tickCount);
+      }
+      uint64_t next = stepTime + stepLength(bpm, division);
+      if (next <= now) {
+        next = now + stepLength(bpm, division);   // we fell behind; skip rather than play catch-up
+      }
+      return next;
+    }
+    uint32_t tickInterval;    // smoothed microseconds per MIDI clock tick, 0 if unknown
+  private:
+    struct heldNote {
+      uint8_t hex;
+      int16_t pitch;
+    };
+    heldNote byPitch[ARP_MAX_HELD];
+    uint8_t byOrder[ARP_MAX_HELD];
+    uint8_t held;
+    uint8_t pitchPos;         // next in byPitch
+    uint8_t orderPos;         // next in byOrder
+    bool goingDown;           // up/down pattern on its way down
+    bool descending;          // the last pitch step went down, so the next note is below the last
+    uint32_t seed;
+    struct clockAnchor {
+      uint32_t tick;          // since the line was started
+      uint64_t time;
+    };
+    uint32_t interval256;     // the line's slope, in 1/256 microseconds per tick
+    int32_t rawInterval16;    // average time between ticks, in 1/16 microseconds
+    uint8_t rawCount;
+    bool settled;             // interval256 comes from the beats, not the average
+    uint32_t chordSpan;       // ticks between the two beats it came from
+    uint32_t tickCount;
+    uint32_t nextBoundaryTick;
+    uint64_t tickTime256;     // where the line is at the latest tick, in 1/256 microseconds
+    uint64_t lastTickSeen;    // when the latest tick was actually read
+    bool clockRunning;
+    uint64_t lineStart;       // when tick 0 of the line was read
+    uint32_t lineTicks;
+    clockAnchor anchors[ARP_CLOCK_BEATS];   // the lowest read of each beat, oldest first from anchorHead
+    uint8_t anchorHead;
+    uint8_t anchorCount;
+    uint32_t beats;           // since the tempo was last found
+    clockAnchor lowest;       // of this beat so far
+    int64_t lowestBelow;      // how far it is below the line through tick 0, times 256
+    uint32_t leastLate;       // smallest lateness this beat, UINT32_MAX if none
+    bool snapped;             // a read this beat was earlier than the line
+    bool stepFromLine(uint64_t now, uint64_t& nextStep) {   // if the clock kept running, the line knows when the next tick is
+      if (!tickInterval || !lastTickSeen || (now - lastTickSeen >= MIDI_CLOCK_TIMEOUT)) return false;
+      nextStep = (nextBoundaryTick > tickCount) ? lineAt(nextBoundaryTick - tickCount) : now;
+      return true;
+    }
+    void restartLine(uint64_t now) {
+      tickTime256 = now << 8;
+      lineStart = now;
+      lineTicks = 0;
+      anchorHead = 0;
+      anchorCount = 0;
+      lowestBelow = INT64_MAX;
+      leastLate = UINT32_MAX;
+      snapped = false;
+    }
+    uint64_t lineAt(uint32_t ticksAhead) {   // rounded up, so never early
+      return (tickTime256 + (uint64_t)ticksAhead * interval256 + 255) >> 8;
+    }
+    int64_t below(const clockAnchor& a) {
+      return (int64_t)(a.time - lineStart) * 256 - (int64_t)a.tick * interval256;
+    }
+    void followLine(uint64_t now) {
+      lineTicks++;
+      uint64_t predicted = tickTime256 + interval256;
+      if ((now << 8) <= predicted) {
+        tickTime256 = now << 8;   // a tick can be read late, but never early
+        snapped = true;
+      } else {
+        tickTime256 = predicted;
+        uint32_t late = ((now << 8) - predicted) >> 8;
+        if (late < leastLate) leastLate = late;
+      }
+      clockAnchor read = { lineTicks, now };
+      int64_t b = below(read);
+      if (b < lowestBelow) {
+        lowestBelow = b;
+        lowest = read;
+      }
+      if (lineTicks % MIDI_CLOCKS_PER_BEAT == 0) endOfBeat();
+    }
+    void endOfBeat() {
+      beats++;
+      anchors[(anchorHead + anchorCount) % ARP_CLOCK_BEATS] = lowest;
+      if (anchorCount < ARP_CLOCK_BEATS) {
+        anchorCount++;
+      } else {
+        anchorHead = (anchorHead + 1) % ARP_CLOCK_BEATS;
+      }
+      uint8_t quarter = anchorCount / 4;
+      if (!quarter) quarter = 1;
+      const clockAnchor* oldest = lowestOf(0, quarter);
+      const clockAnchor* newest = lowestOf(anchorCount - quarter, quarter);
+      uint32_t span = newest->tick - oldest->tick;
+      if ((span >= 3 * MIDI_CLOCKS_PER_BEAT) && (span * 2 >= chordSpan)) {
+        chordSpan = span;
+        interval256 = ((newest->time - oldest->time) << 8) / (newest->tick - oldest->tick);
+        if (!settled) {           // the beats so far were picked out with the average, so keep only the last
+          anchorHead = (anchorHead + anchorCount - 1) % ARP_CLOCK_BEATS;
+          anchorCount = 1;
+        }
+        settled = true;
+      }
+      if (!snapped && (leastLate != UINT32_MAX)) {
+        uint32_t share = (beats + 1) / 4;    // raise by 1/share: all of it at first, settling down to 1/64
+        if (share < 1) share = 1;
+        if (share > 64) share = 64;
+        tickTime256 += (uint64_t)leastLate * 256 / share;
+      }
+      lowestBelow = INT64_MAX;
+      leastLate = UINT32_MAX;
+      snapped = false;
+    }
+    const clockAnchor* lowestOf(uint8_t first, uint8_t n) {   // first counts from the oldest
+      const clockAnchor* best = nullptr;
+      int64_t bestBelow = INT64_MAX;
+      for (uint8_t i = first; i < first + n; i++) {
+        const clockAnchor* a = &anchors[(anchorHead + i) % ARP_CLOCK_BEATS];
+        int64_t b = below(*a);
+        if (b < bestBelow) {
+          bestBelow = b;
+          best = a;
+        }
+      }
+      return best;
+    }
+    uint8_t indexOf(uint8_t* list, uint8_t hex) {
+      for (uint8_t i = 0; i < held; i++) {
+        if (list[i] == hex) return i;
+      }
+      return ARP_NONE;
+    }
+};
@@ -0,0 +1,216 @@
+/*
+  Synth output effects
+
+  Run on each sample of the built-in synth's mix, after
+  the voices are summed and before the sample goes to
+  the PWM. Everything is in integers, since the poll
+  interrupt has only a few thousand cycles per sample
+  and the RP2040 has no floating point hardware.
+
+  Samples are signed, centred on 0, within +/-32767.
+
+  svFilter is a resonant low-pass state variable filter
+  (the Chamberlin form: two integrators in a loop). Its
+  cutoff and damping are coefficients in 1/4096ths,
+  worked out by the sketch in the main loop whenever they
+  change, so the interrupt only multiplies and adds. This
+  form goes unstable when the cutoff nears a sixth of the
+  sample rate, so keep it below that.
+
+  delayLine keeps the last few thousand samples in a ring
+  buffer and mixes a delayed copy back in,
+  either as an echo (a fixed delay fed back into itself)
+  or as a chorus (a short delay swept slowly back and
+  forth, read between samples). Every mix is a crossfade,
+  with weights that add up to one, so it can never clip
+  or drift: the echo tails off toward whatever is playing
+  now, including the resting level of silence.
+
+  The delay's buffer is handed to it once, at start-up,
+  by the sketch, which sizes it to the RAM left over (up
+  to FX_DELAY_MAX_SAMPLES). New settings are picked up by
+  process() itself, on the synth's core: it then clears
+  the buffer a little at a time, playing the input dry
+  until it is done, so the main loop never writes to the
+  buffer while the synth is reading it.
+
+  Each effect has a bypass flag; the sketch checks it
+  before calling process(), so an effect that is off costs
+  a single test per sample. Nothing here touches hardware.
+*/
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+#define FX_ONE 4096                   // coefficients are in 1/4096ths
+#define FX_SAMPLE_MAX 32767
+#define FX_DELAY_MAX_SAMPLES 32768    // 64 kB, about 0.8 s at the synth's sample rate
+#define FX_DELAY_MIN_SAMPLES 1024     // enough for a chorus
+#define FX_DELAY_CLEAR_STEP 256       // samples cleared per call, after a change
+#define FX_FILTER_BAND_LIMIT 131072   // keeps the resonance from winding up past what the math can hold
+
+inline int32_t fxClip(int32_t x) {
+  return (x > FX_SAMPLE_MAX) ? FX_SAMPLE_MAX : ((x < -FX_SAMPLE_MAX) ? -FX_SAMPLE_MAX : x);
+}
+
+class svFilter {
+  public:
+    svFilter() {
+      bypass = true;
+      cutoff = FX_ONE / 2;
+      damping = FX_ONE;
+      clear();
+    }
+    void clear() {
+      low = 0;
+      band = 0;
+    }
+    /*
+      cutoff = 2 sin(pi * Hz / sample rate) in 1/4096ths.
+      damping = 1 / Q in 1/4096ths (5793 is Q = 0.707, no
+      peak; smaller values ring more at the cutoff).
+    */
+    void set(int32_t _cutoff, int32_t _damping) {
+      cutoff = _cutoff;
+      damping = _damping;
+    }
+    int32_t process(int32_t x) {
+      low += (cutoff * band) >> 12;
+      int32_t high = x - low - ((damping * band) >> 12);
+      band += (cutoff * high) >> 12;
+      if (band > FX_FILTER_BAND_LIMIT) band = FX_FILTER_BAND_LIMIT;
+      if (band < -FX_FILTER_BAND_LIMIT) band = -FX_FILTER_BAND_LIMIT;
+      if (low > FX_FILTER_BAND_LIMIT) low = FX_FILTER_BAND_LIMIT;
+      if (low < -FX_FILTER_BAND_LIMIT) low = -FX_FILTER_BAND_LIMIT;
+      return fxClip(low);
+    }
+    volatile bool bypass;
+  private:
+    volatile int32_t cutoff;
+    volatile int32_t damping;
+    int32_t low;
+    int32_t band;
+};
+
+#define FX_DELAY_ECHO 0
+#define FX_DELAY_CHORUS 1
+
+struct delaySettings {
+  uint8_t mode;
+  uint16_t length;     // samples
+  uint16_t sweep;      // samples either side of length, for chorus
+  uint32_t lfoStep;
+  int32_t feedback;    // out of 256
+  int32_t wet;
+};
+
+class delayLine {
+  public:
+    delayLine() {
+      bypass = true;
+      buffer = nullptr;
+      mask = 0;
+      cleared = 0;
+      pos = 0;
+      lfoPhase = 0;
+      next.mode = FX_DELAY_ECHO;
+      next.length = 0;
+      next.sweep = 0;
+      next.lfoStep = 0;
+      next.feedback = 0;
+      next.wet = 0;
+      now = next;
+      changed = false;
+    }
+    /*
+      Call once, before the delay is switched on. The
+      buffer is samples long, a power of 2.
+    */
+    void begin(int16_t* _buffer, uint32_t samples) {
+      buffer = _buffer;
+      mask = samples - 1;
+      clear();
+    }
+    uint32_t samples() {
+      return buffer ? mask + 1 : 0;
+    }
+    // start again from silence, once the synth's core gets to it
+    void clear() {
+      __sync_synchronize();
+      changed = true;
+    }
+    /*
+      Echo: repeats every delay samples. feedback and
+      wet are out of 256.
+    */
+    void setEcho(uint16_t delay, uint8_t _feedback, uint8_t _wet) {
+      next.mode = FX_DELAY_ECHO;
+      next.length = (delay <= mask) ? delay : mask;
+      next.sweep = 0;
+      next.lfoStep = 0;
+      next.feedback = _feedback;
+      next.wet = _wet;
+      clear();
+    }
+    /*
+      Chorus: the delay sweeps between centre - depth and
+      centre + depth samples, lfoRate times per 2^32
+      samples (i.e. Hz * 2^32 / sample rate). The centre
+      is kept between 1 sample and half the buffer, and
+      the sweep never reaches back past now.
+    */
+    void setChorus(uint16_t centre, uint16_t depth, uint32_t lfoRate, uint8_t _wet) {
+      if (centre > mask / 2) centre = mask / 2;
+      if (centre < 1) centre = 1;
+      next.mode = FX_DELAY_CHORUS;
+      next.length = centre;
+      next.sweep = (depth < centre) ? depth : centre - 1;
+      next.lfoStep = lfoRate;
+      next.feedback = 0;
+      next.wet = _wet;
+      clear();
+    }
+    int32_t process(int32_t x) {
+      if (changed) {
+        changed = false;
+        __sync_synchronize();
+        now = next;      // if it changes again meanwhile, changed is set again
+        cleared = 0;
+        pos = 0;
+        lfoPhase = 0;
+      }
+      if (cleared <= mask) {
+        uint32_t n = mask + 1 - cleared;
+        if (n > FX_DELAY_CLEAR_STEP) n = FX_DELAY_CLEAR_STEP;
+        memset(buffer + cleared, 0, n * sizeof(int16_t));
+        cleared += n;
+        return x;
+      }
+      int32_t d;
+      if (now.mode == FX_DELAY_CHORUS) {
+        lfoPhase += now.lfoStep;
+        uint32_t tri = (lfoPhase >> 15) ^ ((lfoPhase >> 31) ? 0x1FFFF : 0);  // 0 to 65535 and back
+        uint32_t behind = ((uint32_t)(now.length - now.sweep) << 8) + ((tri * now.sweep * 2) >> 8);  // in 1/256 samples
+        uint32_t i = pos - (behind >> 8);
+        int32_t a = buffer[i & mask];
+        int32_t b = buffer[(i - 1) & mask];
+        d = a + (((b - a) * (int32_t)(behind & 0xFF)) >> 8);
+        buffer[pos & mask] = x;
+      } else {
+        d = buffer[(pos - now.length) & mask];
+        buffer[pos & mask] = x + ((now.feedback * (d - x)) >> 8);
+      }
+      pos++;
+      return x + ((now.wet * (d - x)) >> 8);
+    }
+    volatile bool bypass;
+  private:
+    int16_t* buffer;
+    uint32_t mask;                // samples - 1
+    uint32_t cleared;             // samples cleared since the last change
+    uint32_t pos;
+    uint32_t lfoPhase;
+    delaySettings now;            // used by process(), on the synth's core
+    delaySettings next;           // set from the main loop
+    volatile bool changed;
+};
@@ -171,10 +171,21 @@
   #define WAVEFORM_SINE 0
   #define WAVEFORM_STRINGS 1
   #define WAVEFORM_CLARINET 2
+  #define WAVEFORM_FM 3
+  #define WAVEFORM_SAMPLER 4
   #define WAVEFORM_HYBRID 7
   #define WAVEFORM_SQUARE 8
   #define WAVEFORM_SAW 9
   #define WAVEFORM_TRIANGLE 10 
+
+  #define FILTER_OFF 0
+  #define FILTER_SOFT 1
+  #define FILTER_RESONANT 2
+
+  #define DELAY_OFF 0
+  #define DELAY_CHORUS 1
+  #define DELAY_ECHO 2
+  #define DELAY_LONG_ECHO 3
 	
 	#define RAINBOW_MODE 0
   #define TIERED_COLOR_MODE 1
@@ -216,13 +227,41 @@
   #define MIDID_BOTH 3
 
   /*
-    When sending smoothly-varying pitch bend
-    or modulation messages over MIDI, the
-    code uses a cool-down period of about
-    1/30 of a second in between messages, enough
-    for changes to sound continuous without
-    overloading the MIDI message queue.
+    Wheel speeds are given as how far the
+    value moves in about 1/30 of a second.
+    The mod and pitch bend wheels have a
+    14 bit range, the velocity wheel 7 bits.
   */
-  #define CC_MSG_COOLDOWN_MICROSECONDS 32768
+  #define WHEEL_SPEED_MICROSECONDS 32768
+  #define MOD_WHEEL_MAX 16383
+  /*
+    Pitch bend and modulation messages are
+    sent as often as each port's budget
+    allows (see src/wheelStream.h). Serial
+    MIDI carries about 3125 bytes a second,
+    so the wheels get a quarter of it and
+    notes keep the rest. USB is far faster,
+    but synths don't gain anything from more
+    than about a thousand updates a second.
+  */
+  #define WHEEL_SER_BYTES_PER_SECOND 800
+  #define WHEEL_USB_BYTES_PER_SECOND 6000
+  #define WHEEL_BURST_BYTES 12
+
+  #define WHEEL_TO_CH1 0
+  #define WHEEL_PER_NOTE 1
 	
   #define DIAGNOSTICS_ON true 
+  /*
+    Cycle-counting instrumentation of the main loop
+    and the synth interrupt, reported on the
+    Advanced > Diagnostics menu page. Set to false
+    to compile it out entirely.
+  */
+  #define PROFILING_ON true
+  /*
+    Binary trace of key, MIDI, and synth events kept
+    in a RAM ring buffer (see src/traceRecorder.h).
+    Cheap enough to leave on; false compiles it out.
+  */
+  #define TRACE_ON true
@@ -0,0 +1,307 @@
+/*
+  Asynchronous, partial-update display pipeline
+
+  The U8g2 library renders the menu into a full-screen
+  framebuffer and then pushes every page of it over I2C.
+  On a 128x128 screen that is 2 KB per redraw, which is
+  several milliseconds of bus time even at 1 MHz.
+
+  This class intercepts the U8x8 display callback. Instead
+  of transmitting, the tiles U8g2 wants to draw (8 x 8 pixels,
+  8 bytes each) are compared to the last frame that actually
+  went out to the screen, and changed tiles are flagged dirty.
+  Contrast changes are captured in the same way (only the
+  latest one matters), and any other command, such as power
+  save, is queued to be sent in order.
+
+  Nothing touches the I2C bus until flush() is called, which
+  sends at most one run of dirty tiles from one page per call.
+  The sketch calls flush() from the second core, so the key
+  scan and LED loop on the first core never wait on the display.
+*/
+#pragma once
+#include <Arduino.h>
+#include <U8g2lib.h>
+#include "softTimer.h"
+#include "pico/critical_section.h"
+
+#define DISPLAY_TILE_COLS 16          // 128 pixels / 8
+#define DISPLAY_TILE_ROWS 16          // 128 pixels / 8 (a "page" in SH1107 terms)
+#define DISPLAY_TILE_BYTES 8
+#define DISPLAY_TILES_PER_FLUSH 4     // 32 bytes ~ 0.35ms at 1MHz; keeps each flush() short
+#define DISPLAY_COMMAND_QUEUE 8       // commands other than tiles and contrast, waiting to be sent; a power of 2
+#define DISPLAY_COMMAND_WAIT 250000   // microseconds to wait for room in the queue before giving up on a command
+
+struct displayCommand {
+  uint8_t msg;
+  uint8_t arg;
+};
+
+class displayPipeline {
+  public:
+    displayPipeline();                  // declare constructor
+    void begin(u8x8_t* _u8x8);          // declare function to hook the U8x8 display callback (after u8g2.begin())
+    bool flush();                       // declare function to send one run of dirty tiles, returns true if anything was sent
+    bool isClean();                     // declare function to return whether the screen matches the last rendered frame
+    void waitUntilClean(uint32_t timeout_uS);
+                                        // declare function to block until the other core has sent everything
+    uint8_t capture(uint8_t msg, uint8_t arg_int, void* arg_ptr);
+                                        // declare function that replaces the display callback
+    // frame-time statistics
+    uint32_t framesRendered;            // sendBuffer() calls captured
+    uint32_t tilesChanged;              // tiles that differed from what is on screen
+    uint32_t tilesSent;                 // tiles actually transmitted
+    uint32_t pagesSkipped;              // pages captured without any change
+    uint32_t lastRenderTime;            // microseconds spent capturing the last frame
+    uint32_t maxRenderTime;
+    uint32_t lastFlushTime;             // microseconds spent in the last non-empty flush()
+    uint32_t maxFlushTime;
+    uint32_t lastFrameLatency;          // microseconds from capture until the screen was clean again
+    uint32_t maxFrameLatency;
+    uint32_t commandsDropped;           // commands that never found room in the queue
+    void resetStats();
+  private:
+    u8x8_t* u8x8;
+    u8x8_msg_cb sendTile;               // the original U8x8 display callback
+    critical_section_t lock;
+    uint8_t frame[DISPLAY_TILE_ROWS][DISPLAY_TILE_COLS][DISPLAY_TILE_BYTES];
+    uint8_t onScreen[DISPLAY_TILE_ROWS][DISPLAY_TILE_COLS][DISPLAY_TILE_BYTES];
+    uint8_t txBuffer[DISPLAY_TILES_PER_FLUSH * DISPLAY_TILE_BYTES];
+    volatile uint16_t dirty[DISPLAY_TILE_ROWS];  // one bit per tile column
+    volatile uint16_t contrast;         // bit 8 flags a pending change
+    displayCommand commands[DISPLAY_COMMAND_QUEUE];
+    volatile uint8_t commandHead;       // written by the first core
+    volatile uint8_t commandTail;       // written by the second core
+    volatile bool active;
+    uint8_t nextPage;                   // round-robin so one busy page cannot starve the rest
+    uint64_t frameStart;
+    uint64_t dirtySince;                // 0 if clean; only touched with the lock held
+    bool queueCommand(uint8_t msg, uint8_t arg);
+    bool sendCommands();
+    bool anyDirty();
+};
+
+displayPipeline* activeDisplayPipeline = nullptr;
+
+uint8_t displayPipelineCallback(u8x8_t* u8x8, uint8_t msg, uint8_t arg_int, void* arg_ptr) {
+  return activeDisplayPipeline->capture(msg, arg_int, arg_ptr);
+}
+
+displayPipeline::displayPipeline() {
+  u8x8 = nullptr;
+  sendTile = nullptr;
+  contrast = 0;
+  commandHead = 0;
+  commandTail = 0;
+  active = false;
+  nextPage = 0;
+  dirtySince = 0;
+  for (byte r = 0; r < DISPLAY_TILE_ROWS; r++) {
+    dirty[r] = 0;
+  }
+  resetStats();
+}
+
+void displayPipeline::resetStats() {
+  framesRendered = 0;
+  tilesChanged = 0;
+  tilesSent = 0;
+  pagesSkipped = 0;
+  lastRenderTime = 0;
+  maxRenderTime = 0;
+  lastFlushTime = 0;
+  maxFlushTime = 0;
+  lastFrameLatency = 0;
+  maxFrameLatency = 0;
+  commandsDropped = 0;
+}
+
+void displayPipeline::begin(u8x8_t* _u8x8) {
+  critical_section_init(&lock);
+  u8x8 = _u8x8;
+  sendTile = u8x8->display_cb;
+  // whatever begin() left on screen is unknown, so force the first frame out in full
+  memset(frame, 0, sizeof(frame));
+  memset(onScreen, 0xFF, sizeof(onScreen));
+  activeDisplayPipeline = this;
+  u8x8->display_cb = displayPipelineCallback;
+  active = true;
+}
+
+uint8_t displayPipeline::capture(uint8_t msg, uint8_t arg_int, void* arg_ptr) {
+  switch (msg) {
+    case U8X8_MSG_DISPLAY_DRAW_TILE: {
+      u8x8_tile_t* t = (u8x8_tile_t*)arg_ptr;
+      uint8_t row = t->y_pos;
+      if (row >= DISPLAY_TILE_ROWS) return 1;
+      uint64_t now = getTheCurrentTime();
+      if (row == 0) {
+        frameStart = now;
+      }
+      uint8_t col = t->x_pos;
+      uint16_t changed = 0;
+      uint16_t covered = 0;
+      critical_section_enter_blocking(&lock);
+      for (uint8_t rep = 0; rep < arg_int; rep++) {   // U8x8 may repeat the same tile data arg_int times
+        uint8_t* src = t->tile_ptr;
+        for (uint8_t k = 0; k < t->cnt; k++) {
+          if (col < DISPLAY_TILE_COLS) {
+            covered |= (1u << col);
+            memcpy(frame[row][col], src, DISPLAY_TILE_BYTES);
+            if (memcmp(frame[row][col], onScreen[row][col], DISPLAY_TILE_BYTES)) {
+              changed |= (1u << col);
+            }
+          }
+          src += DISPLAY_TILE_BYTES;
+          col++;
+        }
+      }
+      if (changed && !dirtySince) {
+        dirtySince = now;
+      }
+      dirty[row] = (dirty[row] & ~covered) | changed;   // a tile drawn back to what is on screen needs no resend
+      critical_section_exit(&lock);
+      if (changed) {
+        tilesChanged += __builtin_popcount(changed);
+      } else {
+        pagesSkipped++;
+      }
+      if (row == DISPLAY_TILE_ROWS - 1) {
+        framesRendered++;
+        lastRenderTime = getTheCurrentTime() - frameStart;
+        if (lastRenderTime > maxRenderTime) maxRenderTime = lastRenderTime;
+      }
+      return 1;
+    }
+    case U8X8_MSG_DISPLAY_SET_CONTRAST:
+      critical_section_enter_blocking(&lock);
+      contrast = 0x100 | arg_int;
+      critical_section_exit(&lock);
+      return 1;
+    default:
+      /*
+        The second core may be partway through sending
+        tiles, so the bus isn't ours: queue the command
+        for flush(). After begin(), U8g2 only sends
+        commands that carry an arg_int (power save, flip
+        mode, init, refresh), never a pointer.
+      */
+      return queueCommand(msg, arg_int);
+  }
+}
+
+bool displayPipeline::queueCommand(uint8_t msg, uint8_t arg) {
+  uint64_t start = getTheCurrentTime();
+  while ((uint8_t)(commandHead - commandTail) >= DISPLAY_COMMAND_QUEUE) {
+    if (getTheCurrentTime() - start >= DISPLAY_COMMAND_WAIT) {
+      commandsDropped++;
+      return 0;
+    }
+    tight_loop_contents();
+  }
+  critical_section_enter_blocking(&lock);
+  displayCommand& c = commands[commandHead & (DISPLAY_COMMAND_QUEUE - 1)];
+  c.msg = msg;
+  c.arg = arg;
+  commandHead = commandHead + 1;
+  critical_section_exit(&lock);
+  return 1;
+}
+
+// send the latest contrast and the oldest queued command, if any; returns true if anything was sent
+bool displayPipeline::sendCommands() {
+  critical_section_enter_blocking(&lock);
+  uint16_t c = contrast;
+  contrast = 0;
+  bool queued = (commandHead != commandTail);
+  displayCommand cmd = commands[commandTail & (DISPLAY_COMMAND_QUEUE - 1)];
+  critical_section_exit(&lock);
+  if (c) {
+    sendTile(u8x8, U8X8_MSG_DISPLAY_SET_CONTRAST, (uint8_t)c, nullptr);
+  }
+  if (queued) {
+    sendTile(u8x8, cmd.msg, cmd.arg, nullptr);
+    critical_section_enter_blocking(&lock);
+    commandTail = commandTail + 1;
+    if (cmd.msg == U8X8_MSG_DISPLAY_INIT) {
+      // the screen has been cleared, so everything has to go out again
+      memset(onScreen, 0xFF, sizeof(onScreen));
+      for (uint8_t r = 0; r < DISPLAY_TILE_ROWS; r++) {
+        dirty[r] = 0xFFFF;
+      }
+      if (!dirtySince) dirtySince = getTheCurrentTime();
+    }
+    critical_section_exit(&lock);
+  }
+  return (c || queued);
+}
+
+bool displayPipeline::anyDirty() {
+  for (uint8_t r = 0; r < DISPLAY_TILE_ROWS; r++) {
+    if (dirty[r]) return true;
+  }
+  return false;
+}
+
+bool displayPipeline::flush() {
+  if (!active) return false;
+  uint64_t start = getTheCurrentTime();
+  bool commandSent = sendCommands();
+  uint8_t row = DISPLAY_TILE_ROWS;
+  for (uint8_t i = 0; i < DISPLAY_TILE_ROWS; i++) {
+    uint8_t r = (nextPage + i) % DISPLAY_TILE_ROWS;
+    if (dirty[r]) {
+      row = r;
+      break;
+    }
+  }
+  if (row == DISPLAY_TILE_ROWS) {
+    critical_section_enter_blocking(&lock);
+    if (dirtySince && !anyDirty()) {      // a new frame may have started since the pages were checked
+      lastFrameLatency = start - dirtySince;
+      if (lastFrameLatency > maxFrameLatency) maxFrameLatency = lastFrameLatency;
+      dirtySince = 0;
+    }
+    critical_section_exit(&lock);
+    return commandSent;
+  }
+  u8x8_tile_t t;
+  critical_section_enter_blocking(&lock);
+  uint16_t mask = dirty[row];
+  uint8_t first = __builtin_ctz(mask);
+  uint8_t last = first;
+  // a run may include unchanged tiles in between; resending those is cheaper than another address setup
+  for (uint8_t col = first + 1; (col < DISPLAY_TILE_COLS) && (col < first + DISPLAY_TILES_PER_FLUSH); col++) {
+    if (mask & (1u << col)) last = col;
+  }
+  for (uint8_t col = first; col <= last; col++) {
+    memcpy(onScreen[row][col], frame[row][col], DISPLAY_TILE_BYTES);
+    memcpy(&txBuffer[(col - first) * DISPLAY_TILE_BYTES], frame[row][col], DISPLAY_TILE_BYTES);
+  }
+  mask &= ~(((1u << (last + 1)) - 1) & ~((1u << first) - 1));
+  dirty[row] = mask;
+  critical_section_exit(&lock);
+  if (!mask) {
+    nextPage = (row + 1) % DISPLAY_TILE_ROWS;
+  }
+  t.tile_ptr = txBuffer;
+  t.cnt = last + 1 - first;
+  t.x_pos = first;
+  t.y_pos = row;
+  sendTile(u8x8, U8X8_MSG_DISPLAY_DRAW_TILE, 1, &t);
+  tilesSent += t.cnt;
+  lastFlushTime = getTheCurrentTime() - start;
+  if (lastFlushTime > maxFlushTime) maxFlushTime = lastFlushTime;
+  return true;
+}
+
+bool displayPipeline::isClean() {
+  return !anyDirty() && (contrast == 0) && (commandHead == commandTail);
+}
+
+void displayPipeline::waitUntilClean(uint32_t timeout_uS) {
+  uint64_t start = getTheCurrentTime();
+  while (active && !isClean() && (getTheCurrentTime() - start < timeout_uS)) {
+    tight_loop_contents();
+  }
+}
@@ -0,0 +1,119 @@
+/*
+  Two-operator FM voice
+
+  A modulator sine wave pushes the phase of a carrier
+  sine wave back and forth. The modulator runs at a fixed
+  ratio to the carrier's frequency, and how far it pushes
+  (the index) sets how bright the tone is: 0 is a pure
+  sine, and more adds sidebands spaced at the modulator's
+  frequency. Whole number ratios sound harmonic (reeds,
+  brass, electric piano); others sound like bells.
+
+  Each note starts at a peak index and settles toward a
+  resting index, the way a struck or blown sound is
+  brightest at the start. The mod wheel adds to the index
+  on top of that.
+
+  Everything is in integers, for the synth interrupt:
+    phase   16 bits per cycle, the same as the other
+            waveforms' counters, so the carrier is simply
+            the voice's own counter
+    index   in phase units, i.e. 65536 pushes the phase a
+            whole cycle (2 pi radians) at the modulator's
+            peak; held in 1/256ths so a slow settle still
+            moves
+    ratio   modulator / carrier frequency, in 1/256ths
+
+  Both operators read the same sine table, worked out by
+  the compiler (a Taylor series, to stay constexpr) and
+  kept in flash; it is small enough to stay in the XIP
+  cache while notes are playing.
+*/
+#pragma once
+#include <stdint.h>
+
+#define FM_SINE_BITS 10
+#define FM_SINE_SIZE (1 << FM_SINE_BITS)
+#define FM_SINE_SHIFT (16 - FM_SINE_BITS)
+#define FM_INDEX_MAX 65535
+#define FM_RATIO_ONE 256
+#define FM_RADIAN 10430               // index units per radian, 65536 / 2 pi
+
+// sin x, for x within +/- pi / 2
+constexpr double fmSinSeries(double x) {
+  double term = x;
+  double sum = x;
+  for (int n = 1; n < 12; n++) {
+    term *= -x * x / ((2.0 * n) * (2.0 * n + 1.0));
+    sum += term;
+  }
+  return sum;
+}
+constexpr int16_t fmSineAt(uint16_t i) {
+  uint16_t j = i % (FM_SINE_SIZE / 2);
+  if (j > FM_SINE_SIZE / 4) {
+    j = (FM_SINE_SIZE / 2) - j;
+  }
+  double v = 32767.0 * fmSinSeries(j * 6.283185307179586 / FM_SINE_SIZE);
+  int16_t s = (int16_t)(v + 0.5);
+  return (i >= FM_SINE_SIZE / 2) ? -s : s;
+}
+struct fmSineTable {
+  int16_t at[FM_SINE_SIZE];
+};
+constexpr fmSineTable makeFMsineTable() {
+  fmSineTable table = {};
+  for (uint16_t i = 0; i < FM_SINE_SIZE; i++) {
+    table.at[i] = fmSineAt(i);
+  }
+  return table;
+}
+constexpr fmSineTable fmSine = makeFMsineTable();
+
+struct fmPreset {
+  const char* name;        // limit is 7 characters for the GEM menu
+  uint16_t ratio;          // in 1/256ths
+  uint16_t peakIndex;      // at the start of each note
+  uint16_t restIndex;      // where it settles
+  uint8_t settle;          // the gap to the resting index shrinks by 1/2^settle each sample
+};
+
+class fmVoice {
+  public:
+    fmVoice() {
+      modCounter = 0;
+      modIncrement = 0;
+      index = 0;
+    }
+    /*
+      Set the modulator to go with the carrier's
+      increment. Called whenever the pitch changes.
+    */
+    void tune(uint16_t carrierIncrement, uint16_t ratio) {
+      uint32_t m = ((uint32_t)carrierIncrement * ratio) / FM_RATIO_ONE;
+      modIncrement = (m > 32767 ? 32767 : m);     // past half the sample rate it would alias
+    }
+    // start a note at the peak index
+    void trigger(uint16_t peakIndex) {
+      modCounter = 0;
+      index = (uint32_t)peakIndex << 8;
+    }
+    /*
+      The next sample, 0 to 65535 like the other waveforms,
+      for a carrier at the given phase. wheelIndex is added
+      on top of this note's own index.
+    */
+    uint16_t next(uint16_t carrierPhase, uint16_t restIndex, uint8_t settle, uint16_t wheelIndex) {
+      index += (((int32_t)restIndex << 8) - (int32_t)index) >> settle;
+      modCounter += modIncrement;
+      uint32_t depth = (index >> 8) + wheelIndex;
+      if (depth > FM_INDEX_MAX) depth = FM_INDEX_MAX;
+      int32_t m = fmSine.at[modCounter >> FM_SINE_SHIFT];
+      uint16_t phase = carrierPhase + (uint16_t)((m * (int32_t)depth) >> 15);
+      return 32768 + fmSine.at[phase >> FM_SINE_SHIFT];
+    }
+  private:
+    uint16_t modCounter;
+    uint16_t modIncrement;
+    int32_t index;            // in 1/256ths
+};
@@ -1,41 +1,70 @@
-	#pragma once
-	#include <Arduino.h>
-	#include "constants.h"
-
-// @helpers
-  /*
-    C++ returns a negative value for 
-    negative N % D. This function
-    guarantees the mod value is always
-    positive.
-  */
-  int positiveMod(int n, int d) {
-    return (((n % d) + d) % d);
-  }
-  /*
-    There may already exist linear interpolation
-    functions in the standard library. This one is helpful
-    because it will do the weighting division for you.
-    It only works on byte values since it's intended
-    to blend color values together. A better C++
-    coder may be able to allow automatic type casting here.
-  */
-  byte byteLerp(byte xOne, byte xTwo, float yOne, float yTwo, float y) {
-    float weight = (y - yOne) / (yTwo - yOne);
-    int temp = xOne + ((xTwo - xOne) * weight);
-    if (temp < xOne) {temp = xOne;}
-    if (temp > xTwo) {temp = xTwo;}
-    return temp;
-  }
-
-// @diagnostics
-  /*
-    This section of the code handles
-    optional sending of log messages
-    to the Serial port
-  */
-  void sendToLog(std::string msg) {
-    if (DIAGNOSTICS_ON) {
-      Serial.println(msg.c_str());
-    }
+	#pragma once
+	#include <Arduino.h>
+	#include "constants.h"
+
+// @helpers
+  /*
+    C++ returns a negative value for 
+    negative N % D. This function
+    guarantees the mod value is always
+    positive.
+  */
+  int positiveMod(int n, int d) {
+    return (((n % d) + d) % d);
+  }
+  /*
+    There may already exist linear interpolation
+    functions in the standard library. This one is helpful
+    because it will do the weighting division for you.
+    It only works on byte values since it's intended
+    to blend color values together. A better C++
+    coder may be able to allow automatic type casting here.
+  */
+  byte byteLerp(byte xOne, byte xTwo, float yOne, float yTwo, float y) {
+    float weight = (y - yOne) / (yTwo - yOne);
+    int temp = xOne + ((xTwo - xOne) * weight);
+    if (temp < xOne) {temp = xOne;}
+    if (temp > xTwo) {temp = xTwo;}
+    return temp;
+  }
+  /*
+    A first-in, first-out list of up to 16
+    channel numbers, kept in a fixed array.
+    It works like std::queue, but never
+    allocates memory, so notes can be started
+    and stopped from inside an interrupt.
+  */
+  class channelQueue {
+  public:
+    bool empty() {
+      return (head == tail);
+    }
+    byte front() {
+      return list[tail & 15];
+    }
+    void pop() {
+      if (!empty()) tail++;
+    }
+    void push(byte ch) {
+      if ((byte)(head - tail) < 16) list[(head++) & 15] = ch;
+    }
+  private:
+    byte list[16];
+    byte head = 0;
+    byte tail = 0;
+  };
+
+// @diagnostics
+  /*
+    This section of the code handles
+    optional sending of log messages
+    to the Serial port
+  */
+  void sendToLog(const char* msg) {    // for messages formatted into a buffer, without allocating
+    if (DIAGNOSTICS_ON) {
+      Serial.println(msg);
+    }
+  }
+  void sendToLog(std::string msg) {
+    sendToLog(msg.c_str());
   }
\ No newline at end of file
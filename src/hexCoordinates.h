@@ -2,5 +2,117 @@
        Hexagonal coordinates
          https://www.redblobgames.com/grids/hexagons/
          http://ondras.github.io/rot.js/manual/#hex/indexing
+
+  The hexes are numbered in rows of HEX_GRID_COLS, each
+  row shifted half a hex right of the one above (odd
+  rows) or left (even rows). The sketch keeps each hex's
+  place in "doubled" coordinates: the row, and a column
+  that counts half hexes, so that neighbors across are 2
+  apart. vertical[] and horizontal[] are one step in each
+  HEX_DIRECTION_ in those coordinates, for walking around
+  the grid.
+
+  Pitch, and turning or flipping the grid, are easier in
+  axial coordinates: q counts hexes east, r counts hexes
+  down-right (south-east), and the third cube coordinate
+  s = -q - r is implied. One step east is one "across"
+  step of a layout; one step south-west (q - 1, r + 1)
+  is one "down-left" step.
+
+  hexTransformed[t][i] is hex i's axial coordinates after
+  transform t: turning the grid t x 60 degrees clockwise
+  about hex 0, mirrored left to right first if t is
+  HEX_MIRRORED or more. The table is worked out by the
+  compiler and kept in flash. Reading a layout off the
+  transformed coordinates of each hex turns (or flips)
+  the layout on the board, and any hex can be the centre,
+  since the steps only depend on the difference between
+  two hexes' coordinates.
 */
+#pragma once
+#include <stdint.h>
+
+#define HEX_GRID_COLS 10
+#define HEX_GRID_HEXES 140         // same as LED_COUNT
+
+#define HEX_DIRECTION_EAST 0
+#define HEX_DIRECTION_NE 1
+#define HEX_DIRECTION_NW 2
+#define HEX_DIRECTION_WEST 3
+#define HEX_DIRECTION_SW 4
+#define HEX_DIRECTION_SE 5
+
+// one step in each direction, in doubled coordinates
+constexpr int8_t vertical[6]   = { 0, -1, -1,  0,  1,  1};
+constexpr int8_t horizontal[6] = { 2,  1, -1, -2, -1,  1};
+
+#define HEX_TURNS 6
+#define HEX_MIRRORED 6             // add to a number of turns to mirror first
+#define HEX_TRANSFORMS 12
+
+struct hexAxial {
+  int8_t q;
+  int8_t r;
+};
 
+constexpr int8_t hexRow(uint8_t i) {
+  return i / HEX_GRID_COLS;
+}
+constexpr int8_t hexCol(uint8_t i) {
+  return (2 * (i % HEX_GRID_COLS)) + (hexRow(i) & 1);
+}
+constexpr hexAxial hexToAxial(int8_t row, int8_t col) {
+  return { (int8_t)((col - row) / 2), row };
+}
+constexpr hexAxial hexTransform(hexAxial a, uint8_t t) {
+  int8_t q = a.q;
+  int8_t r = a.r;
+  if (t >= HEX_MIRRORED) {       // (q, r, s) -> (s, r, q)
+    q = -q - r;
+    t -= HEX_MIRRORED;
+  }
+  for (uint8_t n = 0; n < t; n++) {   // (q, r, s) -> (-r, -s, -q)
+    int8_t s = -q - r;
+    q = -r;
+    r = -s;
+  }
+  return { q, r };
+}
+
+struct hexTransformTable {
+  hexAxial at[HEX_TRANSFORMS][HEX_GRID_HEXES];
+};
+constexpr hexTransformTable makeHexTransformTable() {
+  hexTransformTable table = {};
+  for (uint8_t t = 0; t < HEX_TRANSFORMS; t++) {
+    for (uint8_t i = 0; i < HEX_GRID_HEXES; i++) {
+      table.at[t][i] = hexTransform(hexToAxial(hexRow(i), hexCol(i)), t);
+    }
+  }
+  return table;
+}
+constexpr hexTransformTable hexTransformed = makeHexTransformTable();
+
+/*
+  The transform to read a layout through, so that the
+  layout itself is turned clockwise (and mirrored first,
+  if asked). Reading through a turn moves the layout the
+  opposite way, so plain turns are reversed; a mirrored
+  turn is its own reverse.
+*/
+constexpr uint8_t hexLayoutTransform(uint8_t turns, bool mirror) {
+  return mirror ? (turns % HEX_TURNS) + HEX_MIRRORED : (HEX_TURNS - (turns % HEX_TURNS)) % HEX_TURNS;
+}
+
+/*
+  Steps from the centre hex to hex i, for a layout of
+  the given across and down-left steps, read through
+  transform t.
+*/
+inline int16_t hexStepsFrom(uint8_t centre, uint8_t i, uint8_t t, int8_t acrossSteps, int8_t dnLeftSteps) {
+  const hexAxial& a = hexTransformed.at[t][i];
+  const hexAxial& c = hexTransformed.at[t][centre];
+  int16_t dq = a.q - c.q;
+  int16_t dr = a.r - c.r;
+  return (dq * acrossSteps) + (dr * (acrossSteps + dnLeftSteps));
+}
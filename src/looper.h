@@ -0,0 +1,365 @@
+/*
+  Looper
+
+  Records key presses and releases as small events
+  (when, which hex, what pitch, how hard) and plays
+  them back on repeat.
+
+  Events are kept in a fixed arena of LOOPER_CHUNKS
+  chunks of LOOPER_CHUNK_EVENTS each, so nothing is
+  allocated while recording or playing. A short take
+  fits in the arena and stays in RAM. A long take is
+  saved to a file a chunk at a time as the arena fills,
+  and played back by reading chunks from the file a
+  little ahead of when they are needed, so RAM use is
+  the same however long the take is.
+
+  The file is reached through a "store" object supplied
+  by the sketch, with two functions:
+    bool writeChunk(uint32_t chunk, const loopEvent* events, uint8_t count)
+    bool readChunk(uint32_t chunk, loopEvent* events, uint8_t count)
+  so the same code can run on a computer.
+
+  Quantizing is optional and happens as events are
+  recorded: a press moves to the nearest step of the
+  grid, and its release moves by the same amount so the
+  note keeps its length. That can put an event earlier
+  than one already recorded, so each new event is slid
+  back into time order among those not yet saved.
+
+  Playback is driven by an alarm interrupt in the sketch:
+  peek() says what is due next and when, and advance()
+  moves past it. The end of each pass is a step of its
+  own (LOOPER_STEP_CYCLE_END), so that any notes still
+  held can be let go right on time. Events recorded at
+  or after the end of the loop (e.g. a press quantized
+  forward past it) are skipped.
+
+  The interrupt doesn't play anything itself: queueDue()
+  moves what has fallen due into a loopDueQueue, each
+  with the time it was due, and the sketch plays them
+  from a task, so notes and MIDI only ever go out from
+  the main loop.
+*/
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+#define LOOPER_CHUNK_EVENTS 64       // 512 bytes per chunk
+#define LOOPER_CHUNKS 8
+#define LOOPER_SAVE_AT 6             // chunks in RAM before the oldest is saved; the rest is room for a burst of notes
+#define LOOPER_MAX_HEX 160           // same as BTN_COUNT
+#define LOOPER_MAX_TIME 0xF0000000UL // about 67 minutes
+
+#define LOOPER_EMPTY 0
+#define LOOPER_ARMED 1               // recording starts with the first note
+#define LOOPER_RECORDING 2
+#define LOOPER_STOPPED 3             // holds a loop, not playing
+#define LOOPER_PLAYING 4
+
+#define LOOPER_STEP_NOTE 0
+#define LOOPER_STEP_CYCLE_END 1
+#define LOOPER_STEP_WAIT 2           // the next chunk hasn't been read from the file yet
+#define LOOPER_STEP_NONE 3           // not playing
+
+struct loopEvent {
+  uint32_t time;       // microseconds from the start of the loop
+  uint8_t hex;
+  uint8_t velocity;    // 0 = release
+  int16_t pitch;       // steps from C when it was recorded
+};
+
+/*
+  Events handed from the playback interrupt to the main
+  loop. The interrupt only pushes and the main loop only
+  pops, so neither has to hold the other off, except to
+  clear it.
+*/
+#define LOOPER_QUEUE_SIZE 32         // a power of 2
+
+struct loopDue {
+  uint64_t due;        // when it should have gone out
+  loopEvent e;
+  uint8_t step;        // LOOPER_STEP_NOTE or LOOPER_STEP_CYCLE_END
+};
+
+class loopDueQueue {
+  public:
+    loopDueQueue() {
+      head = 0;
+      tail = 0;
+      worstLate = 0;
+      overflows = 0;
+    }
+    void clear() {
+      tail = head;
+    }
+    bool full() {
+      return ((uint8_t)(head - tail) >= LOOPER_QUEUE_SIZE);
+    }
+    bool push(uint8_t step, const loopEvent& e, uint64_t due) {
+      if (full()) {
+        overflows++;
+        return false;
+      }
+      loopDue& d = ring[head & (LOOPER_QUEUE_SIZE - 1)];
+      d.due = due;
+      d.e = e;
+      d.step = step;
+      __sync_synchronize();    // the event is in place before the main loop can see it
+      head++;
+      return true;
+    }
+    bool pop(loopDue& d, uint64_t now) {
+      if (head == tail) return false;
+      d = ring[tail & (LOOPER_QUEUE_SIZE - 1)];
+      tail++;
+      if ((now > d.due) && (now - d.due > worstLate)) {
+        worstLate = now - d.due;
+      }
+      return true;
+    }
+    uint32_t worstLate;      // microseconds from due to played
+    uint32_t overflows;      // times the interrupt found the queue full
+  private:
+    loopDue ring[LOOPER_QUEUE_SIZE];
+    volatile uint8_t head;
+    volatile uint8_t tail;
+};
+
+class looper {
+  public:
+    looper() {
+      clear();
+    }
+    void clear() {
+      state = LOOPER_EMPTY;
+      eventCount = 0;
+      savedEvents = 0;
+      length = 0;
+      grid = 0;
+      dropped = 0;
+      streamed = false;
+      playPos = 0;
+      playSeq = 0;
+      loadedSeq = 0;
+      cycleStart = 0;
+      memset(held, 0, sizeof(held));
+    }
+    /*
+      Get ready to record. The grid is in microseconds,
+      0 to record times as played.
+    */
+    void arm(uint32_t quantizeGrid) {
+      clear();
+      grid = quantizeGrid;
+      state = LOOPER_ARMED;
+    }
+    /*
+      Call from the key scan for each note pressed
+      (velocity > 0) or released (velocity = 0).
+      Returns false if the event wasn't recorded.
+    */
+    bool record(uint64_t now, uint8_t hex, int16_t pitch, uint8_t velocity) {
+      if (hex >= LOOPER_MAX_HEX) return false;
+      if (state == LOOPER_ARMED) {
+        if (!velocity) return false;
+        state = LOOPER_RECORDING;
+        recordStart = now;
+      }
+      if (state != LOOPER_RECORDING) return false;
+      if (!velocity && !isHeld(hex)) return false;   // pressed before recording began
+      uint64_t t = now - recordStart;
+      if ((t >= LOOPER_MAX_TIME) || (eventCount - savedEvents >= LOOPER_CHUNKS * LOOPER_CHUNK_EVENTS)) {
+        dropped++;
+        return false;
+      }
+      if (velocity) {
+        shift[hex] = 0;
+        if (grid) {
+          uint64_t q = ((t + grid / 2) / grid) * grid;
+          shift[hex] = (int32_t)(q - t);
+          t = q;
+        }
+        setHeld(hex, true);
+      } else {
+        t += shift[hex];
+        setHeld(hex, false);
+      }
+      loopEvent e;
+      e.time = t;
+      e.hex = hex;
+      e.velocity = velocity;
+      e.pitch = pitch;
+      uint32_t n = eventCount;
+      while ((n > savedEvents) && (at(n - 1).time > e.time)) {
+        at(n) = at(n - 1);
+        n--;
+      }
+      at(n) = e;
+      eventCount++;
+      return true;
+    }
+    /*
+      Call from the main loop while recording. Once the
+      take gets long, saves the oldest chunks to make room.
+      Returns false if a write failed.
+    */
+    template <class S> bool save(S& store) {
+      while ((state == LOOPER_RECORDING)
+        && (eventCount - savedEvents >= LOOPER_SAVE_AT * LOOPER_CHUNK_EVENTS)) {
+        if (!saveChunk(store, savedEvents / LOOPER_CHUNK_EVENTS)) return false;
+        savedEvents += LOOPER_CHUNK_EVENTS;
+      }
+      return true;
+    }
+    /*
+      Stop recording. The loop is as long as the time since
+      the first note, rounded to the grid if quantizing.
+      If any of the take was saved, the rest is saved too,
+      and playback will stream it from the file.
+      Returns false if there was nothing to keep.
+    */
+    template <class S> bool finish(uint64_t now, S& store) {
+      if (state != LOOPER_RECORDING) {
+        clear();
+        return false;
+      }
+      uint64_t t = now - recordStart;
+      if (t >= LOOPER_MAX_TIME) t = LOOPER_MAX_TIME;
+      if (grid) {
+        t = ((t + grid / 2) / grid) * grid;
+        if (t < grid) t = grid;
+      }
+      length = (t ? t : 1);
+      streamed = (savedEvents > 0);
+      if (streamed) {
+        for (uint32_t c = savedEvents / LOOPER_CHUNK_EVENTS; c < chunkCount(); c++) {
+          if (!saveChunk(store, c)) {
+            clear();
+            return false;
+          }
+        }
+        savedEvents = eventCount;
+      }
+      state = LOOPER_STOPPED;
+      return true;
+    }
+    /*
+      Playback. start() and stop() are called with the
+      sketch's playback interrupt held off. For a streamed
+      take, call load() before the first step and then
+      from the main loop as often as possible.
+    */
+    void start(uint64_t now) {
+      if ((state != LOOPER_STOPPED) && (state != LOOPER_PLAYING)) return;
+      playPos = 0;
+      playSeq = 0;
+      loadedSeq = 0;
+      cycleStart = now;
+      state = LOOPER_PLAYING;
+    }
+    void stop() {
+      if (state == LOOPER_PLAYING) {
+        state = LOOPER_STOPPED;
+      }
+    }
+    template <class S> bool load(S& store) {
+      if ((state != LOOPER_PLAYING) || !streamed) return true;
+      while (loadedSeq < playSeq + LOOPER_CHUNKS) {   // the slot for loadedSeq has been played already
+        uint32_t c = loadedSeq % chunkCount();
+        if (!store.readChunk(c, arena[loadedSeq % LOOPER_CHUNKS], eventsInChunk(c))) return false;
+        loadedSeq++;
+      }
+      return true;
+    }
+    uint8_t peek(loopEvent& e, uint64_t& due) {
+      if (state != LOOPER_PLAYING) return LOOPER_STEP_NONE;
+      while (true) {
+        if (playPos >= eventCount) {
+          due = cycleStart + length;
+          return LOOPER_STEP_CYCLE_END;
+        }
+        if (streamed && (playSeq >= loadedSeq)) return LOOPER_STEP_WAIT;
+        e = slotFor(playSeq)[playPos % LOOPER_CHUNK_EVENTS];
+        if (e.time < length) break;
+        advance();     // past the end of the loop
+      }
+      due = cycleStart + e.time;
+      return LOOPER_STEP_NOTE;
+    }
+    void advance() {
+      if (playPos >= eventCount) {
+        cycleStart += length;
+        playPos = 0;
+        playSeq++;
+        return;
+      }
+      playPos++;
+      if ((playPos < eventCount) && !(playPos % LOOPER_CHUNK_EVENTS)) {
+        playSeq++;
+      }
+    }
+    /*
+      Called from the playback interrupt: queues everything
+      due by now. Returns LOOPER_STEP_NOTE with the time the
+      next event is due, LOOPER_STEP_WAIT if the next chunk
+      hasn't been read yet or the queue is full, or
+      LOOPER_STEP_NONE if not playing.
+    */
+    uint8_t queueDue(uint64_t now, loopDueQueue& q, uint64_t& due) {
+      loopEvent e = {};
+      while (true) {
+        uint8_t step = peek(e, due);
+        if ((step == LOOPER_STEP_NONE) || (step == LOOPER_STEP_WAIT)) return step;
+        if (due > now) return LOOPER_STEP_NOTE;
+        if (!q.push(step, e, due)) return LOOPER_STEP_WAIT;
+        advance();
+      }
+    }
+    bool waitingForFile() {
+      return (state == LOOPER_PLAYING) && streamed && (playSeq >= loadedSeq);
+    }
+    uint32_t chunkCount() {
+      return (eventCount + LOOPER_CHUNK_EVENTS - 1) / LOOPER_CHUNK_EVENTS;
+    }
+    volatile uint8_t state;
+    uint32_t eventCount;
+    uint32_t length;       // microseconds, once recorded
+    uint32_t dropped;      // events that didn't fit
+    bool streamed;         // the take is in the file, not all in RAM
+  private:
+    loopEvent arena[LOOPER_CHUNKS][LOOPER_CHUNK_EVENTS];
+    uint32_t savedEvents;  // events (always whole chunks, until finish) written to the file
+    uint32_t grid;
+    uint64_t recordStart;
+    int32_t shift[LOOPER_MAX_HEX];    // how far the latest press of each hex was quantized
+    uint32_t held[(LOOPER_MAX_HEX + 31) / 32];
+    volatile uint32_t playPos;        // event number within the take
+    volatile uint32_t playSeq;        // chunks played so far, counting every pass
+    volatile uint32_t loadedSeq;      // chunks read from the file so far, the same way
+    uint64_t cycleStart;
+    loopEvent& at(uint32_t n) {
+      return arena[(n / LOOPER_CHUNK_EVENTS) % LOOPER_CHUNKS][n % LOOPER_CHUNK_EVENTS];
+    }
+    loopEvent* slotFor(uint32_t seq) {
+      return arena[(streamed ? seq : seq % chunkCount()) % LOOPER_CHUNKS];
+    }
+    uint8_t eventsInChunk(uint32_t c) {
+      uint32_t left = eventCount - c * LOOPER_CHUNK_EVENTS;
+      return (left > LOOPER_CHUNK_EVENTS ? LOOPER_CHUNK_EVENTS : left);
+    }
+    template <class S> bool saveChunk(S& store, uint32_t c) {
+      return store.writeChunk(c, arena[c % LOOPER_CHUNKS], eventsInChunk(c));
+    }
+    bool isHeld(uint8_t hex) {
+      return (held[hex >> 5] >> (hex & 31)) & 1;
+    }
+    void setHeld(uint8_t hex, bool on) {
+      if (on) {
+        held[hex >> 5] |= (1UL << (hex & 31));
+      } else {
+        held[hex >> 5] &= ~(1UL << (hex & 31));
+      }
+    }
+};
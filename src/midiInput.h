@@ -0,0 +1,207 @@
+/*
+  MIDI input queue and SysEx command parser
+
+  Messages read from USB and serial MIDI are copied into
+  a fixed-size ring of small events, so taking them in is
+  quick and never allocates; the sketch acts on them
+  afterwards, as time allows. SysEx messages are copied
+  into one of a few fixed slots; if none is free, or the
+  message is too long to be a command, it is dropped.
+
+  Nothing here touches hardware. The MIDI library splits
+  the bytes into messages and pushMessage() takes them in
+  as the sketch reads them; tests/midiInputTest.cpp plays
+  a recorded byte stream through a parser that does the
+  same job, then through the queue, on a computer.
+
+  SysEx commands use the non-commercial manufacturer ID,
+  followed by 'H' (HexBoard), a command letter, and its
+  value as two 7-bit bytes, most significant first:
+    F0 7D 48 <cmd> <msb> <lsb> F7
+  Commands:
+    'T'  tuning index
+    'L'  layout index (must belong to the current tuning)
+    'S'  scale index (must suit the current tuning)
+    'K'  key, in steps from A, offset by 8192 (C in 12 EDO = 8183)
+    'X'  transpose, in steps, offset by 8192 (8192 = none)
+    'P'  synth mode (same values as the menu)
+    'D'  send the diagnostics dump (value ignored)
+  The diagnostics dump itself starts 7D 48 44 too, but is
+  much longer, so it is ignored if it gets looped back in.
+
+  Incoming notes are played on a hex, chosen through a
+  noteToHexMap: the sketch offers it every hex with how far
+  its pitch is from the note, and how far it is from the
+  middle of the layout, and the closest in pitch wins, then
+  the closest to the middle.
+*/
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+#define MIDI_IN_QUEUE_SIZE 32      // events, must be a power of 2
+#define MIDI_IN_SYSEX_SLOTS 2
+#define MIDI_IN_SYSEX_SIZE 16      // commands are 7 bytes; anything longer isn't for us
+
+#define MIDI_IN_NOTE_OFF 0x80      // same values as the status bytes
+#define MIDI_IN_NOTE_ON 0x90
+#define MIDI_IN_SYSEX 0xF0         // data1 = slot
+
+#define SYSEX_MANUFACTURER 0x7D
+#define SYSEX_DEVICE 'H'
+#define SYSEX_CMD_TUNING 'T'
+#define SYSEX_CMD_LAYOUT 'L'
+#define SYSEX_CMD_SCALE 'S'
+#define SYSEX_CMD_KEY 'K'
+#define SYSEX_CMD_TRANSPOSE 'X'
+#define SYSEX_CMD_SYNTH_MODE 'P'
+#define SYSEX_CMD_DIAGNOSTICS 'D'
+#define SYSEX_TRANSPOSE_ZERO 8192      // also the zero point for the key
+
+#define MIDI_IN_NO_HEX 255             // same as UNUSED_NOTE in the sketch
+
+struct midiInEvent {
+  uint8_t type;
+  uint8_t channel;   // 1-16
+  uint8_t data1;
+  uint8_t data2;
+};
+
+struct sysExCommand {
+  uint8_t cmd;
+  int16_t value;
+};
+
+class noteToHexMap {
+  public:
+    noteToHexMap() {
+      clear();
+    }
+    void clear() {
+      for (uint8_t n = 0; n < 128; n++) {
+        hex[n] = MIDI_IN_NO_HEX;
+        bestError[n] = UINT16_MAX;
+        bestDistance[n] = UINT8_MAX;
+      }
+    }
+    void offer(uint8_t note, uint8_t h, uint16_t error, uint8_t distance) {
+      note &= 127;
+      if ((error < bestError[note]) || ((error == bestError[note]) && (distance < bestDistance[note]))) {
+        hex[note] = h;
+        bestError[note] = error;
+        bestDistance[note] = distance;
+      }
+    }
+    // MIDI_IN_NO_HEX if no hex plays this note
+    uint8_t hexFor(uint8_t note) {
+      return hex[note & 127];
+    }
+  private:
+    uint8_t hex[128];
+    uint16_t bestError[128];     // the sketch uses 1/1024 semitones
+    uint8_t bestDistance[128];
+};
+
+class midiInQueue {
+  public:
+    midiInQueue() {
+      clear();
+    }
+    void clear() {
+      head = 0;
+      tail = 0;
+      dropped = 0;
+      for (uint8_t s = 0; s < MIDI_IN_SYSEX_SLOTS; s++) {
+        sysExLength[s] = 0;
+      }
+    }
+    bool full() {
+      return ((uint8_t)(head - tail) >= MIDI_IN_QUEUE_SIZE);
+    }
+    bool push(uint8_t type, uint8_t channel, uint8_t data1, uint8_t data2) {
+      if (full()) {
+        dropped++;
+        return false;
+      }
+      midiInEvent& e = ring[head & (MIDI_IN_QUEUE_SIZE - 1)];
+      e.type = type;
+      e.channel = channel;
+      e.data1 = data1;
+      e.data2 = data2;
+      head++;
+      return true;
+    }
+    /*
+      A message as the MIDI library reads it: its type is the
+      status byte without the channel (0xF0 for SysEx). Note
+      on with velocity 0 is note off; anything else that isn't
+      a note or SysEx is left out.
+    */
+    bool pushMessage(uint8_t type, uint8_t channel, uint8_t data1, uint8_t data2, const uint8_t* sysExData, uint16_t sysExLength) {
+      switch (type) {
+        case MIDI_IN_NOTE_ON:
+          return push(data2 ? MIDI_IN_NOTE_ON : MIDI_IN_NOTE_OFF, channel, data1, data2);
+        case MIDI_IN_NOTE_OFF:
+          return push(MIDI_IN_NOTE_OFF, channel, data1, data2);
+        case MIDI_IN_SYSEX:
+          return pushSysEx(sysExData, sysExLength);
+        default:
+          return false;
+      }
+    }
+    bool pushSysEx(const uint8_t* data, uint16_t length) {
+      if (length > MIDI_IN_SYSEX_SIZE) {
+        dropped++;
+        return false;
+      }
+      for (uint8_t s = 0; s < MIDI_IN_SYSEX_SLOTS; s++) {
+        if (!sysExLength[s]) {
+          if (!push(MIDI_IN_SYSEX, 0, s, 0)) return false;
+          memcpy(sysEx[s], data, length);
+          sysExLength[s] = length;
+          return true;
+        }
+      }
+      dropped++;
+      return false;
+    }
+    bool pop(midiInEvent& e) {
+      if (head == tail) return false;
+      e = ring[tail & (MIDI_IN_QUEUE_SIZE - 1)];
+      tail++;
+      return true;
+    }
+    /*
+      Decode the SysEx held in a slot and free the slot.
+      Returns false if it is not a HexBoard command.
+    */
+    bool takeSysExCommand(uint8_t slot, sysExCommand& c) {
+      if (slot >= MIDI_IN_SYSEX_SLOTS) return false;
+      bool ok = parseSysExCommand(sysEx[slot], sysExLength[slot], c);
+      sysExLength[slot] = 0;
+      return ok;
+    }
+    static bool parseSysExCommand(const uint8_t* data, uint16_t length, sysExCommand& c) {
+      if (length && (data[0] == 0xF0)) {   // the MIDI library includes the start and end bytes
+        data++;
+        length--;
+      }
+      if (length && (data[length - 1] == 0xF7)) {
+        length--;
+      }
+      if ((length != 5) || (data[0] != SYSEX_MANUFACTURER) || (data[1] != SYSEX_DEVICE)) {
+        return false;
+      }
+      if ((data[3] | data[4]) & 0x80) return false;
+      c.cmd = data[2];
+      c.value = (data[3] << 7) | data[4];
+      return true;
+    }
+    uint32_t dropped;   // events that didn't fit
+  private:
+    midiInEvent ring[MIDI_IN_QUEUE_SIZE];
+    uint8_t head;
+    uint8_t tail;
+    uint8_t sysEx[MIDI_IN_SYSEX_SLOTS][MIDI_IN_SYSEX_SIZE];
+    uint16_t sysExLength[MIDI_IN_SYSEX_SLOTS];
+};
@@ -0,0 +1,81 @@
+/*
+  Power policy
+
+  Decides when the HexBoard is idle, so the sketch can
+  slow the system clock and let the cores sleep, and when
+  it must be back at full speed.
+
+  Each scan, the sketch reports what is going on as a set
+  of POWER_BUSY_ flags. Any flag at all means full speed,
+  straight away. The board only goes idle after nothing
+  has been going on for idleAfter microseconds, so a
+  pause between phrases doesn't slow the clock just as
+  the next note comes.
+
+  If the clock can't be changed, the sketch calls
+  refused(): the board carries on at full speed, and
+  tries again only after another idleAfter of quiet.
+
+  The decision depends only on the flags and the time
+  passed in, so a recorded trace of (time, flags) can be
+  played through it on a computer to see when the board
+  would have slept and for how long.
+*/
+#pragma once
+#include <stdint.h>
+
+#define POWER_FULL 0
+#define POWER_IDLE 1
+
+#define POWER_BUSY_KEYS 1       // a key is down
+#define POWER_BUSY_VOICES 2     // the synth is playing
+#define POWER_BUSY_SCREEN 4     // the screen is awake, i.e. the menu is in use
+#define POWER_BUSY_LOOPER 8     // recording or playing a loop
+
+class powerPolicy {
+  public:
+    powerPolicy(uint32_t _idleAfter) {
+      idleAfter = _idleAfter;
+      mode = POWER_FULL;
+      quietSince = 0;
+      idleStart = 0;
+      idleCount = 0;
+      idleTime = 0;
+      refusals = 0;
+    }
+    uint8_t update(uint64_t now, uint8_t busy) {
+      if (busy) {
+        quietSince = now;
+        if (mode == POWER_IDLE) {
+          idleTime += now - idleStart;
+          mode = POWER_FULL;
+        }
+      } else if ((mode == POWER_FULL) && (now - quietSince >= idleAfter)) {
+        mode = POWER_IDLE;
+        idleStart = now;
+        idleCount++;
+      }
+      return mode;
+    }
+    // the clock stayed as it was, so the board never went idle
+    void refused(uint64_t now) {
+      if (mode == POWER_IDLE) {
+        mode = POWER_FULL;
+        idleCount--;
+      }
+      quietSince = now;
+      refusals++;
+    }
+    // microseconds spent idle so far, including now
+    uint64_t totalIdle(uint64_t now) {
+      return idleTime + ((mode == POWER_IDLE) ? now - idleStart : 0);
+    }
+    uint8_t mode;
+    uint32_t idleCount;       // times the board went idle
+    uint32_t refusals;        // times the clock couldn't be changed
+  private:
+    uint32_t idleAfter;       // microseconds
+    uint64_t quietSince;
+    uint64_t idleStart;
+    uint64_t idleTime;
+};
@@ -0,0 +1,175 @@
+/*
+  On-device profiling
+
+  Each stage of the main loop is timed with the
+  processor's SysTick counter, which counts down
+  once per CPU cycle. SysTick is only 24 bits wide,
+  so a single measurement wraps after 2^24 cycles
+  (about 126ms at 133MHz); every stage of the loop
+  is far shorter than that.
+
+  While the board is idle the clock runs slower
+  (see @power in the sketch), so each measurement
+  is scaled to full-speed cycles as it is recorded,
+  and cyclesToMicros() converts at the full speed
+  the profiler started at. A measurement that spans
+  a clock change is scaled as if it all ran at the
+  new speed.
+
+  Results go into fixed-size histograms rather than
+  a list of samples, so memory use does not grow.
+  Buckets are spaced logarithmically with four
+  sub-buckets per power of two, which keeps the
+  percentile estimates within about 25%.
+
+  Set PROFILING_ON to false in constants.h and all
+  of this compiles out, including the hooks in the
+  sketch (they are macros that expand to nothing).
+*/
+#pragma once
+#include <Arduino.h>
+#include "constants.h"
+
+#if PROFILING_ON
+  #include "hardware/structs/systick.h"
+  #include "hardware/clocks.h"
+
+  #define PROFILE_STAGE_LOOP 0        // one pass of loop() that ran a task, choosing it included
+  #define PROFILE_STAGE_SCAN 1
+  #define PROFILE_STAGE_MIDI_IN 2
+  #define PROFILE_STAGE_WHEELS 3
+  #define PROFILE_STAGE_ANIMATE 4
+  #define PROFILE_STAGE_LEDS 5
+  #define PROFILE_STAGE_MENU 6
+  #define PROFILE_STAGE_POLL 7        // time spent inside the synth interrupt on core 2
+  #define PROFILE_STAGE_COUNT 8
+
+  #define PROFILE_BUCKETS 96          // enough for any 24-bit value
+
+  class profileHistogram {
+    public:
+      uint32_t count;
+      uint32_t minValue;
+      uint32_t maxValue;
+      uint64_t total;
+      uint32_t bucket[PROFILE_BUCKETS];
+      void reset() {
+        count = 0;
+        minValue = UINT32_MAX;
+        maxValue = 0;
+        total = 0;
+        memset(bucket, 0, sizeof(bucket));
+      }
+      void record(uint32_t v) {
+        count++;
+        total += v;
+        if (v < minValue) minValue = v;
+        if (v > maxValue) maxValue = v;
+        byte b = bucketOf(v);
+        bucket[(b < PROFILE_BUCKETS) ? b : PROFILE_BUCKETS - 1]++;
+      }
+      uint32_t average() {
+        return (count ? (uint32_t)(total / count) : 0);
+      }
+      uint32_t percentile(byte pct) {     // returns the upper edge of the bucket holding that percentile
+        if (!count) return 0;
+        uint64_t target = ((uint64_t)count * pct + 99) / 100;
+        uint64_t sum = 0;
+        for (byte b = 0; b < PROFILE_BUCKETS; b++) {
+          sum += bucket[b];
+          if (sum >= target) {
+            uint32_t top = bucketTop(b);
+            return ((top > maxValue) ? maxValue : top);
+          }
+        }
+        return maxValue;
+      }
+    private:
+      static byte bucketOf(uint32_t v) {
+        if (v < 4) return v;
+        byte e = 31 - __builtin_clz(v);   // position of the highest bit
+        return 4 * (e - 1) + ((v >> (e - 2)) & 3);
+      }
+      static uint32_t bucketTop(byte b) {
+        if (b < 4) return b;
+        byte e = (b / 4) + 1;
+        return ((uint32_t)(5 + (b % 4)) << (e - 2)) - 1;
+      }
+  };
+
+  profileHistogram stageStats[PROFILE_STAGE_COUNT];  // in CPU cycles
+  profileHistogram pollLateness;                     // in microseconds past the scheduled alarm
+  uint32_t pollOverruns = 0;                         // polls that started a full interval or more late
+  uint32_t profileLapMark = 0;
+  uint32_t profileLoopMark = 0;
+  uint32_t profileFullHz = 1000000;                  // clk_sys when profiling started
+  uint32_t profileScale = 256;                       // full-speed cycles per cycle now, times 256
+
+  uint32_t readCycleCounter() {
+    return systick_hw->cvr;
+  }
+  uint32_t cyclesSince(uint32_t mark) {             // SysTick counts down
+    return (mark - systick_hw->cvr) & 0x00FFFFFF;
+  }
+  uint32_t toFullSpeed(uint32_t cycles) {
+    if (profileScale == 256) return cycles;
+    return (uint32_t)(((uint64_t)cycles * profileScale) >> 8);
+  }
+  uint32_t cyclesToMicros(uint32_t cycles) {
+    return cycles / (profileFullHz / 1000000);
+  }
+  void profileClockChanged() { // call after each change to clk_sys
+    profileScale = (uint32_t)(((uint64_t)profileFullHz * 256) / clock_get_hz(clk_sys));
+  }
+  void startCycleCounter() {   // each core has its own SysTick, so run this on both
+    systick_hw->rvr = 0x00FFFFFF;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0x5;     // processor clock, no interrupt, enabled
+  }
+  void resetProfiler() {
+    for (byte s = 0; s < PROFILE_STAGE_COUNT; s++) {
+      stageStats[s].reset();
+    }
+    pollLateness.reset();
+    pollOverruns = 0;
+  }
+  void profileLoopEnd(bool ran) { // passes that found nothing due would swamp the histogram
+    if (ran) {
+      stageStats[PROFILE_STAGE_LOOP].record(toFullSpeed(cyclesSince(profileLoopMark)));
+    }
+  }
+  void profileLap(byte stage) { // time since the previous lap (or task start) is charged to this stage
+    stageStats[stage].record(toFullSpeed(cyclesSince(profileLapMark)));
+    profileLapMark = readCycleCounter();
+  }
+  void profilePoll(uint32_t mark, uint32_t lateMicros, uint32_t intervalMicros) {
+    stageStats[PROFILE_STAGE_POLL].record(toFullSpeed(cyclesSince(mark)));
+    pollLateness.record(lateMicros);
+    if (lateMicros >= intervalMicros) {
+      pollOverruns++;
+    }
+  }
+
+  #define PROFILE_SETUP()           { startCycleCounter(); profileFullHz = clock_get_hz(clk_sys); resetProfiler(); }
+  #define PROFILE_SETUP_CORE2()     startCycleCounter()
+  #define PROFILE_CLOCK_CHANGED()   profileClockChanged()
+  #define PROFILE_LOOP_START()      (profileLoopMark = readCycleCounter())
+  #define PROFILE_LOOP_END(ran)     profileLoopEnd(ran)
+  #define PROFILE_TASK_START()      (profileLapMark = readCycleCounter())
+  #define PROFILE_LAP(stage)        profileLap(stage)
+  // call at the very top of the interrupt, before the alarm is re-armed
+  #define PROFILE_POLL_START(alarmNum) \
+    uint32_t profilePollMark = readCycleCounter(); \
+    uint32_t profilePollLate = timer_hw->timerawl - timer_hw->alarm[alarmNum]
+  #define PROFILE_POLL_END(interval) profilePoll(profilePollMark, profilePollLate, interval)
+#else
+  #define PROFILE_SETUP()
+  #define PROFILE_SETUP_CORE2()
+  #define PROFILE_CLOCK_CHANGED()
+  #define PROFILE_LOOP_START()
+  #define PROFILE_LOOP_END(ran)
+  #define PROFILE_TASK_START()
+  #define PROFILE_LAP(stage)
+  #define PROFILE_POLL_START(alarmNum)
+  #define PROFILE_POLL_END(interval)
+#endif
@@ -0,0 +1,484 @@
+/*
+  Sampler
+
+  Plays recorded samples, kept in a bank in flash, at any
+  pitch. A bank holds up to SAMPLER_MAX_ZONES samples
+  ("zones"), each recorded at its own root pitch; a note
+  plays whichever zone is nearest its pitch, stepped
+  faster or slower through the recording to match.
+
+  The samples are never copied into RAM. On the RP2040
+  flash is mapped into the address space (XIP), so the
+  sketch hands the bank over as a pointer and each voice
+  reads straight from it. To keep a handful of voices
+  from fighting over the XIP cache with the program code,
+  the sketch points at the uncached alias of the flash,
+  and each voice reads SAMPLER_BLOCK samples at a time
+  into a small prefetch buffer of its own, with aligned
+  word copies. A block lasts the voice SAMPLER_BLOCK
+  samples at the root pitch (fewer higher up), so only
+  every so many samples waits on the flash.
+
+  A chord's voices would tend to need their next blocks
+  in the same sample, and a few flash reads at once can
+  take longer than a sample. So each voice keeps a second
+  buffer and reads the block it expects to need next
+  while it plays the one before, when the synth interrupt
+  has reads to spare: next() is handed a count of reads
+  allowed in this sample, shared by all the voices, and
+  takes one off for every read. Only a voice that gets
+  to the end of its block without the next one (or finds
+  it guessed wrong, at a loop) reads there and then, and
+  goes over the count to do it. The first block is read
+  by start(), in the main loop.
+
+  start() and stop() run on the main loop's core while
+  next() may be running on the synth's, so a voice is
+  handed over with a flag: start() takes the voice out of
+  play, waits for any next() already under way to finish,
+  writes the new state, and only then puts it back in play,
+  with a memory barrier either side.
+
+  Bank layout, all little-endian:
+    0                     sampleBankHeader, with the zone table
+    SAMPLER_DATA_START    the zones' samples, 16-bit signed
+                          mono, one after another so each
+                          voice reads forward through flash.
+                          Each zone starts on a block
+                          boundary and is followed by at least
+                          one block of silence, so a prefetch
+                          never reads past it.
+
+  Banks are built from WAV files (PCM, 8, 16 or 24 bits,
+  any number of channels, mixed down to mono) by
+  sampleBankBuilder. It writes through a "flash" object
+  supplied by the sketch, with two functions:
+    bool erase(uint32_t offset, uint32_t bytes)
+    bool program(uint32_t offset, const uint8_t* data, uint32_t bytes)
+  (offsets from the start of the bank; program() is given
+  whole SAMPLER_PAGE pages) and reads the WAV through any
+  file object with read(buffer, bytes), seek(position)
+  and size(). Chunk sizes are checked against the size of
+  the file, so a damaged file is turned away rather than
+  sending the chunk walk round in circles.
+  The header is written last, so an import cut short
+  leaves no bank rather than a broken one. A file that
+  fails part way through its samples is left out, and the
+  next one starts where it would have (or, if some of it
+  has already been programmed, on the next block boundary
+  after it), so the files either side still make a bank.
+
+  On a computer, a memory-mapped file can stand in for
+  the flash: the builder writes to it, and the voices read
+  from the mapping.
+*/
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#define SAMPLER_MAGIC 0x42535848UL        // "HXSB"
+#define SAMPLER_VERSION 1
+#define SAMPLER_MAX_ZONES 16
+#define SAMPLER_PAGE 256                  // bytes flash is programmed in
+#define SAMPLER_SECTOR 4096               // bytes flash is erased in
+#define SAMPLER_DATA_START 512
+#define SAMPLER_BLOCK 16                  // samples per prefetch; a power of 2
+#define SAMPLER_NO_ZONE 255
+#define SAMPLER_NO_BLOCK UINT32_MAX
+#define SAMPLER_FETCHES 2                 // flash reads per sample the voices may make ahead of time
+#define SAMPLER_IMPORT_FRAMES 32          // WAV frames read at a time
+
+struct sampleZone {
+  uint32_t offset;          // bytes from the start of the bank
+  uint32_t length;          // samples
+  uint32_t loopStart;       // samples
+  uint32_t loopEnd;         // samples, just past the loop; 0 = play once
+  uint32_t rootMilliHz;     // the pitch it was recorded at
+  uint32_t sampleRate;      // Hz
+};
+struct sampleBankHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t zoneCount;
+  sampleZone zones[SAMPLER_MAX_ZONES];
+};
+
+class sampleBank {
+  public:
+    sampleBank() {
+      detach();
+    }
+    /*
+      Look for a bank at base (size bytes of flash, or a
+      file mapped in memory). Returns false if there isn't
+      a valid one there.
+    */
+    bool attach(const uint8_t* _base, uint32_t _size) {
+      detach();
+      if (!_base || (_size < SAMPLER_DATA_START)) return false;
+      const sampleBankHeader* hd = (const sampleBankHeader*)_base;
+      if ((hd->magic != SAMPLER_MAGIC) || (hd->version != SAMPLER_VERSION)
+        || (hd->zoneCount > SAMPLER_MAX_ZONES)) return false;
+      for (uint8_t z = 0; z < hd->zoneCount; z++) {
+        const sampleZone& zn = hd->zones[z];
+        if ((zn.offset < SAMPLER_DATA_START) || (zn.offset & 3) || !zn.rootMilliHz || !zn.sampleRate
+          || ((uint64_t)zn.offset + 2 * ((uint64_t)zn.length + 2 * SAMPLER_BLOCK) > _size)
+          || (zn.loopEnd > zn.length) || (zn.loopEnd && (zn.loopStart >= zn.loopEnd))) return false;
+      }
+      base = _base;
+      header = hd;
+      return true;
+    }
+    void detach() {
+      base = 0;
+      header = 0;
+    }
+    uint8_t zoneCount() {
+      return header ? header->zoneCount : 0;
+    }
+    const sampleZone& zone(uint8_t z) {
+      return header->zones[z];
+    }
+    const int16_t* samples(uint8_t z) {
+      return (const int16_t*)(base + header->zones[z].offset);
+    }
+    // the zone recorded nearest to hz, by musical distance
+    uint8_t zoneFor(float hz) {
+      uint8_t best = SAMPLER_NO_ZONE;
+      float bestDistance = 0;
+      for (uint8_t z = 0; z < zoneCount(); z++) {
+        float d = fabsf(log2f(hz * 1000.0f / header->zones[z].rootMilliHz));
+        if ((best == SAMPLER_NO_ZONE) || (d < bestDistance)) {
+          best = z;
+          bestDistance = d;
+        }
+      }
+      return best;
+    }
+  private:
+    const uint8_t* base;
+    const sampleBankHeader* header;
+};
+
+class samplerVoice {
+  public:
+    samplerVoice() {
+      active = false;
+      busy = false;
+      stop();
+    }
+    void stop() {
+      release();
+      data = 0;
+      step = 0;
+    }
+    /*
+      Start playing the zone nearest hz from the top.
+      Called from the main loop, with the voice silent
+      (or about to be restarted).
+    */
+    void start(sampleBank& bank, float hz, float outputRate) {
+      release();
+      uint8_t z = bank.zoneFor(hz);
+      if (z == SAMPLER_NO_ZONE) {
+        stop();
+        return;
+      }
+      const sampleZone& zn = bank.zone(z);
+      data = bank.samples(z);
+      length = zn.length;
+      loopStart = zn.loopStart;
+      loopEnd = zn.loopEnd;
+      rootHz = zn.rootMilliHz / 1000.0f;
+      rateRatio = zn.sampleRate / outputRate;
+      pos = 0;
+      frac = 0;
+      live = 0;
+      fetch(live, 0);
+      ahead = false;
+      tune(hz);
+      __sync_synchronize();     // all of the above is in place before the synth's core can see it
+      active = (length != 0);
+    }
+    // change pitch (e.g. for a pitch bend) without restarting
+    void tune(float hz) {
+      if (!data) return;
+      float s = hz / rootHz * rateRatio * 65536.0f;
+      step = (s > 0x7FFFFFFF) ? 0x7FFFFFFF : (uint32_t)s;
+    }
+    /*
+      The next sample, 0 to 65535 like the other waveforms.
+      fetches is the flash reads left in this sample, for
+      all voices (see the top of the file).
+    */
+    uint16_t next(int8_t& fetches) {
+      busy = true;
+      __sync_synchronize();
+      if (!active) {
+        busy = false;
+        return 32768;
+      }
+      uint32_t k = pos - blockStart[live];
+      if (k >= SAMPLER_BLOCK) {
+        uint8_t other = live ^ 1;
+        if (!ahead || (pos - blockStart[other] >= SAMPLER_BLOCK)) {
+          fetch(other, pos & ~(uint32_t)(SAMPLER_BLOCK - 1));
+          fetches--;
+        }
+        live = other;
+        ahead = false;
+        k = pos - blockStart[live];
+      } else if (!ahead && (fetches > 0)) {
+        uint32_t following = followingBlock();
+        if (following != SAMPLER_NO_BLOCK) {
+          fetch(live ^ 1, following);
+          fetches--;
+        }
+        ahead = true;
+      }
+      const int16_t* block = blocks[live];
+      int32_t s0 = block[k];
+      int32_t s1 = block[k + 1];
+      int32_t out = s0 + (((s1 - s0) * (int32_t)(frac >> 8)) >> 8);
+      uint32_t f = frac + (step & 0xFFFF);
+      pos += (step >> 16) + (f >> 16);
+      frac = f & 0xFFFF;
+      if (loopEnd) {
+        while (pos >= loopEnd) pos -= (loopEnd - loopStart);
+      } else if (pos >= length) {
+        active = false;
+      }
+      __sync_synchronize();
+      busy = false;
+      return 32768 + out;
+    }
+    bool isDone() {
+      return !active;
+    }
+  private:
+    const int16_t* data;
+    uint32_t length;
+    uint32_t loopStart;
+    uint32_t loopEnd;
+    float rootHz;
+    float rateRatio;
+    volatile bool active;     // set last by start(), once the rest is in place
+    volatile bool busy;       // next() is under way
+    volatile uint32_t step;   // samples per output sample, in 1/65536ths
+    uint32_t pos;
+    uint32_t frac;
+    uint8_t live;             // which of the two blocks is playing
+    bool ahead;               // the other holds the block expected next, or there is none to read
+    uint32_t blockStart[2];
+    int16_t blocks[2][SAMPLER_BLOCK + 2] __attribute__((aligned(4)));   // one more for interpolating, one to keep the copy whole words
+    // take the voice out of play, and wait out a next() that had already seen it in play
+    void release() {
+      active = false;
+      __sync_synchronize();
+      while (busy) {}
+    }
+    void fetch(uint8_t b, uint32_t start) {
+      blockStart[b] = start;
+      int16_t* block = blocks[b];
+      memcpy(block, data + start, (SAMPLER_BLOCK + 2) * sizeof(int16_t));
+      // the sample after the end of the loop (or of the zone) is where it goes next
+      uint32_t last = start + SAMPLER_BLOCK;
+      if (loopEnd && (loopEnd > start) && (loopEnd <= last)) {
+        block[loopEnd - start] = data[loopStart];
+      } else if (!loopEnd && (length > start) && (length <= last)) {
+        block[length - start] = 0;
+      }
+    }
+    // where the playing block leads: the one after it, or back round the loop
+    uint32_t followingBlock() {
+      uint32_t after = blockStart[live] + SAMPLER_BLOCK;
+      if (loopEnd && (loopEnd <= after)) return loopStart & ~(uint32_t)(SAMPLER_BLOCK - 1);
+      if (!loopEnd && (length <= after)) return SAMPLER_NO_BLOCK;     // it ends in this one
+      return after;
+    }
+};
+
+/*
+  Builds a bank one WAV file at a time:
+    begin(), then add() for each file, then finish().
+*/
+class sampleBankBuilder {
+  public:
+    template <class W> bool begin(W& flash, uint32_t _capacity) {
+      capacity = _capacity;
+      memset(&header, 0, sizeof(header));
+      header.magic = SAMPLER_MAGIC;
+      header.version = SAMPLER_VERSION;
+      next = SAMPLER_DATA_START;
+      fill = 0;
+      erasedTo = 0;
+      return makeRoom(flash, SAMPLER_DATA_START);   // clears the old header first
+    }
+    /*
+      Add a WAV file as the next zone. defaultRootHz is
+      used if the file doesn't say what pitch it is (a
+      "smpl" chunk, which also gives the loop).
+      Returns false if the file can't be read or doesn't fit.
+    */
+    template <class F, class W> bool add(F& file, W& flash, float defaultRootHz) {
+      if (header.zoneCount >= SAMPLER_MAX_ZONES) return false;
+      uint8_t riff[12];
+      if ((file.read(riff, 12) != 12) || memcmp(riff, "RIFF", 4) || memcmp(riff + 8, "WAVE", 4)) return false;
+      uint32_t at = 12;
+      uint16_t format = 0, channels = 0, bits = 0;
+      uint32_t rate = 0, dataAt = 0, dataBytes = 0;
+      uint32_t loopStart = 0, loopEnd = 0;
+      float rootHz = defaultRootHz;
+      uint8_t ck[8];
+      uint32_t fileSize = file.size();
+      while ((fileSize >= 8) && (at <= fileSize - 8) && file.seek(at) && (file.read(ck, 8) == 8)) {
+        uint32_t size = le32(ck + 4);
+        uint32_t room = fileSize - at - 8;
+        if (size > room) {
+          if (memcmp(ck, "data", 4)) break;     // damaged: keep what came before
+          size = room;                          // cut short, or written as a stream with no length
+        }
+        if (!memcmp(ck, "fmt ", 4) && (size >= 16)) {
+          uint8_t f[16];
+          if (file.read(f, 16) != 16) return false;
+          format = le16(f);
+          channels = le16(f + 2);
+          rate = le32(f + 4);
+          bits = le16(f + 14);
+        } else if (!memcmp(ck, "data", 4)) {
+          dataAt = at + 8;
+          dataBytes = size;
+        } else if (!memcmp(ck, "smpl", 4) && (size >= 36)) {
+          uint8_t s[52];
+          uint32_t n = (size < 52) ? 36 : 52;
+          if (file.read(s, n) != n) return false;
+          float note = le32(s + 12) + (le32(s + 16) / 4294967296.0f);
+          rootHz = 440.0f * exp2f((note - 69.0f) / 12.0f);
+          if ((n == 52) && le32(s + 28)) {      // take the first loop; its end is inclusive
+            loopStart = le32(s + 44);
+            loopEnd = le32(s + 48) + 1;
+          }
+        }
+        at += 8 + size + (size & 1);
+      }
+      uint16_t frameBytes = channels * (bits / 8);
+      if ((format != 1) || !channels || (channels > 8) || !rate || !dataAt
+        || ((bits != 8) && (bits != 16) && (bits != 24))) return false;
+      uint32_t length = dataBytes / frameBytes;
+      if (loopEnd > length) loopEnd = length;
+      if (loopStart >= loopEnd) loopStart = loopEnd = 0;
+      // the zone, then at least a block of silence, ending on a block boundary
+      uint32_t padded = ((length + 2 * SAMPLER_BLOCK) & ~(uint32_t)(SAMPLER_BLOCK - 1));
+      if ((uint64_t)next + 2 * (uint64_t)padded > capacity) return false;
+      if (!file.seek(dataAt)) return false;
+      sampleZone& zn = header.zones[header.zoneCount];
+      zn.offset = next;
+      zn.length = length;
+      zn.loopStart = loopStart;
+      zn.loopEnd = loopEnd;
+      zn.rootMilliHz = (uint32_t)(rootHz * 1000.0f + 0.5f);
+      zn.sampleRate = rate;
+      if (!copySamples(file, flash, channels, bits, length, padded)) {
+        abandon(flash, zn.offset);
+        return false;
+      }
+      header.zoneCount++;
+      return true;
+    }
+    // write what's left, then the header
+    template <class W> bool finish(W& flash) {
+      if (fill) {
+        uint32_t pageAt = next - fill;
+        memset(page + fill, 0, SAMPLER_PAGE - fill);
+        if (!makeRoom(flash, pageAt + SAMPLER_PAGE) || !flash.program(pageAt, page, SAMPLER_PAGE)) return false;
+        fill = 0;
+      }
+      const uint8_t* hd = (const uint8_t*)&header;
+      for (uint32_t p = 0; p < sizeof(header); p += SAMPLER_PAGE) {
+        uint32_t n = sizeof(header) - p;
+        memset(page, 0xFF, SAMPLER_PAGE);
+        memcpy(page, hd + p, (n < SAMPLER_PAGE) ? n : SAMPLER_PAGE);
+        if (!flash.program(p, page, SAMPLER_PAGE)) return false;
+      }
+      return true;
+    }
+    uint8_t zoneCount() {
+      return header.zoneCount;
+    }
+    uint32_t bytesUsed() {
+      return next;
+    }
+  private:
+    sampleBankHeader header;
+    uint32_t capacity;
+    uint32_t next;            // bank offset of the next sample to write
+    uint32_t erasedTo;
+    uint8_t page[SAMPLER_PAGE];
+    uint16_t fill;            // bytes waiting in page
+    static uint16_t le16(const uint8_t* b) {
+      return b[0] | (b[1] << 8);
+    }
+    static uint32_t le32(const uint8_t* b) {
+      return b[0] | (b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+    }
+    template <class W> bool makeRoom(W& flash, uint32_t upTo) {
+      while (erasedTo < upTo) {
+        if (!flash.erase(erasedTo, SAMPLER_SECTOR)) return false;
+        erasedTo += SAMPLER_SECTOR;
+      }
+      return true;
+    }
+    // the zone's samples, mixed down to mono, then its silence
+    template <class F, class W> bool copySamples(F& file, W& flash, uint16_t channels, uint16_t bits, uint32_t length, uint32_t padded) {
+      uint16_t frameBytes = channels * (bits / 8);
+      uint8_t in[SAMPLER_IMPORT_FRAMES * 8 * 3];
+      uint32_t left = length;
+      while (left) {
+        uint32_t frames = (left < SAMPLER_IMPORT_FRAMES) ? left : SAMPLER_IMPORT_FRAMES;
+        if (file.read(in, frames * frameBytes) != frames * frameBytes) return false;
+        for (uint32_t i = 0; i < frames; i++) {
+          int32_t sum = 0;
+          for (uint16_t c = 0; c < channels; c++) {
+            const uint8_t* b = in + (i * frameBytes) + (c * (bits / 8));
+            switch (bits) {
+              case 8:  sum += ((int32_t)b[0] - 128) * 256;           break;
+              case 16: sum += (int16_t)le16(b);                      break;
+              default: sum += (int16_t)le16(b + 1);                  break;   // 24 bits: the top two bytes
+            }
+          }
+          if (!put(flash, (int16_t)(sum / channels))) return false;
+        }
+        left -= frames;
+      }
+      for (uint32_t i = length; i < padded; i++) {
+        if (!put(flash, 0)) return false;
+      }
+      return true;
+    }
+    /*
+      Undo a zone cut short. If none of it has been
+      programmed yet, the next zone starts where it did;
+      otherwise (programming can't be taken back without
+      erasing) it starts on the next block boundary.
+    */
+    template <class W> void abandon(W& flash, uint32_t zoneStart) {
+      if (next - fill <= zoneStart) {
+        fill -= next - zoneStart;
+        next = zoneStart;
+        return;
+      }
+      while (next & (2 * SAMPLER_BLOCK - 1)) {
+        if (!put(flash, 0)) return;
+      }
+    }
+    template <class W> bool put(W& flash, int16_t s) {
+      page[fill++] = s & 0xFF;
+      page[fill++] = (s >> 8) & 0xFF;
+      next += 2;
+      if (fill < SAMPLER_PAGE) return true;
+      fill = 0;
+      uint32_t pageAt = next - SAMPLER_PAGE;
+      return makeRoom(flash, pageAt + SAMPLER_PAGE) && flash.program(pageAt, page, SAMPLER_PAGE);
+    }
+};
@@ -0,0 +1,157 @@
+/*
+  Key matrix settle-time calibration
+
+  When the scanner moves to the next column or row,
+  the column line has to charge back up through its
+  pull-up resistor before it can be read. If it is read
+  too soon, a key that was down on the previous row
+  shows up as a ghost press on this one. How long that
+  takes depends on the wiring of each board, so instead
+  of one worst-case delay everywhere, each column is
+  given its own delay for each group of rows.
+
+  The worst case is a column that was held low (as if
+  by a pressed key) and then let go. The calibration
+  does exactly that, many times for every column and
+  every row, and records how long the line takes to
+  read high again. The delay for each segment is the
+  slowest time seen plus a safety margin, and is then
+  confirmed by repeating the same fall-and-rise at that
+  delay and checking that no read comes back low.
+
+  If a line never comes back high, a key is probably
+  being held, so calibration stops and the previous
+  profile is kept.
+
+  The hardware is reached through a "probe" object
+  supplied by the sketch, with two functions:
+    uint16_t recoveryTime(col, row)
+      microseconds for the column to read high again,
+      or SCAN_CAL_STUCK if it never did
+    bool readsClean(col, row, settle)
+      true if, after waiting settle microseconds,
+      the column reads high
+  so the same code can run on a computer against a
+  simulated matrix.
+*/
+#pragma once
+#include <stdint.h>
+
+#define SCAN_MAX_COLS 16
+#define SCAN_ROW_GROUPS 4                 // the rows are split into this many groups, as evenly as they go (see groupOf)
+#define SCAN_DEFAULT_SETTLE 14            // microseconds; the value found by experimentation before calibration existed
+#define SCAN_MIN_SETTLE 1
+#define SCAN_MAX_SETTLE 30
+#define SCAN_CAL_SAMPLES 8                // fall-and-rise measurements per row
+#define SCAN_CAL_CONFIRMS 16              // clean reads needed per row at the chosen delay
+#define SCAN_CAL_STUCK 0xFFFF
+#define SCAN_CAL_VERSION 1
+
+class scanCalibration {
+  public:
+    scanCalibration(uint8_t _cols, uint8_t _rows) {
+      cols = _cols;
+      rows = _rows;
+      setDefaults();
+    }
+    uint8_t settle[SCAN_MAX_COLS][SCAN_ROW_GROUPS];  // microseconds, by column and row group
+    void setDefaults() {
+      for (uint8_t c = 0; c < SCAN_MAX_COLS; c++) {
+        for (uint8_t g = 0; g < SCAN_ROW_GROUPS; g++) {
+          settle[c][g] = SCAN_DEFAULT_SETTLE;
+        }
+      }
+    }
+    // e.g. 16 rows make 4 groups of 4; 14 would make groups of 4, 3, 4 and 3
+    uint8_t groupOf(uint8_t row) {
+      return (row * SCAN_ROW_GROUPS) / rows;
+    }
+    uint8_t delayFor(uint8_t col, uint8_t row) {
+      return settle[col][groupOf(row)];
+    }
+    static uint8_t withMargin(uint16_t worst) {   // half again, plus one microsecond for timer resolution
+      uint16_t d = worst + (worst / 2) + 1;
+      if (d < SCAN_MIN_SETTLE) d = SCAN_MIN_SETTLE;
+      if (d > SCAN_MAX_SETTLE) d = SCAN_MAX_SETTLE;
+      return d;
+    }
+    /*
+      Measure one column and return its delays in
+      result[]. Returns false if a key seems to be held.
+    */
+    template <class P> bool measureColumn(P& probe, uint8_t col, uint8_t* result) {
+      for (uint8_t g = 0; g < SCAN_ROW_GROUPS; g++) {
+        uint16_t worst = 0;
+        for (uint8_t r = 0; r < rows; r++) {
+          if (groupOf(r) != g) continue;
+          for (uint8_t s = 0; s < SCAN_CAL_SAMPLES; s++) {
+            uint16_t t = probe.recoveryTime(col, r);
+            if (t == SCAN_CAL_STUCK) return false;
+            if (t > worst) worst = t;
+          }
+        }
+        uint8_t d = withMargin(worst);
+        while (!confirm(probe, col, g, d) && (d < SCAN_MAX_SETTLE)) {
+          d++;
+        }
+        result[g] = d;
+      }
+      return true;
+    }
+    /*
+      Calibrate every column. The profile only changes
+      if the whole sweep succeeds.
+    */
+    template <class P> bool calibrate(P& probe) {
+      uint8_t fresh[SCAN_MAX_COLS][SCAN_ROW_GROUPS];
+      for (uint8_t c = 0; c < cols; c++) {
+        if (!measureColumn(probe, c, fresh[c])) return false;
+      }
+      for (uint8_t c = 0; c < cols; c++) {
+        for (uint8_t g = 0; g < SCAN_ROW_GROUPS; g++) {
+          settle[c][g] = fresh[c][g];
+        }
+      }
+      return true;
+    }
+    /*
+      Re-check one column against the stored profile.
+      Delays only ever go up here; a board that got
+      slower (temperature, humidity, wear) is caught,
+      while getting faster waits for a full calibration.
+      Returns true if the profile changed.
+    */
+    template <class P> bool verifyColumn(P& probe, uint8_t col) {
+      uint8_t fresh[SCAN_ROW_GROUPS];
+      if (!measureColumn(probe, col, fresh)) return false;
+      bool changed = false;
+      for (uint8_t g = 0; g < SCAN_ROW_GROUPS; g++) {
+        if (fresh[g] > settle[col][g]) {
+          settle[col][g] = fresh[g];
+          changed = true;
+        }
+      }
+      return changed;
+    }
+    uint32_t totalSettle() {    // microseconds of waiting per full scan
+      uint32_t sum = 0;
+      for (uint8_t c = 0; c < cols; c++) {
+        for (uint8_t r = 0; r < rows; r++) {
+          sum += delayFor(c, r);
+        }
+      }
+      return sum;
+    }
+  private:
+    uint8_t cols;
+    uint8_t rows;
+    template <class P> bool confirm(P& probe, uint8_t col, uint8_t g, uint8_t d) {
+      for (uint8_t r = 0; r < rows; r++) {
+        if (groupOf(r) != g) continue;
+        for (uint8_t s = 0; s < SCAN_CAL_CONFIRMS; s++) {
+          if (!probe.readsClean(col, r, d)) return false;
+        }
+      }
+      return true;
+    }
+};
@@ -1,4 +1,12 @@
 #pragma once
+#include <stdint.h>
+/*
+  softTimer measures time from a clock the caller
+  passes in (microseconds), so the same timer works
+  against the hardware clock on the board, or a
+  virtual clock on a computer (see taskScheduler.h).
+*/
+#ifdef ARDUINO
 #include <Arduino.h>
 #include "hardware/timer.h"
 
@@ -6,24 +14,28 @@ uint64_t getTheCurrentTime() {
   uint64_t temp = timer_hw->timerawh;
   return (temp << 32) | timer_hw->timerawl;
 }
+#endif
 
 class softTimer {
   public:
     softTimer();                  // declare constructor
-    void start(uint64_t _delay_uS, uint64_t _defer_uS);
+    void start(uint64_t _delay_uS, uint64_t _defer_uS, uint64_t now);
                                   // declare function to start the timer
     void stop();                  // declare function to stop the timer
     void repeat();                // declare function to repeat the timer once after it finishes
-    void restart();               // declare function to restart the timer immediately
+    void restart(uint64_t now);   // declare function to restart the timer immediately
     void finish();                // declare function to flag timer as finished but have it keep running
-    bool justFinished();          // declare function to return whether the timer just finished (and stops if so)
+    bool justFinished(uint64_t now);
+                                  // declare function to return whether the timer just finished (and stops if so)
+    bool isFinished(uint64_t now);
+                                  // declare function to return whether the timer has finished, without stopping it
     bool isRunning();             // declare function to return whether the timer is still running
-    uint64_t execWhenFinished(void (*_callback)());
-                                  // declare function to run callback function when timer is just finished
-                                  // and return the length of time the callback function took to run
     uint64_t getStartTime();      // declare function to return the start time parameter
-    uint64_t getElapsed();        // declare function to return the elapsed time on the timer
-    uint64_t getRemaining();      // declare function to return the time remaining on the timer
+    uint64_t getDeadline();       // declare function to return when the timer will finish
+    uint64_t getElapsed(uint64_t now);
+                                  // declare function to return the elapsed time on the timer
+    uint64_t getRemaining(uint64_t now);
+                                  // declare function to return the time remaining on the timer
     uint64_t getDelay();          // declare function to return the delay entered on this timer
   private:
     uint64_t startTime;
@@ -39,8 +51,8 @@ softTimer::softTimer() {
   finishNow = false;
 }
 
-void softTimer::start(uint64_t _delay_uS, uint64_t _defer_uS) {
-  startTime = getTheCurrentTime() + _defer_uS;
+void softTimer::start(uint64_t _delay_uS, uint64_t _defer_uS, uint64_t now) {
+  startTime = now + _defer_uS;
   delay_uS = _delay_uS;
   running = true;
   finishNow = false;
@@ -57,49 +69,45 @@ void softTimer::repeat() {
   finishNow = false;  
 }
 
-void softTimer::restart() {
-  start(delay_uS, 0);
+void softTimer::restart(uint64_t now) {
+  start(delay_uS, 0, now);
 }
 
 void softTimer::finish() {
   finishNow = true;
 }
 
-bool softTimer::justFinished() {
-  if (running && (finishNow || (getElapsed() >= delay_uS))) {
+bool softTimer::justFinished(uint64_t now) {
+  if (isFinished(now)) {
     stop();
     return true;
   } // else {
   return false;  
 }
 
-bool softTimer::isRunning() {
-  return running;
+bool softTimer::isFinished(uint64_t now) {
+  return running && (finishNow || (getElapsed(now) >= delay_uS));
 }
 
-uint64_t softTimer::execWhenFinished(void (*_callback)()) {
-  uint64_t temp = 0;
-  if (justFinished()) {
-      temp = getTheCurrentTime();
-      _callback();
-      temp = getTheCurrentTime() - temp;
-      repeat();
-  }
-  return temp;
+bool softTimer::isRunning() {
+  return running;
 }
 
 uint64_t softTimer::getStartTime() {
   return startTime;  
 }
 
-uint64_t softTimer::getElapsed() {
-  uint64_t temp = getTheCurrentTime();
-  return (temp < startTime ? 0 : temp - startTime);
+uint64_t softTimer::getDeadline() {
+  return (finishNow ? startTime : startTime + delay_uS);
+}
+
+uint64_t softTimer::getElapsed(uint64_t now) {
+  return (now < startTime ? 0 : now - startTime);
 }
 
-uint64_t softTimer::getRemaining() {
+uint64_t softTimer::getRemaining(uint64_t now) {
   if (running) {
-    uint64_t temp = getElapsed();
+    uint64_t temp = getElapsed(now);
     if (finishNow || (temp >= delay_uS)) {
       return 0;
     } else {
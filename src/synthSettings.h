@@ -0,0 +1,46 @@
+/*
+  Settings of the built-in synth
+
+  The values the sketch plays the synth with, kept apart
+  from the code that uses them so that the host tools in
+  tests/ render and time exactly what the board plays.
+  Times and frequencies are in real units; the sketch and
+  each tool turn them into samples at their sample rate.
+
+  Effects (see src/audioEffects.h): the mod wheel sweeps
+  the filter's cutoff from FILTER_OPEN_HZ at rest down to
+  FILTER_CLOSED_HZ, along an exponential curve. Echo
+  feedback and the wet mix of each delay are in 1/256ths.
+
+  FM voices (see src/fmVoice.h): each preset is a ratio,
+  a peak and resting index, and how fast the one settles
+  to the other. The mod wheel adds up to FM_WHEEL_INDEX.
+*/
+#pragma once
+#include "fmVoice.h"
+
+#define FILTER_OPEN_HZ 6000.0         // must stay below a sixth of the sample rate
+#define FILTER_CLOSED_HZ 150.0
+#define FILTER_SOFT_DAMPING 5793      // Q of 0.707, no peak
+#define FILTER_RESONANT_DAMPING 1024  // Q of 4
+#define CHORUS_CENTRE_MS 15.0
+#define CHORUS_DEPTH_MS 3.0
+#define CHORUS_RATE_HZ 0.5
+#define CHORUS_WET 128
+#define ECHO_MS 250.0
+#define ECHO_FEEDBACK 112
+#define ECHO_WET 96
+#define LONG_ECHO_MS 600.0
+#define LONG_ECHO_FEEDBACK 144
+#define LONG_ECHO_WET 96
+
+#define FM_WHEEL_INDEX (4 * FM_RADIAN)
+constexpr fmPreset fmPresets[] = {
+  // name       ratio                 peak index          rest index          settle
+  { "E.Piano",  1 * FM_RATIO_ONE,     3 * FM_RADIAN,      FM_RADIAN / 4,      12 },
+  { "Bell",     7 * FM_RATIO_ONE / 2, 4 * FM_RADIAN,      FM_RADIAN / 2,      14 },
+  { "Brass",    1 * FM_RATIO_ONE,     2 * FM_RADIAN,      3 * FM_RADIAN / 2,  10 },
+  { "Bass",     FM_RATIO_ONE / 2,     5 * FM_RADIAN / 2,  4 * FM_RADIAN / 5,  11 },
+  { "Reed",     2 * FM_RATIO_ONE,     3 * FM_RADIAN / 2,  6 * FM_RADIAN / 5,  9 }
+};
+#define FM_PRESET_COUNT (sizeof(fmPresets) / sizeof(fmPresets[0]))
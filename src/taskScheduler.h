@@ -0,0 +1,180 @@
+/*
+  Cooperative task scheduler
+
+  The main loop used to run every job back to back, so
+  each one ran as often as the slowest allowed: the LEDs
+  were refreshed as often as the keys were scanned, and
+  the screensaver was checked thousands of times a second.
+
+  Instead, each job is registered as a task with a period,
+  a priority and a time budget (how long it is expected
+  to take, in microseconds). Every call to runNext() runs
+  at most one task: of those whose deadline has passed,
+  the highest priority, and of equal priorities, the one
+  that has waited longest. Tasks are never interrupted,
+  so the time before a key press is seen is at most the
+  scan period plus the longest task, however busy the
+  display is.
+
+  A task is held back if a higher priority task would fall
+  due before it could finish, as long as waiting helps:
+  that is, if the gap the higher priority task leaves
+  between its runs (its period less its budget) is long
+  enough for this one. A task too long for any gap just
+  runs, right away, and one held back for a whole period
+  runs anyway, so that it can't be kept waiting for ever.
+
+  A task that handles events at set times (the looper's
+  notes) can move its own deadline to the next one with
+  setDeadline(). Tasks that would still be running then
+  wait for it even when they are a period late, up to
+  two periods, so a late LED frame never makes a note
+  late unless the notes come too thick and fast for the
+  frame to fit between them.
+
+  Each task's deadlines are kept by a softTimer, moved on
+  one period at a time so they don't drift. A task that
+  starts a whole period or more late has missed that many
+  deadlines; these are counted, and the task picks up
+  from now rather than running again and again to catch
+  up. Runs that take longer than the budget are counted
+  too, along with the worst run time and lateness seen.
+
+  The clock is passed in, as an object with a now()
+  function returning microseconds, so the scheduler can
+  be run against a virtual clock on a computer.
+*/
+#pragma once
+#include <stdint.h>
+#include "softTimer.h"
+
+#define TASK_MAX 10
+#define TASK_NONE 255
+
+typedef void (*taskFunction)();
+
+struct taskDef {
+  const char* name;
+  taskFunction run;
+  uint8_t priority;       // higher goes first
+  uint32_t budget;        // microseconds
+  softTimer timer;        // the period, and when the next run is due
+  bool pinned;            // the next run was set by setDeadline
+  uint32_t runs;
+  uint32_t missed;        // deadlines that went by without a run
+  uint32_t overBudget;    // runs that took longer than the budget
+  uint32_t worstRun;      // microseconds
+  uint32_t worstLate;     // microseconds after the deadline, at the start of a run
+};
+
+class taskScheduler {
+  public:
+    taskScheduler() {
+      count = 0;
+    }
+    /*
+      The first run is due one period from now.
+      Returns the task's number, or TASK_NONE if full.
+    */
+    uint8_t add(const char* name, taskFunction run, uint32_t period, uint8_t priority, uint32_t budget, uint64_t now) {
+      if ((count >= TASK_MAX) || !period) return TASK_NONE;
+      taskDef& t = tasks[count];
+      t.name = name;
+      t.run = run;
+      t.priority = priority;
+      t.budget = budget;
+      t.timer.start(period, 0, now);
+      t.pinned = false;
+      resetStats(count);
+      return count++;
+    }
+    // change a task's period, e.g. when the frame rate is changed
+    void setPeriod(uint8_t n, uint32_t period, uint64_t now) {
+      if ((n < count) && period) tasks[n].timer.start(period, 0, now);
+    }
+    /*
+      Move a task's next run to a given time, e.g. to when
+      something it handles falls due. The run after that is
+      one period on, as usual.
+    */
+    void setDeadline(uint8_t n, uint64_t when) {
+      if (n >= count) return;
+      uint64_t period = tasks[n].timer.getDelay();
+      tasks[n].timer.start(period, 0, (when > period) ? (when - period) : 0);
+      tasks[n].pinned = true;
+    }
+    template <class C> uint8_t runNext(C& clock) {
+      uint64_t now = clock.now();
+      uint8_t pick = TASK_NONE;
+      for (uint8_t i = 0; i < count; i++) {
+        if (!tasks[i].timer.isFinished(now)) continue;
+        if ((pick == TASK_NONE) || (tasks[i].priority > tasks[pick].priority)
+          || ((tasks[i].priority == tasks[pick].priority)
+            && (tasks[i].timer.getDeadline() < tasks[pick].timer.getDeadline()))) {
+          pick = i;
+        }
+      }
+      if ((pick == TASK_NONE) || shouldWait(pick, now)) return TASK_NONE;
+      taskDef& t = tasks[pick];
+      uint64_t period = t.timer.getDelay();
+      uint64_t late = now - t.timer.getDeadline();
+      t.timer.repeat();        // before the run, so the task can move its own next deadline
+      t.pinned = false;
+      if (late >= period) {
+        t.missed += late / period;
+        t.timer.restart(now);
+      }
+      t.run();
+      uint64_t took = clock.now() - now;
+      t.runs++;
+      if (took > t.budget) t.overBudget++;
+      if (took > t.worstRun) t.worstRun = took;
+      if (late > t.worstLate) t.worstLate = late;
+      return pick;
+    }
+    // when the next task falls due, e.g. to sleep until then
+    uint64_t nextDeadline() {
+      uint64_t soonest = UINT64_MAX;
+      for (uint8_t i = 0; i < count; i++) {
+        uint64_t d = tasks[i].timer.getDeadline();
+        if (d < soonest) soonest = d;
+      }
+      return soonest;
+    }
+    void resetStats(uint8_t n) {
+      taskDef& t = tasks[n];
+      t.runs = 0;
+      t.missed = 0;
+      t.overBudget = 0;
+      t.worstRun = 0;
+      t.worstLate = 0;
+    }
+    uint32_t totalMissed() {
+      uint32_t sum = 0;
+      for (uint8_t i = 0; i < count; i++) sum += tasks[i].missed;
+      return sum;
+    }
+    uint32_t totalOverBudget() {
+      uint32_t sum = 0;
+      for (uint8_t i = 0; i < count; i++) sum += tasks[i].overBudget;
+      return sum;
+    }
+    taskDef tasks[TASK_MAX];
+    uint8_t count;
+  private:
+    bool shouldWait(uint8_t n, uint64_t now) {
+      taskDef& t = tasks[n];
+      uint64_t late = now - t.timer.getDeadline();
+      if (late >= 2 * t.timer.getDelay()) return false;
+      for (uint8_t i = 0; i < count; i++) {
+        taskDef& u = tasks[i];
+        if ((u.priority > t.priority)
+          && (u.timer.getDeadline() < now + t.budget)
+          && (u.timer.getDelay() >= (uint64_t)u.budget + t.budget)
+          && (u.pinned || (late < t.timer.getDelay()))) {
+          return true;
+        }
+      }
+      return false;
+    }
+};
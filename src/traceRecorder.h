@@ -0,0 +1,119 @@
+/*
+  Binary event trace
+
+  A fixed-size record of what the HexBoard did and when:
+  key presses and releases, MIDI notes sent, MPE channels
+  taken and given back, synth voices started and stopped,
+  and wheel changes. Each event is 8 bytes, stamped with
+  the low 32 bits of the microsecond timer, and written
+  into a ring buffer in RAM. Old events are overwritten,
+  so the buffer always holds the most recent history.
+
+  Each core writes to its own ring, so the two cores never
+  contend. Within a core, interrupts are masked for the
+  few instructions it takes to claim a slot, because the
+  synth and scheduler interrupts may trace as well.
+
+  Dumps are binary, and can be decoded on a computer with
+  tools/traceDecode.py into a text timeline or into a JSON
+  file that chrome://tracing or ui.perfetto.dev can open.
+  Dump layout (all little-endian):
+    "HXTR"    magic
+    uint8     format version (1)
+    uint8     number of rings (one per core)
+    uint16    records per ring
+    uint64    microsecond timer at the time of the dump
+    then for each ring:
+      uint32  total events ever written to this ring
+      uint32  number of records that follow (oldest first)
+      records of 8 bytes: uint32 time, uint8 type, uint8 a, int16 b
+
+  Set TRACE_ON to false in constants.h to compile it out.
+*/
+#pragma once
+#include <Arduino.h>
+#include "constants.h"
+#include "softTimer.h"
+
+#define TRACE_NONE 0
+#define TRACE_PRESS 1          // a = hex
+#define TRACE_RELEASE 2        // a = hex
+#define TRACE_MIDI_ON 3        // a = note, b = (channel << 8) | velocity
+#define TRACE_MIDI_OFF 4       // a = note, b = (channel << 8) | velocity
+#define TRACE_CH_ALLOC 5       // a = MIDI channel, b = hex
+#define TRACE_CH_FREE 6        // a = MIDI channel, b = hex
+#define TRACE_VOICE_ON 7       // a = synth channel, b = hex
+#define TRACE_VOICE_OFF 8      // a = synth channel, b = hex
+#define TRACE_WHEEL 9          // a = wheel (see below), b = new value
+#define TRACE_MARK 10          // a, b = free for ad hoc debugging
+#define TRACE_DROPPED 11       // a = what could not be done (see below), b = hex
+
+#define TRACE_WHEEL_MOD 0
+#define TRACE_WHEEL_PB 1
+#define TRACE_WHEEL_VEL 2
+
+#define TRACE_DROPPED_MIDI 0   // no free MPE channel
+#define TRACE_DROPPED_SYNTH 1  // no free synth voice
+#define TRACE_DROPPED_ARP 2    // the arpeggiator already holds ARP_MAX_HELD notes
+
+#if TRACE_ON
+  #include "hardware/timer.h"
+  #include "hardware/sync.h"
+
+  #define TRACE_RING_SIZE 1024   // records per core, must be a power of 2
+  #define TRACE_CORES 2
+
+  struct traceRecord {
+    uint32_t time;
+    uint8_t  type;
+    uint8_t  a;
+    int16_t  b;
+  };
+  static_assert(sizeof(traceRecord) == 8, "trace records are meant to be 8 bytes");
+
+  traceRecord traceRing[TRACE_CORES][TRACE_RING_SIZE];
+  volatile uint32_t traceHead[TRACE_CORES] = {0, 0};
+
+  void traceEvent(uint8_t type, uint8_t a, int16_t b) {
+    uint32_t core = get_core_num();
+    uint32_t irq = save_and_disable_interrupts();
+    uint32_t i = traceHead[core]++;
+    restore_interrupts(irq);
+    traceRecord& r = traceRing[core][i & (TRACE_RING_SIZE - 1)];
+    r.time = timer_hw->timerawl;
+    r.type = type;
+    r.a = a;
+    r.b = b;
+  }
+
+  void clearTrace() {
+    for (byte c = 0; c < TRACE_CORES; c++) {
+      traceHead[c] = 0;
+    }
+  }
+  /*
+    Write the dump to anything with a write(buffer, length)
+    function, e.g. Serial or a LittleFS File. Events written
+    while the dump is in progress may or may not be included.
+  */
+  template <class T> void dumpTrace(T& out) {
+    uint8_t header[16] = {'H', 'X', 'T', 'R', 1, TRACE_CORES,
+      (uint8_t)(TRACE_RING_SIZE & 0xFF), (uint8_t)(TRACE_RING_SIZE >> 8)};
+    uint64_t now = getTheCurrentTime();
+    memcpy(&header[8], &now, 8);
+    out.write(header, sizeof(header));
+    for (byte c = 0; c < TRACE_CORES; c++) {
+      uint32_t head = traceHead[c];
+      uint32_t count = (head < TRACE_RING_SIZE) ? head : TRACE_RING_SIZE;
+      out.write((const uint8_t*)&head, 4);
+      out.write((const uint8_t*)&count, 4);
+      for (uint32_t i = head - count; i != head; i++) {
+        out.write((const uint8_t*)&traceRing[c][i & (TRACE_RING_SIZE - 1)], sizeof(traceRecord));
+      }
+    }
+  }
+
+  #define TRACE(type, a, b) traceEvent((type), (a), (b))
+#else
+  #define TRACE(type, a, b)
+#endif
@@ -0,0 +1,166 @@
+/*
+  MIDI 2.0 Universal MIDI Packets
+
+  MIDI 2.0 channel voice messages are 64 bits (two 32-bit
+  words). A note on can carry its exact pitch as an
+  attribute, in 7.9 fixed point (note number in the top
+  7 bits, 1/512ths of a semitone below), and velocity is
+  16 bits. So a microtonal note needs neither its own
+  channel nor a separate pitch bend, which is what limits
+  MPE to 15 notes at a time.
+
+  The encoders below write words into a caller's buffer
+  and return how many were written. Nothing allocates.
+
+  In MIDI 2.0 the note number is just a name for the note
+  (the pitch attribute says what it sounds like), but it
+  still has to be unique on its channel while the note
+  is held. umpNoteTracker hands out channel / note number
+  pairs: it keeps the note number equal to the nearest
+  MIDI note where possible (for receivers that ignore the
+  attribute), and spreads notes over channels so that a
+  MIDI 1.0 copy of the stream stays in tune for as long
+  as there are channels to go around.
+
+  The sketch doesn't send UMPs yet: that needs a USB MIDI
+  2.0 endpoint (the host picking the MIDI 2.0 alternate
+  setting of the interface), and the USB stack the
+  firmware is built on only offers MIDI 1.0, so notes go
+  out over MPE. This library is ready for when it does;
+  tests/umpTest.cpp checks it against reference packets.
+*/
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+#define UMP_TYPE_MIDI2_VOICE 0x4
+#define UMP_NOTE_OFF 0x80
+#define UMP_NOTE_ON 0x90
+#define UMP_PER_NOTE_PITCH_BEND 0x60
+#define UMP_ATTRIBUTE_NONE 0x00
+#define UMP_ATTRIBUTE_PITCH_7_9 0x03
+#define UMP_PITCH_BEND_CENTER 0x80000000UL
+
+/*
+  Scale a MIDI 1.0 value up to more bits, the way the MIDI 2.0
+  spec does it: values up to the center are shifted, values
+  above repeat their low bits so that the maximum maps to the
+  maximum (e.g. 7-bit 127 becomes 16-bit 65535).
+*/
+inline uint32_t umpScaleUp(uint32_t value, uint8_t srcBits, uint8_t dstBits) {
+  uint8_t scaleBits = dstBits - srcBits;
+  uint32_t shifted = value << scaleBits;
+  if (value <= (1UL << (srcBits - 1))) return shifted;
+  uint8_t repeatBits = srcBits - 1;
+  uint32_t repeat = value & ((1UL << repeatBits) - 1);
+  if (scaleBits > repeatBits) {
+    repeat <<= (scaleBits - repeatBits);
+  } else {
+    repeat >>= (repeatBits - scaleBits);
+  }
+  while (repeat) {
+    shifted |= repeat;
+    repeat >>= repeatBits;
+  }
+  return shifted;
+}
+
+inline uint8_t umpVoiceMessage(uint32_t* out, uint8_t group, uint8_t status, uint8_t channel,
+  uint8_t index1, uint8_t index2, uint32_t data) {     // channel 0-15
+  out[0] = ((uint32_t)UMP_TYPE_MIDI2_VOICE << 28) | ((uint32_t)(group & 0x0F) << 24)
+    | ((uint32_t)(status | (channel & 0x0F)) << 16) | ((uint32_t)(index1 & 0x7F) << 8) | index2;
+  out[1] = data;
+  return 2;
+}
+inline uint8_t umpNoteOn(uint32_t* out, uint8_t group, uint8_t channel, uint8_t note, uint16_t velocity, uint16_t pitch79) {
+  return umpVoiceMessage(out, group, UMP_NOTE_ON, channel, note, UMP_ATTRIBUTE_PITCH_7_9,
+    ((uint32_t)velocity << 16) | pitch79);
+}
+inline uint8_t umpNoteOff(uint32_t* out, uint8_t group, uint8_t channel, uint8_t note, uint16_t velocity) {
+  return umpVoiceMessage(out, group, UMP_NOTE_OFF, channel, note, UMP_ATTRIBUTE_NONE,
+    ((uint32_t)velocity << 16));
+}
+inline uint8_t umpPerNotePitchBend(uint32_t* out, uint8_t group, uint8_t channel, uint8_t note, uint32_t bend) {
+  return umpVoiceMessage(out, group, UMP_PER_NOTE_PITCH_BEND, channel, note, 0, bend);
+}
+/*
+  Pitch as a 7.9 fixed point note number, from a
+  MIDI 1.0 note plus a 14-bit pitch bend (-8192..8191)
+  over a bend range of the given number of semitones.
+*/
+inline uint16_t umpPitch79(uint8_t note, int16_t bend, uint8_t bendSemitones) {
+  int32_t p = ((int32_t)note << 9) + (((int32_t)bend * bendSemitones) / 16);   // 512 / 8192 = 1 / 16
+  if (p < 0) p = 0;
+  if (p > 0xFFFF) p = 0xFFFF;
+  return p;
+}
+
+class umpNoteTracker {
+  public:
+    umpNoteTracker(uint8_t _firstCh, uint8_t _lastCh) {   // channels 1-16
+      firstCh = _firstCh;
+      lastCh = _lastCh;
+      clear();
+    }
+    void clear() {
+      memset(used, 0, sizeof(used));
+      memset(notesOn, 0, sizeof(notesOn));
+      nextCh = firstCh;
+    }
+    /*
+      Find a channel (1-16) and note number for a new note.
+      An empty channel comes first, then any channel where
+      the preferred note number is free, then the free
+      note number closest to it. Returns false only if
+      every note on every channel is taken.
+    */
+    bool claim(uint8_t preferredNote, uint8_t& channel, uint8_t& note) {
+      preferredNote &= 0x7F;
+      uint8_t span = lastCh - firstCh + 1;
+      for (uint8_t i = 0; i < span; i++) {
+        uint8_t ch = firstCh + ((nextCh - firstCh + i) % span);
+        if (!notesOn[ch - 1]) {
+          return take(ch, preferredNote, channel, note);
+        }
+      }
+      for (uint8_t i = 0; i < span; i++) {
+        uint8_t ch = firstCh + ((nextCh - firstCh + i) % span);
+        if (!isUsed(ch, preferredNote)) {
+          return take(ch, preferredNote, channel, note);
+        }
+      }
+      for (uint8_t d = 1; d < 128; d++) {
+        for (uint8_t ch = firstCh; ch <= lastCh; ch++) {
+          if ((preferredNote >= d) && !isUsed(ch, preferredNote - d)) {
+            return take(ch, preferredNote - d, channel, note);
+          }
+          if ((preferredNote + d <= 127) && !isUsed(ch, preferredNote + d)) {
+            return take(ch, preferredNote + d, channel, note);
+          }
+        }
+      }
+      return false;
+    }
+    void release(uint8_t channel, uint8_t note) {
+      if ((channel < 1) || (channel > 16) || !isUsed(channel, note)) return;
+      used[channel - 1][note >> 5] &= ~(1UL << (note & 31));
+      notesOn[channel - 1]--;
+    }
+    bool isUsed(uint8_t channel, uint8_t note) {
+      return (used[channel - 1][(note & 0x7F) >> 5] >> (note & 31)) & 1;
+    }
+  private:
+    uint32_t used[16][4];     // one bit per note number per channel
+    uint8_t notesOn[16];
+    uint8_t firstCh;
+    uint8_t lastCh;
+    uint8_t nextCh;           // round robin, so a channel just freed isn't reused straight away
+    bool take(uint8_t ch, uint8_t n, uint8_t& channel, uint8_t& note) {
+      used[ch - 1][n >> 5] |= (1UL << (n & 31));
+      notesOn[ch - 1]++;
+      nextCh = (ch == lastCh) ? firstCh : ch + 1;
+      channel = ch;
+      note = n;
+      return true;
+    }
+};
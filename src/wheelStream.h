@@ -0,0 +1,165 @@
+/*
+  Wheel motion and controller message pacing
+
+  A wheel used to move toward its target in fixed steps,
+  one step per message every 1/30 of a second, so a sweep
+  both lagged and came out in audible stairs. Now the
+  wheel glides: when its target changes, it works out how
+  long the move should take at the chosen speed, and its
+  value at any moment is read off a curve between where it
+  started and where it is going. The curve only changes
+  the shape of the move, not how long it takes:
+    linear  the same speed throughout
+    ease    quick at first, settling gently on the target
+    smooth  gentle at both ends (an S curve)
+
+  How often the value is sent is then up to the output,
+  not the wheel. A message goes out whenever the value has
+  changed and the port's byte budget allows, so a fast
+  sweep is sent as densely as the port can take, a slow
+  one only when the value actually moves, and a wheel at
+  rest sends nothing at all. Each port has its own budget
+  (a "token bucket" of bytes refilled at a steady rate),
+  so 31250 baud serial MIDI is never swamped by a sweep
+  that USB would take in its stride. A send may overdraw
+  the budget, so an update to many channels at once goes
+  out whole; the port then waits until it is back in
+  credit.
+
+  Modulation is sent as a 14-bit controller: CC 1 with
+  the top 7 bits, CC 33 with the bottom 7. A receiver
+  resets its low half whenever the top half arrives, so
+  cc14Parts says which halves need sending: both if the
+  top half changed (unless the bottom half is zero), and
+  just the bottom half otherwise, which is most of the
+  time in a slow sweep. Receivers that only know 7-bit
+  CC 1 ignore CC 33 and still follow along.
+
+  Nothing here touches hardware.
+*/
+#pragma once
+#include <stdint.h>
+
+#define WHEEL_CURVE_LINEAR 0
+#define WHEEL_CURVE_EASE 1
+#define WHEEL_CURVE_SMOOTH 2
+
+#define WHEEL_CURVE_ONE 65536        // the curve's input and output run from 0 to this
+
+#define CC14_MSB 1
+#define CC14_LSB 2
+#define CC14_NEVER_SENT -1
+#define PITCH_BEND_NEVER_SENT -32768   // outside the 14-bit range
+
+/*
+  Position along the move (0 to WHEEL_CURVE_ONE) for a
+  fraction of its time u (0 to WHEEL_CURVE_ONE).
+*/
+inline uint32_t wheelCurve(uint8_t curve, uint32_t u) {
+  if (u >= WHEEL_CURVE_ONE) return WHEEL_CURVE_ONE;
+  switch (curve) {
+    case WHEEL_CURVE_EASE: {        // 1 - (1 - u)^2
+      uint32_t r = WHEEL_CURVE_ONE - u;
+      return WHEEL_CURVE_ONE - (uint32_t)(((uint64_t)r * r) >> 16);
+    }
+    case WHEEL_CURVE_SMOOTH: {      // u^2 (3 - 2u), truncated only at the end so it never steps back
+      uint64_t u2 = (uint64_t)u * u;
+      return (uint32_t)((u2 * (3 * WHEEL_CURVE_ONE - 2 * u)) >> 32);
+    }
+    default:
+      return u;
+  }
+}
+
+class wheelGlide {
+  public:
+    wheelGlide() {
+      jumpTo(0);
+    }
+    void jumpTo(int16_t value) {
+      from = value;
+      to = value;
+      startTime = 0;
+      duration = 0;
+    }
+    /*
+      Start a move from the current value. A duration
+      of 0 jumps straight to the target.
+    */
+    void moveTo(int16_t value, int16_t target, uint64_t now, uint32_t _duration) {
+      from = value;
+      to = target;
+      startTime = now;
+      duration = _duration;
+    }
+    int16_t valueAt(uint64_t now, uint8_t curve) {
+      uint64_t elapsed = now - startTime;
+      if (!duration || (elapsed >= duration)) return to;
+      uint32_t u = (uint32_t)((elapsed << 16) / duration);
+      int32_t span = (int32_t)to - from;
+      return from + (int16_t)(((int64_t)span * wheelCurve(curve, u)) >> 16);
+    }
+    int16_t target() {
+      return to;
+    }
+  private:
+    int16_t from;
+    int16_t to;
+    uint64_t startTime;
+    uint32_t duration;    // microseconds
+};
+
+class byteBudget {
+  public:
+    byteBudget(uint32_t _bytesPerSecond, uint16_t _burst) {
+      bytesPerSecond = _bytesPerSecond;
+      burst = (int64_t)_burst * 1000000;
+      credit = burst;
+      lastTime = 0;
+    }
+    /*
+      True (and the bytes are taken) if the port is not in
+      debt; false if the message should wait.
+    */
+    bool spend(uint64_t now, uint16_t bytes) {
+      refill(now);
+      if (credit < 0) return false;
+      credit -= (int64_t)bytes * 1000000;
+      return true;
+    }
+    /*
+      Take the bytes regardless, for messages that can't
+      wait (e.g. the pitch bend that goes with a note on),
+      so the wheels make room for them.
+    */
+    void charge(uint64_t now, uint16_t bytes) {
+      refill(now);
+      credit -= (int64_t)bytes * 1000000;
+    }
+  private:
+    uint32_t bytesPerSecond;
+    int64_t burst;
+    int64_t credit;
+    uint64_t lastTime;
+    void refill(uint64_t now) {
+      if (now <= lastTime) return;   // callers' clocks may be read a moment apart
+      credit += (int64_t)(now - lastTime) * bytesPerSecond;   // in byte-microseconds
+      lastTime = now;
+      if (credit > burst) credit = burst;
+    }
+};
+
+/*
+  Which halves of a 14-bit controller to send to move a
+  receiver from lastSent (or CC14_NEVER_SENT) to value.
+*/
+inline uint8_t cc14Parts(int16_t lastSent, int16_t value) {
+  if (lastSent == value) return 0;
+  if ((lastSent < 0) || ((lastSent >> 7) != (value >> 7))) {
+    return CC14_MSB | ((value & 0x7F) ? CC14_LSB : 0);
+  }
+  return CC14_LSB;
+}
+inline uint8_t cc14Bytes(uint8_t parts) {
+  return 3 * (((parts & CC14_MSB) ? 1 : 0) + ((parts & CC14_LSB) ? 1 : 0));
+}
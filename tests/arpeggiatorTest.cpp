@@ -0,0 +1,402 @@
+/*
+  src/arpeggiator.h: step order for each pattern, and
+  that adding or removing notes mid-pattern neither skips
+  nor repeats the notes still held. Hexes are numbered
+  after their pitch to keep the expectations readable.
+  Then MIDI clock, in a simulation of the sketch: ticks
+  read late by the MIDI task, and steps played by an
+  alarm, compared with the sender's own step boundaries.
+*/
+#include <math.h>
+#include <vector>
+#include "hostTest.h"
+#include "arpeggiator.h"
+
+static void hold(arpeggiator& a, uint8_t hex) {
+  CHECK(a.add(hex, hex));
+}
+
+static void expectSteps(arpeggiator& a, uint8_t pattern, const uint8_t* expected, int n, int line) {
+  for (int i = 0; i < n; i++) {
+    uint8_t got = a.step(pattern);
+    if (got != expected[i]) {
+      printf("%s:%d: step %d is %d, expected %d\n", __FILE__, line, i, got, expected[i]);
+      testFailures++;
+    }
+  }
+}
+#define EXPECT_STEPS(a, pattern, ...) do { \
+    const uint8_t e_[] = { __VA_ARGS__ }; \
+    expectSteps(a, pattern, e_, sizeof(e_), __LINE__); \
+  } while (0)
+
+static void testPatterns() {
+  arpeggiator a;
+  CHECK_EQUAL(a.step(ARP_PATTERN_UP), ARP_NONE);
+  hold(a, 30);
+  hold(a, 10);
+  hold(a, 40);
+  hold(a, 20);
+  CHECK_EQUAL(a.mostRecent(), 20);
+  EXPECT_STEPS(a, ARP_PATTERN_UP, 10, 20, 30, 40, 10);
+  a.clear();
+  hold(a, 30); hold(a, 10); hold(a, 40); hold(a, 20);
+  EXPECT_STEPS(a, ARP_PATTERN_DOWN, 40, 30, 20, 10, 40);
+  a.clear();
+  hold(a, 30); hold(a, 10); hold(a, 40); hold(a, 20);
+  EXPECT_STEPS(a, ARP_PATTERN_UPDOWN, 10, 20, 30, 40, 30, 20, 10, 20);
+  a.clear();
+  hold(a, 30); hold(a, 10); hold(a, 40); hold(a, 20);
+  EXPECT_STEPS(a, ARP_PATTERN_PLAYED, 30, 10, 40, 20, 30);
+  // holding a note twice doesn't add it twice
+  CHECK(a.add(30, 30));
+  CHECK_EQUAL(a.count(), 4);
+}
+
+static void testPlayedOrderChanges() {
+  arpeggiator a;
+  hold(a, 30); hold(a, 10); hold(a, 40); hold(a, 20);
+  EXPECT_STEPS(a, ARP_PATTERN_PLAYED, 30, 10);
+  a.remove(30);                                    // before the cursor
+  EXPECT_STEPS(a, ARP_PATTERN_PLAYED, 40, 20, 10);
+  a.remove(40);                                    // the next note
+  EXPECT_STEPS(a, ARP_PATTERN_PLAYED, 20, 10);
+  hold(a, 50);                                     // joins at the end of the order
+  EXPECT_STEPS(a, ARP_PATTERN_PLAYED, 20, 50, 10, 20);
+  a.remove(20);                                    // the last note, with the cursor past it
+  EXPECT_STEPS(a, ARP_PATTERN_PLAYED, 50, 10);
+}
+
+static void testUpChanges() {
+  arpeggiator a;
+  hold(a, 10); hold(a, 20); hold(a, 30); hold(a, 40);
+  EXPECT_STEPS(a, ARP_PATTERN_UP, 10, 20);
+  a.remove(10);
+  EXPECT_STEPS(a, ARP_PATTERN_UP, 30, 40, 20);
+  hold(a, 25);                                     // between the last step and the next: plays next
+  EXPECT_STEPS(a, ARP_PATTERN_UP, 25, 30, 40, 20);
+  hold(a, 5);                                      // behind the cursor: waits for the next pass
+  EXPECT_STEPS(a, ARP_PATTERN_UP, 25, 30, 40, 5, 20);
+}
+
+static void testDownChanges() {
+  arpeggiator a;
+  hold(a, 10); hold(a, 20); hold(a, 30); hold(a, 40);
+  EXPECT_STEPS(a, ARP_PATTERN_DOWN, 40, 30);
+  a.remove(40);                                    // already played
+  EXPECT_STEPS(a, ARP_PATTERN_DOWN, 20, 10, 30);
+  a.remove(20);                                    // the next note: the one below it comes instead
+  EXPECT_STEPS(a, ARP_PATTERN_DOWN, 10, 30);
+  hold(a, 15);                                     // between the last step and the next: plays next
+  hold(a, 50);                                     // above: waits for the next pass
+  EXPECT_STEPS(a, ARP_PATTERN_DOWN, 15, 10, 50, 30, 15);
+  a.remove(10);                                    // the bottom note, with the cursor on it
+  EXPECT_STEPS(a, ARP_PATTERN_DOWN, 50, 30, 15, 50);
+}
+
+static void testUpDownChanges() {
+  arpeggiator a;
+  hold(a, 10); hold(a, 20); hold(a, 30); hold(a, 40);
+  EXPECT_STEPS(a, ARP_PATTERN_UPDOWN, 10, 20, 30, 40, 30);
+  a.remove(40);                                    // on the way down, above the cursor
+  EXPECT_STEPS(a, ARP_PATTERN_UPDOWN, 20, 10, 20, 30, 20);
+  a.remove(10);                                    // on the way down, the next note
+  EXPECT_STEPS(a, ARP_PATTERN_UPDOWN, 30, 20, 30);
+}
+
+static void testRemoveAll() {
+  arpeggiator a;
+  hold(a, 10); hold(a, 20);
+  a.step(ARP_PATTERN_DOWN);
+  a.remove(10);
+  a.remove(20);
+  CHECK_EQUAL(a.count(), 0);
+  CHECK_EQUAL(a.step(ARP_PATTERN_DOWN), ARP_NONE);
+  hold(a, 30);
+  EXPECT_STEPS(a, ARP_PATTERN_DOWN, 30, 30);
+  EXPECT_STEPS(a, ARP_PATTERN_PLAYED, 30, 30);
+  // a full set
+  a.clear();
+  for (int i = 0; i < ARP_MAX_HELD; i++) {
+    hold(a, i);
+  }
+  CHECK(!a.add(200, 200));
+}
+
+static void testInternalTiming() {
+  CHECK_EQUAL(arpeggiator::stepLength(120, 4), 500000);    // quarter notes at 120 BPM
+  CHECK_EQUAL(arpeggiator::stepLength(120, 16), 125000);
+  CHECK_EQUAL(arpeggiator::stepLength(0, 16), 0);
+  CHECK_EQUAL(arpeggiator::ticksPerStep(16), 6);
+  CHECK_EQUAL(arpeggiator::ticksPerStep(128), 1);
+  arpeggiator a;
+  CHECK_EQUAL(a.followingStep(1000000, 1000000, ARP_SYNC_INTERNAL, 120, 4), 1500000);
+  CHECK_EQUAL(a.followingStep(1000000, 2000000, ARP_SYNC_INTERNAL, 120, 4), 2500000);   // behind: skips
+}
+
+/*
+  The sender ticks exactly on time. Its bytes are read by
+  a task that runs every READ_PERIOD, up to READ_JITTER
+  late, as readMIDI() is in the sketch, and steps are
+  played by an alarm at the time the arpeggiator asked
+  for, or straight away if that has passed. Each step is
+  compared with when the sender sent its boundary's tick.
+*/
+#define READ_PERIOD 2000
+#define READ_JITTER 300
+#define SETTLE_BEATS 32
+#define STEP_LATE 120            // microseconds after the sender's boundary, at most
+#define STEP_EARLY 40            // and before it
+
+struct playedStep {
+  uint64_t at;
+  uint8_t hex;
+  double error;                  // microseconds after the sender's boundary
+};
+
+class clockSim {
+  public:
+    clockSim(uint16_t bpm, uint8_t _division, uint32_t _seed) {
+      period = 60000000.0 / (bpm * 24.0);
+      division = _division;
+      seed = _seed;
+      sendTime = 1000000.5;
+      playing = true;            // joined while the song was already playing
+      nextRun = 0;
+      nextStep = 0;
+      lastRead = 0;
+      stepsSinceStart = 0;
+      a.add(10, 10);
+      a.add(20, 20);
+      a.add(30, 30);
+    }
+    void ticks(uint32_t n) {
+      for (uint32_t i = 0; i < n; i++) {
+        if (playing) sentAt.push_back(sendTime);
+        receive(0xF8, sendTime);
+        sendTime += period;
+      }
+    }
+    // Start, Stop and Continue go out halfway between ticks
+    void message(uint8_t status) {
+      playing = (status != 0xFC);
+      if (status == 0xFA) sentAt.clear();
+      receive(status, sendTime - period / 2);
+    }
+    // the sender goes quiet
+    void pause(double us) {
+      sendTime += us;
+    }
+    // play any steps due up to t
+    void runUntil(uint64_t t) {
+      while (nextStep && (nextStep <= t)) {
+        uint64_t now = nextStep;
+        uint32_t boundary = stepsSinceStart * arpeggiator::ticksPerStep(division);
+        double due = (boundary < sentAt.size()) ? sentAt[boundary]
+          : sentAt.back() + (boundary + 1 - sentAt.size()) * period;
+        steps.push_back({ now, a.step(ARP_PATTERN_UP), now - due });
+        stepsSinceStart++;
+        nextStep = a.followingStep(nextStep, now, ARP_SYNC_MIDI_CLOCK, 0, division);
+      }
+    }
+    // reports steps first to last - 1 more than STEP_EARLY early or STEP_LATE late
+    void expectOnTime(size_t first, size_t last, int line) {
+      for (size_t i = first; i < last; i++) {
+        double e = steps[i].error;
+        if ((e < -STEP_EARLY) || (e > STEP_LATE)) {
+          printf("%s:%d: %.0f BPM, division %d: step %d played %.0f us after the sender's boundary\n",
+            __FILE__, line, 60000000.0 / (period * 24), division, (int)i, e);
+          testFailures++;
+          return;
+        }
+      }
+    }
+    arpeggiator a;
+    std::vector<playedStep> steps;
+    std::vector<double> sentAt;   // each tick of the song since Start
+    double period;
+    uint64_t nextStep;            // the alarm, 0 if not set
+    uint64_t lastRead;
+  private:
+    uint8_t division;
+    uint32_t seed;
+    double sendTime;              // of the next tick
+    bool playing;
+    uint64_t nextRun;
+    uint32_t stepsSinceStart;
+    uint32_t random() {
+      seed ^= seed << 13;
+      seed ^= seed >> 17;
+      seed ^= seed << 5;
+      return seed;
+    }
+    // the first run of the MIDI task at or after t
+    uint64_t readTime(double t) {
+      while ((double)nextRun < t) {
+        uint64_t slot = nextRun / READ_PERIOD + 1;
+        nextRun = slot * READ_PERIOD + random() % (READ_JITTER + 1);
+      }
+      return nextRun;
+    }
+    void receive(uint8_t status, double sent) {
+      uint64_t now = readTime(sent);
+      runUntil(now);
+      lastRead = now;
+      uint64_t next;
+      switch (status) {
+        case 0xF8:
+          if (a.clockTick(now, next)) {
+            nextStep = (next > now) ? next : now;
+          }
+          break;
+        case 0xFA:
+          nextStep = a.clockStart(now, next) ? next : 0;
+          stepsSinceStart = 0;
+          break;
+        case 0xFB:
+          if (a.clockContinue(now, next)) {
+            nextStep = next;
+          }
+          break;
+        case 0xFC:
+          a.clockStop();
+          nextStep = 0;
+          break;
+      }
+    }
+};
+
+#define BAR (4 * MIDI_CLOCKS_PER_BEAT)
+
+static const uint16_t clockBPM[] = { 40, 60, 97, 120, 133, 200, 240 };
+static const uint8_t clockDivision[] = { 4, 8, 12, 16, 24, 32 };
+#define CLOCK_BPMS (sizeof(clockBPM) / sizeof(clockBPM[0]))
+#define CLOCK_DIVISIONS (sizeof(clockDivision) / sizeof(clockDivision[0]))
+
+/*
+  Join a clock that is already running, and give it eight
+  bars to settle. Start: the first tick after it is the
+  downbeat, and the pattern starts again from the bottom.
+  Every step from the downbeat on is on time.
+*/
+static void testClockSteady() {
+  for (uint8_t b = 0; b < CLOCK_BPMS; b++) {
+    for (uint8_t d = 0; d < CLOCK_DIVISIONS; d++) {
+      clockSim sim(clockBPM[b], clockDivision[d], 12345 + b * 7 + d);
+      sim.ticks(SETTLE_BEATS * MIDI_CLOCKS_PER_BEAT);
+      size_t started = sim.steps.size();
+      sim.message(0xFA);
+      sim.ticks(16 * BAR);
+      sim.runUntil(sim.lastRead);
+      CHECK_EQUAL(sim.steps.size() - started, 16 * clockDivision[d]);
+      CHECK_EQUAL(sim.steps[started].hex, 10);
+      sim.expectOnTime(started, sim.steps.size(), __LINE__);
+      CHECK(fabs(sim.a.tickInterval - sim.period) <= 1);
+    }
+  }
+}
+
+/*
+  Stop halfway through a bar: nothing plays, whether the
+  sender keeps the clock going or not, and the song only
+  moves on while it plays. Continue picks the pattern up
+  where it left off, on the sender's boundaries: straight
+  away if the clock kept going, and within two beats if
+  it had to be picked up again.
+*/
+static void testClockStopContinue() {
+  for (int keepClock = 0; keepClock < 2; keepClock++) {
+    clockSim sim(120, 16, 777 + keepClock);
+    sim.ticks(SETTLE_BEATS * MIDI_CLOCKS_PER_BEAT);
+    size_t started = sim.steps.size();
+    sim.message(0xFA);
+    sim.ticks(4 * BAR + BAR / 2);
+    sim.runUntil(sim.lastRead);
+    size_t stopped = sim.steps.size();
+    CHECK_EQUAL(stopped - started, 4 * 16 + 8);
+    uint8_t lastHex = sim.steps.back().hex;
+    sim.message(0xFC);
+    if (keepClock) {
+      sim.ticks(2 * BAR);
+    } else {
+      sim.pause(2000000);
+    }
+    sim.runUntil(sim.lastRead + 1000000);
+    CHECK_EQUAL(sim.steps.size(), stopped);
+    sim.message(0xFB);
+    sim.ticks(4 * BAR - BAR / 2);
+    sim.runUntil(sim.lastRead);
+    CHECK_EQUAL(sim.steps.size() - started, 8 * 16);
+    CHECK_EQUAL(sim.steps[stopped].hex, (lastHex == 30) ? 10 : lastHex + 10);
+    sim.expectOnTime(keepClock ? stopped : stopped + 8, sim.steps.size(), __LINE__);
+  }
+}
+
+/*
+  The clock goes quiet with no Stop, say a cable pulled
+  out: steps carry on from the last tempo until
+  MIDI_CLOCK_TIMEOUT, then stop. When the clock comes
+  back, the steps pick up again, and the gap doesn't
+  count towards the tempo.
+*/
+static void testClockTimeout() {
+  clockSim sim(120, 16, 4242);
+  sim.ticks(SETTLE_BEATS * MIDI_CLOCKS_PER_BEAT);
+  sim.message(0xFA);
+  sim.ticks(4 * BAR);
+  sim.runUntil(sim.lastRead);
+  uint64_t lastTick = sim.lastRead;
+  size_t before = sim.steps.size();
+  sim.pause(2000000);
+  sim.runUntil(lastTick + 2000000);
+  CHECK(sim.steps.size() > before);
+  CHECK(sim.steps.back().at <= lastTick + MIDI_CLOCK_TIMEOUT + arpeggiator::stepLength(120, 16));
+  CHECK_EQUAL(sim.nextStep, 0);
+  size_t resumed = sim.steps.size();
+  sim.ticks(4 * BAR);
+  sim.runUntil(sim.lastRead);
+  CHECK(sim.steps.size() > resumed);
+  sim.expectOnTime(resumed + 4, sim.steps.size(), __LINE__);
+  CHECK(fabs(sim.a.tickInterval - sim.period) <= 1);
+}
+
+/*
+  A change of tempo can't be seen until it has happened,
+  so it is followed within a millisecond after a bar, and
+  on time again after eight.
+*/
+static void testClockTempoChange() {
+  clockSim sim(120, 16, 99);
+  sim.ticks(SETTLE_BEATS * MIDI_CLOCKS_PER_BEAT);
+  sim.message(0xFA);
+  sim.ticks(4 * BAR);
+  sim.period = 60000000.0 / (100 * 24.0);
+  sim.ticks(BAR);
+  sim.runUntil(sim.lastRead);
+  size_t followed = sim.steps.size();
+  sim.ticks(7 * BAR);
+  sim.runUntil(sim.lastRead);
+  size_t settled = sim.steps.size();
+  for (size_t i = followed; i < settled; i++) {
+    CHECK(fabs(sim.steps[i].error) < 1000);
+  }
+  sim.ticks(8 * BAR);
+  sim.runUntil(sim.lastRead);
+  sim.expectOnTime(settled, sim.steps.size(), __LINE__);
+  CHECK(fabs(sim.a.tickInterval - sim.period) <= 1);
+}
+
+int main() {
+  testPatterns();
+  testPlayedOrderChanges();
+  testUpChanges();
+  testDownChanges();
+  testUpDownChanges();
+  testRemoveAll();
+  testInternalTiming();
+  testClockSteady();
+  testClockStopContinue();
+  testClockTimeout();
+  testClockTempoChange();
+  return TEST_RESULT();
+}
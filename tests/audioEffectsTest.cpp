@@ -0,0 +1,124 @@
+/*
+  src/audioEffects.h: the filter passes steady input and
+  damps the highest frequencies; the delay repeats at its
+  length, never goes out of range, and plays dry while it
+  clears its buffer after a change, with nothing of the
+  old sound left afterwards.
+*/
+#include <stdlib.h>
+#include "hostTest.h"
+#include "audioEffects.h"
+
+#define TEST_DELAY_SAMPLES 4096
+
+static int16_t buffer[TEST_DELAY_SAMPLES];
+
+// feed silence until the delay has cleared its buffer
+static void settle(delayLine& d) {
+  for (int i = 0; i < TEST_DELAY_SAMPLES / FX_DELAY_CLEAR_STEP; i++) {
+    CHECK_EQUAL(d.process(0), 0);
+  }
+}
+
+static void testFilter() {
+  svFilter f;
+  f.set(FX_ONE / 4, 5793);
+  int32_t y = 0;
+  for (int i = 0; i < 2000; i++) y = f.process(10000);
+  CHECK(abs(y - 10000) < 50);
+  f.clear();
+  int32_t peak = 0;
+  for (int i = 0; i < 2000; i++) {
+    y = f.process((i & 1) ? 10000 : -10000);        // the highest frequency there is
+    if ((i > 1000) && (abs(y) > peak)) peak = abs(y);
+  }
+  CHECK(peak < 1000);
+  f.set(FX_ONE, 256);                                 // as resonant as it goes, and far too high
+  for (int i = 0; i < 10000; i++) {
+    y = f.process((i % 7 < 3) ? FX_SAMPLE_MAX : -FX_SAMPLE_MAX);
+    CHECK(abs(y) <= FX_SAMPLE_MAX);
+  }
+}
+
+static void testEcho() {
+  delayLine d;
+  CHECK_EQUAL(d.samples(), 0);
+  d.begin(buffer, TEST_DELAY_SAMPLES);
+  CHECK_EQUAL(d.samples(), TEST_DELAY_SAMPLES);
+  d.setEcho(100, 128, 128);
+  CHECK_EQUAL(d.process(5000), 5000);                // dry while clearing
+  settle(d);
+  CHECK_EQUAL(d.process(8000), 4000);                // half wet, nothing behind it yet
+  for (int i = 1; i < 100; i++) CHECK_EQUAL(d.process(0), 0);
+  CHECK_EQUAL(d.process(0), 2000);                   // the echo: half fed back, heard half wet
+  for (int i = 1; i < 100; i++) CHECK_EQUAL(d.process(0), 0);
+  CHECK_EQUAL(d.process(0), 1000);                   // and its echo, half as loud
+  // longer than the buffer: cut to fit
+  d.setEcho(60000, 0, 255);
+  settle(d);
+  d.process(8000);
+  int n = 1;
+  while ((d.process(0) == 0) && (n < 2 * TEST_DELAY_SAMPLES)) n++;
+  CHECK_EQUAL(n, TEST_DELAY_SAMPLES - 1);
+}
+
+// a change clears what was ringing, without the main loop touching the buffer
+static void testChange() {
+  delayLine d;
+  d.begin(buffer, TEST_DELAY_SAMPLES);
+  d.setEcho(50, 250, 200);
+  settle(d);
+  for (int i = 0; i < 500; i++) d.process((i % 40 < 20) ? 20000 : -20000);
+  d.setEcho(50, 250, 200);
+  for (int i = 0; i < TEST_DELAY_SAMPLES / FX_DELAY_CLEAR_STEP; i++) {
+    CHECK_EQUAL(d.process(123), 123);
+  }
+  for (int i = 0; i < 1000; i++) {
+    CHECK_EQUAL(d.process(0), 0);
+  }
+  // changed twice before the synth gets to it: the last one counts
+  d.setEcho(10, 0, 128);
+  d.setEcho(20, 0, 128);
+  settle(d);
+  d.process(8000);
+  for (int i = 1; i < 20; i++) CHECK_EQUAL(d.process(0), 0);
+  CHECK_EQUAL(d.process(0), 4000);
+}
+
+static void testChorus() {
+  delayLine d;
+  d.begin(buffer, TEST_DELAY_SAMPLES);
+  d.setChorus(625, 125, 51540, 128);     // 3 ms either side of 15 ms, at 0.5 Hz, at this sample rate
+  settle(d);
+  int32_t lo = 0;
+  int32_t hi = 0;
+  for (int i = 0; i < 100000; i++) {
+    int32_t y = d.process((i % 97 < 48) ? FX_SAMPLE_MAX : -FX_SAMPLE_MAX);
+    if (y < lo) lo = y;
+    if (y > hi) hi = y;
+  }
+  CHECK(hi <= FX_SAMPLE_MAX);
+  CHECK(lo >= -FX_SAMPLE_MAX);
+  CHECK(hi > FX_SAMPLE_MAX / 2);
+  // a centre too long for the buffer is cut to half of it
+  d.setChorus(60000, 100, 51540, 255);
+  settle(d);
+  d.process(8000);
+  int n = 1;
+  while ((d.process(0) == 0) && (n < 2 * TEST_DELAY_SAMPLES)) n++;
+  CHECK(n <= TEST_DELAY_SAMPLES / 2 + 100);
+  // no centre at all is one sample behind, not a sweep wrapped round to 65535
+  d.setChorus(0, 100, 51540, 255);
+  settle(d);
+  CHECK_EQUAL(d.process(8000), 8000 + ((255 * -8000) >> 8));
+  CHECK_EQUAL(d.process(0), 255 * 8000 >> 8);
+  CHECK_EQUAL(d.process(0), 0);
+}
+
+int main() {
+  testFilter();
+  testEcho();
+  testChange();
+  testChorus();
+  return TEST_RESULT();
+}
@@ -0,0 +1,44 @@
+/*
+  Timing for the benchmarks. A function is run many times
+  on this computer and the time per call is scaled down
+  to the RP2040 by HOST_SPEEDUP: a Cortex-M0+ at 133 MHz
+  does at best one instruction per cycle, against a few
+  per cycle at a few GHz on a desktop core. 100 errs on
+  the slow side for integer code like the synth's; the
+  real figure is on the board's diagnostics page (poll
+  lateness and overruns, with PROFILING_ON).
+
+  Each result is checked against the synth's deadline:
+  one sample every POLL_US microseconds, of which the
+  voices and effects may take POLL_BUDGET_US, leaving
+  the rest for the interrupt itself and the other core's
+  share of the bus.
+*/
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include <chrono>
+
+#define HOST_SPEEDUP 100.0
+#define POLL_US 24.0
+#define POLL_BUDGET_US 18.0
+#define POLL_SAMPLE_RATE 41667   // 1 / 24 us
+
+volatile int32_t benchmarkSink;  // keeps the work from being optimised away
+
+template <class F> double hostNanosPerCall(F f, uint32_t calls) {
+  f();   // warm up
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < calls; i++) f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / calls;
+}
+
+// prints a line for the result, and returns false if it won't fit the budget on the board
+inline bool reportPerSample(const char* what, double hostNanos) {
+  double boardMicros = hostNanos * HOST_SPEEDUP / 1000.0;
+  bool fits = (boardMicros <= POLL_BUDGET_US);
+  printf("%-28s %8.1f ns here, about %5.2f us on the board: %3.0f%% of the %.0f us per sample (%s)\n",
+    what, hostNanos, boardMicros, 100.0 * boardMicros / POLL_US, POLL_US, fits ? "fits" : "TOO SLOW");
+  return fits;
+}
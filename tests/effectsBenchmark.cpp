@@ -0,0 +1,60 @@
+/*
+  src/audioEffects.h: time per sample of each effect,
+  and of the filter and chorus together, on a mix of
+  eight sawtooth voices, scaled to the board (see
+  benchmark.h). Run by hand:
+    build/effectsBenchmark
+  Returns non-zero if anything won't fit the budget.
+*/
+#include <math.h>
+#include "benchmark.h"
+#include "audioEffects.h"
+
+#define BENCH_SAMPLES 2000000
+
+static int16_t buffer[FX_DELAY_MAX_SAMPLES];
+static svFilter filter;
+static delayLine delay;
+static int16_t input[4096];     // worked out beforehand, so only the effects are timed
+static uint32_t at = 0;
+
+static int32_t mix() {
+  return input[(at++) & 4095];
+}
+
+int main() {
+  uint16_t counter[8] = {};
+  const uint16_t increment[8] = { 412, 519, 617, 824, 1038, 1235, 1648, 2076 };
+  for (int n = 0; n < 4096; n++) {
+    int32_t sum = 0;
+    for (int i = 0; i < 8; i++) {
+      counter[i] += increment[i];
+      sum += counter[i];
+    }
+    input[n] = (sum >> 3) - 32768;
+  }
+  delay.begin(buffer, FX_DELAY_MAX_SAMPLES);
+  filter.set(round(FX_ONE * 2.0 * sin(M_PI * 1000.0 / POLL_SAMPLE_RATE)), 1024);
+  bool fits = true;
+
+  double t = hostNanosPerCall([]() { benchmarkSink = filter.process(mix()); }, BENCH_SAMPLES);
+  fits &= reportPerSample("filter", t);
+
+  delay.setEcho(25000, 144, 96);
+  for (int i = 0; i < FX_DELAY_MAX_SAMPLES / FX_DELAY_CLEAR_STEP; i++) delay.process(0);
+  t = hostNanosPerCall([]() { benchmarkSink = delay.process(mix()); }, BENCH_SAMPLES);
+  fits &= reportPerSample("echo", t);
+
+  delay.setChorus(625, 125, 51540, 128);
+  for (int i = 0; i < FX_DELAY_MAX_SAMPLES / FX_DELAY_CLEAR_STEP; i++) delay.process(0);
+  t = hostNanosPerCall([]() { benchmarkSink = delay.process(mix()); }, BENCH_SAMPLES);
+  fits &= reportPerSample("chorus", t);
+
+  t = hostNanosPerCall([]() { benchmarkSink = delay.process(filter.process(mix())); }, BENCH_SAMPLES);
+  fits &= reportPerSample("filter and chorus", t);
+
+  delay.setEcho(25000, 144, 96);    // the worst case for a change: a whole buffer to clear
+  t = hostNanosPerCall([]() { delay.setEcho(25000, 144, 96); benchmarkSink = delay.process(mix()); }, 20000);
+  fits &= reportPerSample("clearing after a change", t);
+  return fits ? 0 : 1;
+}
@@ -0,0 +1,73 @@
+/*
+  src/audioEffects.h: renders a short phrase of sawtooth
+  chords through each effect to WAV files, to listen to.
+  Run by hand:
+    build/effectsRender [directory]
+  writes effects-dry.wav, effects-filter.wav (the mod
+  wheel moved from open to closed and back, resonant),
+  effects-chorus.wav, effects-echo.wav and
+  effects-long-echo.wav, with the settings the sketch
+  uses (src/synthSettings.h, as applyEffects in the
+  sketch sets them).
+*/
+#include <math.h>
+#include <string>
+#include "benchmark.h"
+#include "phrase.h"
+#include "wavWriter.h"
+#include "audioEffects.h"
+#include "synthSettings.h"
+
+#define RENDER_SECONDS 6
+
+static int16_t buffer[FX_DELAY_MAX_SAMPLES];
+
+// the phrase on sawtooth waves
+static int32_t phrase(uint32_t n) {
+  if (!phraseSounding(n)) return 0;
+  const double* chord = phraseChordAt(n);
+  int32_t sum = 0;
+  for (int v = 0; v < PHRASE_VOICES; v++) {
+    uint16_t p = (uint16_t)(n * chord[v] * 65536.0 / POLL_SAMPLE_RATE);
+    sum += p - 32768;
+  }
+  return sum / 4;
+}
+
+static bool render(const std::string& path, svFilter* filter, delayLine* delay) {
+  wavWriter w;
+  if (!w.open(path.c_str(), POLL_SAMPLE_RATE)) return false;
+  for (uint32_t n = 0; n < RENDER_SECONDS * POLL_SAMPLE_RATE; n++) {
+    int32_t s = phrase(n);
+    if (filter) {
+      if (!(n % 256)) {      // as the wheel is read, far less often than each sample
+        double wheel = 0.5 - 0.5 * cos(2.0 * M_PI * n / (RENDER_SECONDS * POLL_SAMPLE_RATE));
+        double hz = FILTER_OPEN_HZ * exp2(log2(FILTER_CLOSED_HZ / FILTER_OPEN_HZ) * wheel);
+        filter->set(round(FX_ONE * 2.0 * sin(M_PI * hz / POLL_SAMPLE_RATE)), FILTER_RESONANT_DAMPING);
+      }
+      s = filter->process(s);
+    }
+    if (delay) s = delay->process(s);
+    w.write(fxClip(s));
+  }
+  bool ok = w.close();
+  printf("%s %s\n", ok ? "wrote" : "could not write", path.c_str());
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  std::string dir = (argc > 1) ? std::string(argv[1]) + "/" : "";
+  svFilter filter;
+  delayLine delay;
+  delay.begin(buffer, FX_DELAY_MAX_SAMPLES);
+  bool ok = render(dir + "effects-dry.wav", nullptr, nullptr);
+  ok &= render(dir + "effects-filter.wav", &filter, nullptr);
+  delay.setChorus(round(CHORUS_CENTRE_MS * POLL_SAMPLE_RATE / 1000.0), round(CHORUS_DEPTH_MS * POLL_SAMPLE_RATE / 1000.0),
+    round(CHORUS_RATE_HZ * 4294967296.0 / POLL_SAMPLE_RATE), CHORUS_WET);
+  ok &= render(dir + "effects-chorus.wav", nullptr, &delay);
+  delay.setEcho(round(ECHO_MS * POLL_SAMPLE_RATE / 1000.0), ECHO_FEEDBACK, ECHO_WET);
+  ok &= render(dir + "effects-echo.wav", nullptr, &delay);
+  delay.setEcho(round(LONG_ECHO_MS * POLL_SAMPLE_RATE / 1000.0), LONG_ECHO_FEEDBACK, LONG_ECHO_WET);
+  ok &= render(dir + "effects-long-echo.wav", nullptr, &delay);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+/*
+  src/fmVoice.h: time per sample of eight FM voices, the
+  synth's polyphony, mixed the way the synth interrupt
+  does it, for each preset with the mod wheel at rest and
+  all the way up, scaled to the board (see benchmark.h).
+  Run by hand:
+    build/fmBenchmark
+  Returns non-zero if anything won't fit the budget.
+*/
+#include <string>
+#include "benchmark.h"
+#include "fmVoice.h"
+#include "synthSettings.h"
+
+#define BENCH_SAMPLES 2000000
+#define VOICES 8                 // POLYPHONY_LIMIT
+
+struct benchVoice {
+  uint16_t counter;
+  uint16_t increment;
+  uint8_t eq;
+  fmVoice fm;
+};
+static benchVoice voice[VOICES];
+// the synth interrupt reads these from the other core
+static volatile uint16_t restIndex;
+static volatile uint8_t settle;
+static volatile uint16_t wheelIndex;
+
+static void play(const fmPreset& p) {
+  // a spread chord, from about 100 Hz to 1.6 kHz at the synth's sample rate
+  const uint16_t increment[VOICES] = { 157, 235, 314, 470, 628, 941, 1256, 2510 };
+  for (int i = 0; i < VOICES; i++) {
+    voice[i].counter = 0;
+    voice[i].increment = increment[i];
+    voice[i].eq = 4 + (i & 3);
+    voice[i].fm.tune(increment[i], p.ratio);
+    voice[i].fm.trigger(p.peakIndex);
+  }
+  restIndex = p.restIndex;
+  settle = p.settle;
+}
+
+static void sample() {
+  uint32_t mix = 0;
+  for (int i = 0; i < VOICES; i++) {
+    voice[i].counter += voice[i].increment;
+    uint16_t p = voice[i].fm.next(voice[i].counter, restIndex, settle, wheelIndex);
+    mix += p * voice[i].eq;
+  }
+  benchmarkSink = mix;
+}
+
+int main() {
+  bool fits = true;
+  for (const fmPreset& p : fmPresets) {
+    for (int wheel = 0; wheel < 2; wheel++) {
+      play(p);
+      wheelIndex = wheel ? FM_WHEEL_INDEX : 0;
+      std::string what = "8 voices, " + std::string(p.name) + (wheel ? ", wheel up" : "");
+      fits &= reportPerSample(what.c_str(), hostNanosPerCall(sample, BENCH_SAMPLES));
+    }
+  }
+  return fits ? 0 : 1;
+}
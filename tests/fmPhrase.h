@@ -0,0 +1,48 @@
+/*
+  The phrase (phrase.h) on FM voices, a sample at a time,
+  mixed and scaled as in the synth interrupt, at its
+  sample rate. fmRender writes it out to listen to, and
+  fmVoiceTest checks it against what it was.
+*/
+#pragma once
+#include <math.h>
+#include "phrase.h"
+#include "fmVoice.h"
+
+class fmPhrase {
+  public:
+    fmPhrase(const fmPreset& _preset) : preset(_preset) {
+      octave = (preset.ratio < FM_RATIO_ONE) ? 0.5 : 1.0;     // the bass an octave down
+      n = 0;
+      for (int v = 0; v < PHRASE_VOICES; v++) {
+        counter[v] = 0;
+        increment[v] = 0;
+      }
+    }
+    int32_t next(uint16_t wheelIndex) {
+      if (!(n % PHRASE_NOTE_SAMPLES)) {
+        const double* chord = phraseChordAt(n);
+        for (int v = 0; v < PHRASE_VOICES; v++) {
+          increment[v] = round(chord[v] * octave * 65536.0 / POLL_SAMPLE_RATE);
+          fm[v].tune(increment[v], preset.ratio);
+          fm[v].trigger(preset.peakIndex);
+        }
+      }
+      int32_t s = 0;
+      if (phraseSounding(n)) {
+        for (int v = 0; v < PHRASE_VOICES; v++) {
+          counter[v] += increment[v];
+          s += fm[v].next(counter[v], preset.restIndex, preset.settle, wheelIndex) - 32768;
+        }
+      }
+      n++;
+      return s / 4;
+    }
+  private:
+    const fmPreset& preset;
+    double octave;
+    uint32_t n;
+    fmVoice fm[PHRASE_VOICES];
+    uint16_t counter[PHRASE_VOICES];
+    uint16_t increment[PHRASE_VOICES];
+};
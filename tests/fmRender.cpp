@@ -0,0 +1,45 @@
+/*
+  src/fmVoice.h: renders a short phrase on each preset to
+  WAV files, to listen to. Run by hand:
+    build/fmRender [directory]
+  writes fm-e-piano.wav, fm-bell.wav, fm-brass.wav,
+  fm-bass.wav and fm-reed.wav, and fm-e-piano-wheel.wav
+  with the mod wheel swept up and back down across it.
+  Notes are mixed and scaled as in the synth interrupt,
+  at its sample rate (see fmPhrase.h).
+*/
+#include <math.h>
+#include <string>
+#include "benchmark.h"
+#include "wavWriter.h"
+#include "fmPhrase.h"
+#include "synthSettings.h"
+
+#define RENDER_SECONDS 6
+
+static bool render(const std::string& path, const fmPreset& p, bool sweep) {
+  wavWriter w;
+  if (!w.open(path.c_str(), POLL_SAMPLE_RATE)) return false;
+  fmPhrase phrase(p);
+  for (uint32_t n = 0; n < RENDER_SECONDS * POLL_SAMPLE_RATE; n++) {
+    uint16_t wheel = 0;
+    if (sweep) {
+      wheel = round(FM_WHEEL_INDEX * (0.5 - 0.5 * cos(2.0 * M_PI * n / (RENDER_SECONDS * POLL_SAMPLE_RATE))));
+    }
+    w.write(phrase.next(wheel));
+  }
+  bool ok = w.close();
+  printf("%s %s\n", ok ? "wrote" : "could not write", path.c_str());
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  std::string dir = (argc > 1) ? std::string(argv[1]) + "/" : "";
+  const char* files[FM_PRESET_COUNT] = { "fm-e-piano.wav", "fm-bell.wav", "fm-brass.wav", "fm-bass.wav", "fm-reed.wav" };
+  bool ok = true;
+  for (unsigned i = 0; i < FM_PRESET_COUNT; i++) {
+    ok &= render(dir + files[i], fmPresets[i], false);
+  }
+  ok &= render(dir + "fm-e-piano-wheel.wav", fmPresets[0], true);
+  return ok ? 0 : 1;
+}
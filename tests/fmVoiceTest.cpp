@@ -0,0 +1,82 @@
+/*
+  src/fmVoice.h: each preset in src/synthSettings.h plays
+  the first two chords of the phrase (fmPhrase.h, as
+  fmRender writes it out), and the samples must match a
+  checksum of what they were when the presets were last
+  listened to. If a change to the voice or a preset is
+  meant to change the sound, listen to fmRender's output
+  and update the checksums from this test's output. Then
+  the voice itself: with no index it is a plain sine of
+  the carrier, and the mix never leaves its range.
+*/
+#include <string.h>
+#include "hostTest.h"
+#include "fmPhrase.h"
+#include "synthSettings.h"
+
+#define TEST_SAMPLES (2 * PHRASE_NOTE_SAMPLES)
+
+struct renderExpected {
+  const char* name;
+  bool wheelUp;
+  uint32_t checksum;
+};
+static const renderExpected renders[] = {
+  { "E.Piano", false, 0x01A52BFD },
+  { "Bell",    false, 0xACB4D200 },
+  { "Brass",   false, 0xA7B6E461 },
+  { "Bass",    false, 0xF53CD991 },
+  { "Reed",    false, 0x22FD9D76 },
+  { "E.Piano", true,  0x6D35F041 },
+};
+
+static void testPresets() {
+  for (const renderExpected& r : renders) {
+    const fmPreset* p = nullptr;
+    for (const fmPreset& q : fmPresets) {
+      if (!strcmp(q.name, r.name)) p = &q;
+    }
+    CHECK(p != nullptr);
+    if (!p) continue;
+    fmPhrase phrase(*p);
+    uint32_t h = 2166136261u;    // FNV-1a over the samples
+    int32_t lo = 0;
+    int32_t hi = 0;
+    uint32_t silent = 0;
+    for (uint32_t n = 0; n < TEST_SAMPLES; n++) {
+      int32_t s = phrase.next(r.wheelUp ? FM_WHEEL_INDEX : 0);
+      if (s < lo) lo = s;
+      if (s > hi) hi = s;
+      if (!phraseSounding(n) && s) silent++;
+      int16_t sample = s;
+      h = (h ^ (uint8_t)sample) * 16777619u;
+      h = (h ^ (uint8_t)(sample >> 8)) * 16777619u;
+    }
+    if (h != r.checksum) {
+      printf("%s:%d: %s%s renders to 0x%08X, expected 0x%08X\n",
+        __FILE__, __LINE__, r.name, r.wheelUp ? " (wheel up)" : "", (unsigned)h, (unsigned)r.checksum);
+      testFailures++;
+    }
+    CHECK(lo >= -PHRASE_VOICES * 32768 / 4);
+    CHECK(hi <= PHRASE_VOICES * 32767 / 4);
+    CHECK(hi - lo > 32768);        // it plays, and loud enough to hear
+    CHECK_EQUAL(silent, 0);
+  }
+}
+
+static void testPlainSine() {
+  fmVoice v;
+  v.tune(1000, FM_RATIO_ONE);
+  v.trigger(0);
+  uint16_t phase = 0;
+  for (int n = 0; n < 1000; n++) {
+    phase += 1000;
+    CHECK_EQUAL(v.next(phase, 0, 8, 0), 32768 + fmSine.at[phase >> FM_SINE_SHIFT]);
+  }
+}
+
+int main() {
+  testPresets();
+  testPlainSine();
+  return TEST_RESULT();
+}
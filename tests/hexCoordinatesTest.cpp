@@ -0,0 +1,120 @@
+/*
+  src/hexCoordinates.h: with no turn or mirror, the steps
+  from every centre hex to every hex, for every across
+  and down-left step from -12 to 12, must match what
+  applyLayout() worked out from the doubled coordinates
+  before the tables. Then the transforms themselves: each
+  is one-to-one and keeps distances, turns add up, and a
+  turned or mirrored layout puts its across step where
+  the menu says it does.
+*/
+#include <stdlib.h>
+#include "hostTest.h"
+#include "hexCoordinates.h"
+
+#define STEP_RANGE 12
+
+// applyLayout() before the tables, word for word apart from the names
+static int16_t oldStepsFrom(uint8_t centre, uint8_t i, int8_t acrossSteps, int8_t dnLeftSteps) {
+  int8_t distCol = hexCol(i) - hexCol(centre);
+  int8_t distRow = hexRow(i) - hexRow(centre);
+  return (
+    (distCol * acrossSteps) +
+    (distRow * (
+      acrossSteps +
+      (2 * dnLeftSteps)
+    ))
+  ) / 2;
+}
+
+static void testMatchesOldLayout() {
+  uint32_t mismatches = 0;
+  for (int centre = 0; centre < HEX_GRID_HEXES; centre++) {
+    for (int i = 0; i < HEX_GRID_HEXES; i++) {
+      for (int across = -STEP_RANGE; across <= STEP_RANGE; across++) {
+        for (int dnLeft = -STEP_RANGE; dnLeft <= STEP_RANGE; dnLeft++) {
+          int16_t got = hexStepsFrom(centre, i, 0, across, dnLeft);
+          int16_t expected = oldStepsFrom(centre, i, across, dnLeft);
+          if (got != expected) {
+            if (!mismatches) {
+              printf("%s:%d: centre %d, hex %d, across %d, down-left %d: %d steps, expected %d\n",
+                __FILE__, __LINE__, centre, i, across, dnLeft, got, expected);
+            }
+            mismatches++;
+          }
+        }
+      }
+    }
+  }
+  CHECK_EQUAL(mismatches, 0);
+}
+
+static int hexDistance(hexAxial a, hexAxial b) {
+  int dq = a.q - b.q;
+  int dr = a.r - b.r;
+  return (abs(dq) + abs(dr) + abs(dq + dr)) / 2;
+}
+
+static void testTransforms() {
+  for (uint8_t t = 0; t < HEX_TRANSFORMS; t++) {
+    for (int i = 0; i < HEX_GRID_HEXES; i++) {
+      const hexAxial& a = hexTransformed.at[t][i];
+      for (int j = 0; j < i; j++) {
+        const hexAxial& b = hexTransformed.at[t][j];
+        CHECK((a.q != b.q) || (a.r != b.r));
+        CHECK_EQUAL(hexDistance(a, b), hexDistance(hexTransformed.at[0][i], hexTransformed.at[0][j]));
+      }
+    }
+  }
+  for (int i = 0; i < HEX_GRID_HEXES; i++) {
+    hexAxial a = hexTransformed.at[0][i];
+    for (uint8_t t = 0; t < HEX_TURNS; t++) {
+      hexAxial back = hexTransform(hexTransformed.at[t][i], (HEX_TURNS - t) % HEX_TURNS);
+      CHECK((back.q == a.q) && (back.r == a.r));
+    }
+    hexAxial twice = hexTransform(hexTransformed.at[HEX_MIRRORED][i], HEX_MIRRORED);
+    CHECK((twice.q == a.q) && (twice.r == a.r));
+  }
+  CHECK_EQUAL(hexLayoutTransform(0, false), 0);
+  CHECK_EQUAL(hexLayoutTransform(1, false), 5);
+  CHECK_EQUAL(hexLayoutTransform(6, false), 0);
+  CHECK_EQUAL(hexLayoutTransform(2, true), HEX_MIRRORED + 2);
+}
+
+// the hex one step from the centre in a HEX_DIRECTION_
+static uint8_t neighbor(uint8_t centre, uint8_t direction) {
+  int row = hexRow(centre) + vertical[direction];
+  int col = hexCol(centre) + horizontal[direction];
+  return (row * HEX_GRID_COLS) + ((col - (row & 1)) / 2);
+}
+
+/*
+  The across step goes east. Turned clockwise, it goes
+  south-east, then south-west, and so on; mirrored, it
+  goes west, and turns clockwise from there.
+*/
+static void testLayoutDirections() {
+  const uint8_t centre = 65;        // well inside the grid
+  const int8_t across = 7;
+  const int8_t dnLeft = -3;
+  for (uint8_t turns = 0; turns < HEX_TURNS; turns++) {
+    uint8_t t = hexLayoutTransform(turns, false);
+    uint8_t d = (HEX_DIRECTION_EAST + HEX_TURNS - turns) % HEX_TURNS;
+    CHECK_EQUAL(hexStepsFrom(centre, neighbor(centre, d), t, across, dnLeft), across);
+    d = (HEX_DIRECTION_SW + HEX_TURNS - turns) % HEX_TURNS;
+    CHECK_EQUAL(hexStepsFrom(centre, neighbor(centre, d), t, across, dnLeft), dnLeft);
+    t = hexLayoutTransform(turns, true);
+    d = (HEX_DIRECTION_WEST + HEX_TURNS - turns) % HEX_TURNS;
+    CHECK_EQUAL(hexStepsFrom(centre, neighbor(centre, d), t, across, dnLeft), across);
+    d = (HEX_DIRECTION_SE + HEX_TURNS - turns) % HEX_TURNS;
+    CHECK_EQUAL(hexStepsFrom(centre, neighbor(centre, d), t, across, dnLeft), dnLeft);
+    CHECK_EQUAL(hexStepsFrom(centre, centre, t, across, dnLeft), 0);
+  }
+}
+
+int main() {
+  testMatchesOldLayout();
+  testTransforms();
+  testLayoutDirections();
+  return TEST_RESULT();
+}
@@ -0,0 +1,28 @@
+/*
+  Just enough of a test framework for the host tests:
+  CHECK() reports the file and line of anything that
+  fails and counts it, and the test returns the count
+  from main() via TEST_RESULT().
+*/
+#pragma once
+#include <stdio.h>
+
+static int testFailures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+      printf("%s:%d: failed: %s\n", __FILE__, __LINE__, #condition); \
+      testFailures++; \
+    } \
+  } while (0)
+
+#define CHECK_EQUAL(actual, expected) do { \
+    long long a_ = (long long)(actual); \
+    long long e_ = (long long)(expected); \
+    if (a_ != e_) { \
+      printf("%s:%d: failed: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, a_, e_); \
+      testFailures++; \
+    } \
+  } while (0)
+
+#define TEST_RESULT() (printf("%s\n", testFailures ? "FAILED" : "passed"), testFailures)
@@ -0,0 +1,311 @@
+/*
+  src/looper.h: recording and quantizing, and a timing
+  simulation of playback against a virtual clock. The
+  alarm interrupt fires in the middle of whatever task
+  is running and only queues what is due; a looper task
+  plays the queue, as in the sketch, alongside tasks
+  that take as long as the real key scan, menu redraw
+  and LED refresh. Every event must play once per pass,
+  in order, and less than a millisecond late.
+*/
+#include <vector>
+#include "hostTest.h"
+#include "looper.h"
+#include "taskScheduler.h"
+
+struct memoryStore {
+  std::vector<loopEvent> events;
+  bool writeChunk(uint32_t chunk, const loopEvent* e, uint8_t count) {
+    size_t at = chunk * LOOPER_CHUNK_EVENTS;
+    if (events.size() < at + count) events.resize(at + count);
+    for (uint8_t i = 0; i < count; i++) events[at + i] = e[i];
+    return true;
+  }
+  bool readChunk(uint32_t chunk, loopEvent* e, uint8_t count) {
+    size_t at = chunk * LOOPER_CHUNK_EVENTS;
+    if (events.size() < at + count) return false;
+    for (uint8_t i = 0; i < count; i++) e[i] = events[at + i];
+    return true;
+  }
+};
+
+static void testRecord() {
+  looper l;
+  memoryStore store;
+  l.arm(0);
+  CHECK(!l.record(1000, 5, 0, 0));              // a release before anything was pressed
+  CHECK(l.record(1000, 5, 0, 100));              // recording starts here
+  CHECK(l.record(1500, 6, 2, 90));
+  CHECK(l.record(1700, 5, 0, 0));
+  CHECK(!l.record(1800, 7, 4, 0));               // pressed before recording began
+  CHECK(l.finish(3000, store));
+  CHECK_EQUAL(l.state, LOOPER_STOPPED);
+  CHECK_EQUAL(l.length, 2000);
+  CHECK_EQUAL(l.eventCount, 3);
+  CHECK(!l.streamed);
+  l.start(10000);
+  loopEvent e;
+  uint64_t due;
+  CHECK_EQUAL(l.peek(e, due), LOOPER_STEP_NOTE);
+  CHECK_EQUAL(due, 10000);
+  CHECK_EQUAL(e.hex, 5);
+  l.advance();
+  CHECK_EQUAL(l.peek(e, due), LOOPER_STEP_NOTE);
+  CHECK_EQUAL(due, 10500);
+  l.advance();
+  l.advance();
+  CHECK_EQUAL(l.peek(e, due), LOOPER_STEP_CYCLE_END);
+  CHECK_EQUAL(due, 12000);
+  l.advance();
+  CHECK_EQUAL(l.peek(e, due), LOOPER_STEP_NOTE);
+  CHECK_EQUAL(due, 12000);
+  l.stop();
+  CHECK_EQUAL(l.peek(e, due), LOOPER_STEP_NONE);
+}
+
+static void testQuantize() {
+  looper l;
+  memoryStore store;
+  l.arm(1000);
+  CHECK(l.record(0, 1, 0, 100));
+  CHECK(l.record(1400, 2, 1, 100));              // to 1000
+  CHECK(l.record(1700, 2, 1, 0));                // moves with its press, to 1300
+  CHECK(l.record(1600, 3, 2, 100));              // to 2000
+  CHECK(l.record(2300, 4, 3, 100));              // to 2000, and slid back before it in time order
+  CHECK(l.finish(3600, store));
+  CHECK_EQUAL(l.length, 4000);
+  l.start(0);
+  loopEvent e;
+  uint64_t due;
+  uint64_t expected[] = { 0, 1000, 1300, 2000, 2000 };
+  for (int i = 0; i < 5; i++) {
+    CHECK_EQUAL(l.peek(e, due), LOOPER_STEP_NOTE);
+    CHECK_EQUAL(due, expected[i]);
+    l.advance();
+  }
+  CHECK_EQUAL(l.peek(e, due), LOOPER_STEP_CYCLE_END);
+  CHECK_EQUAL(due, 4000);
+}
+
+static void testQueue() {
+  loopDueQueue q;
+  loopEvent e = {};
+  loopDue d = {};
+  CHECK(!q.pop(d, 0));
+  for (int i = 0; i < LOOPER_QUEUE_SIZE; i++) {
+    e.hex = i;
+    CHECK(q.push(LOOPER_STEP_NOTE, e, 100 + i));
+  }
+  CHECK(q.full());
+  CHECK(!q.push(LOOPER_STEP_NOTE, e, 0));
+  CHECK_EQUAL(q.overflows, 1);
+  CHECK(q.pop(d, 150));
+  CHECK_EQUAL(d.e.hex, 0);
+  CHECK_EQUAL(q.worstLate, 50);
+  q.clear();
+  CHECK(!q.pop(d, 0));
+}
+
+// the simulation
+struct virtualClock {
+  uint64_t t;
+  uint64_t now() {
+    return t;
+  }
+};
+
+#define SIM_MIN_LEAD 10         // ARP_MIN_LEAD_TIME
+#define SIM_PLAY_COST 40        // microseconds to send a note over MIDI and start the synth
+
+static virtualClock clk;
+static looper take;
+static memoryStore store;
+static loopDueQueue dueQueue;
+static taskScheduler tasks;
+static uint8_t looperTask;
+static bool alarmArmed;
+static uint64_t alarmAt;
+static bool looperWaiting;
+static uint64_t lastDue;
+static uint32_t played;
+static uint32_t cycles;
+static uint32_t worstLate;
+static bool inOrder;
+
+static void armAlarm(uint64_t due) {
+  uint64_t earliest = clk.t + SIM_MIN_LEAD;
+  alarmAt = (due > earliest) ? due : earliest;
+  alarmArmed = true;
+}
+static void looperInterrupt() {
+  alarmArmed = false;
+  uint64_t due;
+  uint8_t step = take.queueDue(clk.t, dueQueue, due);
+  if (step == LOOPER_STEP_WAIT) {
+    looperWaiting = true;
+  } else if (step == LOOPER_STEP_NOTE) {
+    armAlarm(due);
+  }
+}
+// time passes, and the alarm goes off when it's due, whatever is running
+static void spend(uint64_t us) {
+  uint64_t until = clk.t + us;
+  while (alarmArmed && (alarmAt <= until)) {
+    if (alarmAt > clk.t) clk.t = alarmAt;
+    looperInterrupt();
+  }
+  clk.t = until;
+}
+static void scheduleLooperTask() {
+  loopEvent e;
+  uint64_t due;
+  uint8_t step = take.peek(e, due);
+  if ((step == LOOPER_STEP_NOTE) || (step == LOOPER_STEP_CYCLE_END)) {
+    tasks.setDeadline(looperTask, due);
+  }
+}
+static void taskLooper() {
+  loopDue d;
+  while (dueQueue.pop(d, clk.t)) {
+    uint64_t late = clk.t - d.due;
+    if (late > worstLate) worstLate = late;
+    if (d.due < lastDue) inOrder = false;
+    lastDue = d.due;
+    if (d.step == LOOPER_STEP_CYCLE_END) {
+      cycles++;
+    } else {
+      played++;
+      spend(SIM_PLAY_COST);
+    }
+  }
+  if (take.state != LOOPER_PLAYING) return;
+  if (looperWaiting && !take.waitingForFile()) {
+    looperWaiting = false;
+    armAlarm(0);
+  }
+  scheduleLooperTask();
+}
+static void taskScan() {
+  spend(1200);
+  if (!take.load(store)) inOrder = false;
+  if (looperWaiting && !dueQueue.full()) {
+    looperWaiting = false;
+    armAlarm(0);
+    scheduleLooperTask();
+  }
+}
+static void taskMIDIin()  { spend(150); }
+static void taskWheels()  { spend(100); }
+static void taskMenu() {
+  static uint8_t n = 0;
+  spend((++n % 10) ? 100 : 2800);         // a full redraw every tenth time
+}
+static void taskAnimate() { spend(900); }
+static void taskLEDs()    { spend(4500); }
+
+static void setupSimulation() {
+  clk.t = 1000000;
+  tasks = taskScheduler();
+  dueQueue = loopDueQueue();
+  looperTask = tasks.add("looper", taskLooper, 1000000, 7, 300, clk.t);
+  tasks.add("scan",    taskScan,    4000,  6, 2500, clk.t);
+  tasks.add("midi in", taskMIDIin,  2000,  5, 300,  clk.t);
+  tasks.add("wheels",  taskWheels,  4000,  4, 300,  clk.t);
+  tasks.add("menu",    taskMenu,    10000, 3, 3000, clk.t);
+  tasks.add("animate", taskAnimate, 16384, 2, 1000, clk.t);
+  tasks.add("leds",    taskLEDs,    16667, 2, 5000, clk.t);
+  alarmArmed = false;
+  looperWaiting = false;
+  lastDue = 0;
+  played = 0;
+  cycles = 0;
+  worstLate = 0;
+  inOrder = true;
+}
+static void startPlaying() {
+  take.start(clk.t + SIM_MIN_LEAD);
+  CHECK(take.load(store));
+  armAlarm(0);
+  scheduleLooperTask();
+}
+static void runFor(uint64_t us) {
+  uint64_t end = clk.t + us;
+  while (clk.t < end) {
+    if (tasks.runNext(clk) == TASK_NONE) {
+      uint64_t next = tasks.nextDeadline();
+      spend((next > clk.t) ? (next - clk.t) : 1);
+    } else {
+      spend(2);          // each pass of the loop takes a little time
+    }
+  }
+}
+
+// passes of a take played through, stopping just short of the end of the last one
+static void expectPlayed(uint32_t passes, uint32_t maxLate, int line) {
+  uint32_t expected = passes * take.eventCount;
+  if ((cycles + 1 != passes) || (played != expected) || !inOrder || (worstLate > maxLate)) {
+    printf("%s:%d: %u passes ended, %u events (expected %u, %u), %s, worst %u us late\n",
+      __FILE__, line, (unsigned)cycles, (unsigned)played, (unsigned)passes - 1, (unsigned)expected,
+      inOrder ? "in order" : "out of order", (unsigned)worstLate);
+    testFailures++;
+  }
+}
+
+// an arpeggio with chords, quantized to sixteenths at 120 BPM
+static void testTimingUnderLoad() {
+  take.arm(125000);
+  uint64_t t = 0;
+  for (int n = 0; n < 32; n++) {
+    int voices = (n % 4) ? 1 : 3;
+    for (int v = 0; v < voices; v++) CHECK(take.record(t + 3000 * v, 10 + v, n + v, 100));
+    for (int v = 0; v < voices; v++) CHECK(take.record(t + 90000 + 700 * v, 10 + v, n + v, 0));
+    t += 125000 + ((n * 7919) % 9000);      // not quite in time, before quantizing
+  }
+  CHECK(take.finish(t, store));
+  setupSimulation();
+  startPlaying();
+  runFor(4 * take.length - 1000);
+  expectPlayed(4, 1000, __LINE__);
+  CHECK_EQUAL(dueQueue.overflows, 0);
+}
+
+// more notes at once than the queue holds: the rest follow as soon as it's drained
+static void testBurst() {
+  take.arm(0);
+  for (int v = 0; v < 2 * LOOPER_QUEUE_SIZE; v++) CHECK(take.record(0, v, v, 100));
+  for (int v = 0; v < 2 * LOOPER_QUEUE_SIZE; v++) CHECK(take.record(400000, v, v, 0));
+  CHECK(take.finish(500000, store));
+  setupSimulation();
+  startPlaying();
+  runFor(2 * take.length - 1000);
+  expectPlayed(2, 4 * LOOPER_QUEUE_SIZE * SIM_PLAY_COST, __LINE__);
+  CHECK(dueQueue.overflows > 0);
+}
+
+// a take too long for RAM, read back from the store a chunk at a time
+static void testStreamed() {
+  take.arm(0);
+  uint64_t t = 0;
+  for (int n = 0; n < 600; n++) {
+    CHECK(take.record(t, n % 100, n, 100));
+    CHECK(take.record(t + 10000, n % 100, n, 0));
+    CHECK(take.save(store));
+    t += 20000;
+  }
+  CHECK(take.finish(t, store));
+  CHECK(take.streamed);
+  setupSimulation();
+  startPlaying();
+  runFor(2 * take.length - 1000);
+  expectPlayed(2, 1000, __LINE__);
+}
+
+int main() {
+  testRecord();
+  testQuantize();
+  testQueue();
+  testTimingUnderLoad();
+  testBurst();
+  testStreamed();
+  return TEST_RESULT();
+}
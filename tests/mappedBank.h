@@ -0,0 +1,135 @@
+/*
+  For the sampler's host tests: a memory-mapped temporary
+  file standing in for the flash the bank is built in
+  (erased to 0xFF, and programmed a page at a time, which
+  can only clear bits, like the real thing), and WAV files
+  built in memory, with the read/seek/size the bank
+  builder wants.
+*/
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "sampler.h"
+
+class mappedFlash {
+  public:
+    mappedFlash(uint32_t _size) {
+      size = _size;
+      map = nullptr;
+      f = tmpfile();
+      if (!f || ftruncate(fileno(f), size)) return;
+      void* m = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fileno(f), 0);
+      if (m != MAP_FAILED) map = (uint8_t*)m;
+    }
+    ~mappedFlash() {
+      if (map) munmap(map, size);
+      if (f) fclose(f);
+    }
+    bool erase(uint32_t offset, uint32_t bytes) {
+      if (!map || (offset % SAMPLER_SECTOR) || ((uint64_t)offset + bytes > size)) return false;
+      memset(map + offset, 0xFF, bytes);
+      return true;
+    }
+    bool program(uint32_t offset, const uint8_t* data, uint32_t bytes) {
+      if (!map || (offset % SAMPLER_PAGE) || (bytes != SAMPLER_PAGE) || ((uint64_t)offset + bytes > size)) return false;
+      for (uint32_t i = 0; i < bytes; i++) map[offset + i] &= data[i];
+      return true;
+    }
+    uint8_t* map;
+    uint32_t size;
+  private:
+    FILE* f;
+};
+
+class memoryWav {
+  public:
+    memoryWav() {
+      at = 0;
+    }
+    uint32_t read(uint8_t* buffer, uint32_t bytes) {
+      if (at >= d.size()) return 0;
+      if (bytes > d.size() - at) bytes = d.size() - at;
+      memcpy(buffer, d.data() + at, bytes);
+      at += bytes;
+      return bytes;
+    }
+    bool seek(uint32_t position) {
+      at = position;
+      return position <= d.size();
+    }
+    uint32_t size() {
+      return d.size();
+    }
+    void tag(const char* id) {
+      for (int i = 0; i < 4; i++) d.push_back(id[i]);
+    }
+    void u16(uint16_t v) {
+      d.push_back(v & 0xFF);
+      d.push_back(v >> 8);
+    }
+    void u32(uint32_t v) {
+      u16(v & 0xFFFF);
+      u16(v >> 16);
+    }
+    // a sine wave at a MIDI note, the same on every channel, with a loop of whole cycles if asked
+    static memoryWav sine(uint8_t note, uint32_t rate, uint32_t frames, uint16_t channels, uint16_t bits, bool loop) {
+      memoryWav w;
+      uint16_t frameBytes = channels * (bits / 8);
+      w.tag("RIFF");
+      w.u32(0);
+      w.tag("WAVE");
+      w.tag("fmt ");
+      w.u32(16);
+      w.u16(1);
+      w.u16(channels);
+      w.u32(rate);
+      w.u32(rate * frameBytes);
+      w.u16(frameBytes);
+      w.u16(bits);
+      w.tag("data");
+      w.u32(frames * frameBytes);
+      double hz = 440.0 * exp2((note - 69) / 12.0);
+      for (uint32_t i = 0; i < frames; i++) {
+        int32_t s = (int32_t)round(20000.0 * sin(2.0 * M_PI * hz * i / rate));
+        for (uint16_t c = 0; c < channels; c++) {
+          switch (bits) {
+            case 8:  w.d.push_back((uint8_t)((s >> 8) + 128));          break;
+            case 16: w.u16((uint16_t)s);                                break;
+            default: w.d.push_back(0); w.u16((uint16_t)s);              break;
+          }
+        }
+      }
+      if ((frames * frameBytes) & 1) w.d.push_back(0);     // chunks are padded to even lengths
+      if (loop) {
+        uint32_t loopLength = (uint32_t)round(rate / hz * 20);   // about 20 cycles
+        w.tag("smpl");
+        w.u32(60);
+        for (int i = 0; i < 3; i++) w.u32(0);
+        w.u32(note);           // unity note
+        w.u32(0);              // pitch fraction
+        w.u32(0);
+        w.u32(0);
+        w.u32(1);              // loops
+        w.u32(0);
+        w.u32(0);              // loop id
+        w.u32(0);              // forward
+        w.u32(frames / 4);     // start
+        w.u32(frames / 4 + loopLength - 1);    // end, inclusive
+        w.u32(0);
+        w.u32(0);
+      }
+      w.set32(4, w.d.size() - 8);
+      return w;
+    }
+    void set32(uint32_t offset, uint32_t v) {
+      for (int i = 0; i < 4; i++) d[offset + i] = (v >> (8 * i)) & 0xFF;
+    }
+    std::vector<uint8_t> d;
+  private:
+    uint32_t at;
+};
@@ -0,0 +1,298 @@
+/*
+  src/microtonal.h: the tuning, layout, scale and palette
+  tables, now kept in flash, against what the sketch had
+  before they were. The expected values were dumped from
+  the old tables: names, cycle lengths and step sizes,
+  every layout, which degrees of its tuning each scale
+  takes in (x) or leaves out (.), and, as checksums, each
+  tuning's key names and each palette's colour for every
+  step. Two patterns fall short of a whole cycle (41 EDO
+  "7-limit chromatic" and 72 EDO "Marvolo"); the old loop
+  read on past their end, and the degrees past it are now
+  left out of the scale.
+*/
+#include <math.h>
+#include <string.h>
+#include <string>
+#include "hostTest.h"
+
+int positiveMod(int n, int d) {      // as in src/helpers.h
+  return (((n % d) + d) % d);
+}
+#include "microtonal.h"
+
+struct tuningExpected {
+  const char* name;
+  uint8_t cycleLength;
+  float stepSize;
+  uint32_t keys;         // checksum of the key names and their steps from A
+};
+static const tuningExpected tunings[] = {
+  { "12 EDO",        12, 100.0000f, 0xA66270EB },
+  { "17 EDO",        17,  70.5882f, 0x5025A4D3 },
+  { "19 EDO",        19,  63.1579f, 0x3590A342 },
+  { "22 EDO",        22,  54.5455f, 0x7430435A },
+  { "24 EDO",        24,  50.0000f, 0xB2B6DD89 },
+  { "31 EDO",        31,  38.7097f, 0xE1114109 },
+  { "41 EDO",        41,  29.2683f, 0x9D8BCCC1 },
+  { "53 EDO",        53,  22.6415f, 0x2C17B231 },
+  { "72 EDO",        72,  16.6667f, 0x8484098F },
+  { "Bohlen-Pierce", 13, 146.3040f, 0xE64C0E42 },
+  { "Carlos Alpha",   9,  77.9650f, 0xF8CA56CA },
+  { "Carlos Beta",   11,  63.8329f, 0xF786573E },
+  { "Carlos Gamma",  20,  35.0985f, 0x302CDEE5 },
+};
+
+static const layoutDef layouts[] = {
+  { "Wicki-Hayden",     1, 64,   2,  -7, TUNING_12EDO },
+  { "Harmonic Table",   0, 75,  -7,   3, TUNING_12EDO },
+  { "Janko",            0, 65,  -1,  -1, TUNING_12EDO },
+  { "Gerhard",          0, 65,  -1,  -3, TUNING_12EDO },
+  { "Accordion C-sys.", 1, 75,   2,  -3, TUNING_12EDO },
+  { "Accordion B-sys.", 1, 64,   1,  -3, TUNING_12EDO },
+  { "Full Gamut",       1, 65,   1,  -9, TUNING_17EDO },
+  { "Bosanquet-Wilson", 0, 65,  -2,  -1, TUNING_17EDO },
+  { "Neutral Thirds A", 0, 65,  -1,  -2, TUNING_17EDO },
+  { "Neutral Thirds B", 0, 65,   1,  -3, TUNING_17EDO },
+  { "Full Gamut",       1, 65,   1,  -9, TUNING_19EDO },
+  { "Bosanquet-Wilson", 0, 65,  -1,  -2, TUNING_19EDO },
+  { "Kleismic",         0, 65,  -1,  -4, TUNING_19EDO },
+  { "Full Gamut",       1, 65,   1,  -8, TUNING_22EDO },
+  { "Bosanquet-Wilson", 0, 65,  -3,  -1, TUNING_22EDO },
+  { "Porcupine",        0, 65,   1,  -4, TUNING_22EDO },
+  { "Full Gamut",       1, 65,   1,  -9, TUNING_24EDO },
+  { "Bosanquet-Wilson", 0, 65,  -1,  -3, TUNING_24EDO },
+  { "Inverted",         0, 65,   1,  -4, TUNING_24EDO },
+  { "Full Gamut",       1, 65,   1,  -7, TUNING_31EDO },
+  { "Bosanquet-Wilson", 0, 65,  -2,  -3, TUNING_31EDO },
+  { "Double Bosanquet", 0, 65,  -1,  -4, TUNING_31EDO },
+  { "Anti-Double Bos.", 0, 65,   1,  -5, TUNING_31EDO },
+  { "Full Gamut",       0, 65,   1,  -8, TUNING_41EDO },
+  { "Bosanquet-Wilson", 0, 65,  -4,  -3, TUNING_41EDO },
+  { "Gerhard",          0, 65,   3, -10, TUNING_41EDO },
+  { "Baldy",            0, 65,  -1,  -6, TUNING_41EDO },
+  { "Rodan",            1, 65,  -1,  -7, TUNING_41EDO },
+  { "Wicki-Hayden",     1, 64,   9, -31, TUNING_53EDO },
+  { "Bosanquet-Wilson", 0, 65,  -5,  -4, TUNING_53EDO },
+  { "Kleismic A",       0, 65,  -8,  -3, TUNING_53EDO },
+  { "Kleismic B",       0, 65,  -5,  -3, TUNING_53EDO },
+  { "Harmonic Table",   0, 75, -31,  14, TUNING_53EDO },
+  { "Buzzard",          0, 65,  -9,  -1, TUNING_53EDO },
+  { "Full Gamut",       1, 65,   1,  -9, TUNING_72EDO },
+  { "Expanded Janko",   0, 65,  -1,  -6, TUNING_72EDO },
+  { "Full Gamut",       1, 65,   1,  -9, TUNING_BP },
+  { "Standard",         0, 65,  -2,  -1, TUNING_BP },
+  { "Full Gamut",       1, 65,   1,  -9, TUNING_ALPHA },
+  { "Compressed",       0, 65,  -2,  -1, TUNING_ALPHA },
+  { "Full Gamut",       1, 65,   1,  -9, TUNING_BETA },
+  { "Compressed",       0, 65,  -2,  -1, TUNING_BETA },
+  { "Full Gamut",       1, 65,   1,  -9, TUNING_GAMMA },
+  { "Compressed",       0, 65,  -2,  -1, TUNING_GAMMA },
+};
+
+struct scaleExpected {
+  const char* name;
+  uint8_t tuning;
+  uint8_t stepCount;
+  const char* degrees;
+};
+static const scaleExpected scales[] = {
+  { "None",              ALL_TUNINGS,   0, "" },
+  { "Major",             TUNING_12EDO,  7, "x.x.xx.x.x.x" },
+  { "Minor, natural",    TUNING_12EDO,  7, "x.xx.x.xx.x." },
+  { "Minor, melodic",    TUNING_12EDO,  7, "x.xx.x.x.x.x" },
+  { "Minor, harmonic",   TUNING_12EDO,  7, "x.xx.x.xx..x" },
+  { "Pentatonic, major", TUNING_12EDO,  5, "x.x.x..x.x.." },
+  { "Pentatonic, minor", TUNING_12EDO,  5, "x..x.x.x..x." },
+  { "Blues",             TUNING_12EDO,  7, "x..xxxxx..x." },
+  { "Double Harmonic",   TUNING_12EDO,  7, "xx..xx.xx..x" },
+  { "Phrygian",          TUNING_12EDO,  7, "xx.x.x.xx.x." },
+  { "Phrygian Dominant", TUNING_12EDO,  7, "xx..xx.xx.x." },
+  { "Dorian",            TUNING_12EDO,  7, "x.xx.x.x.xx." },
+  { "Lydian",            TUNING_12EDO,  7, "x.x.x.xx.x.x" },
+  { "Lydian Dominant",   TUNING_12EDO,  7, "x.x.x.xx.xx." },
+  { "Mixolydian",        TUNING_12EDO,  7, "x.x.xx.x.xx." },
+  { "Locrian",           TUNING_12EDO,  7, "xx.x.xx.x.x." },
+  { "Whole tone",        TUNING_12EDO,  6, "x.x.x.x.x.x." },
+  { "Octatonic",         TUNING_12EDO,  8, "x.xx.xx.xx.x" },
+  { "Diatonic",          TUNING_17EDO,  7, "x..x..xx..x..x..x" },
+  { "Pentatonic",        TUNING_17EDO,  5, "x..x..x...x..x..." },
+  { "Harmonic",          TUNING_17EDO,  7, "x..x.x..x.x.x.x.." },
+  { "Husayni maqam",     TUNING_17EDO,  8, "x.x.x..x..x.xxx.." },
+  { "Blues",             TUNING_17EDO,  7, "x...x..xxxx...x.." },
+  { "Hydra",             TUNING_17EDO,  9, "x..x..xxx.x..x.xx" },
+  { "Diatonic",          TUNING_19EDO,  7, "x..x..x.x..x..x..x." },
+  { "Pentatonic",        TUNING_19EDO,  5, "x..x..x....x..x...." },
+  { "Semaphore",         TUNING_19EDO,  9, "x..xx..xx..x..xx..x" },
+  { "Negri",             TUNING_19EDO, 10, "x.x.x.x.x.xx.x.x.x." },
+  { "Sensi",             TUNING_19EDO, 11, "x.x.xx.x.x.xx.x.x.x" },
+  { "Kleismic",          TUNING_19EDO, 11, "xx..xxx..xxx..xx..x" },
+  { "Magic",             TUNING_19EDO, 13, "x..xxxx..xxxx..xxxx" },
+  { "Kind of blues",     TUNING_19EDO,  6, "x...x...xx.x...x..." },
+  { "Diatonic",          TUNING_22EDO,  7, "x...x...xx...x...x...x" },
+  { "Pentatonic",        TUNING_22EDO,  5, "x...x...x....x...x...." },
+  { "Orwell",            TUNING_22EDO,  9, "x..x.x..x.x..x.x..x.x." },
+  { "Porcupine",         TUNING_22EDO,  7, "x...x..x..x..x..x..x.." },
+  { "Pajara",            TUNING_22EDO, 10, "x.x.x..x.x.x.x..x.x.x." },
+  { "Diatonic 12",       TUNING_24EDO,  7, "x...x...x.x...x...x...x." },
+  { "Diatonic Soft",     TUNING_24EDO,  7, "x..x....x.x..x....x...x." },
+  { "Diatonic Neutral",  TUNING_24EDO,  7, "x...x..x..x...x..x...x.." },
+  { "Pentatonic (12)",   TUNING_24EDO,  5, "x...x...x.....x...x....." },
+  { "Pentatonic (Haba)", TUNING_24EDO,  5, "x....x....x....x....x..." },
+  { "Invert Pentatonic", TUNING_24EDO,  5, "x.....x..x.....x.....x.." },
+  { "Rast maqam",        TUNING_24EDO,  8, "x...x..x..x...x...x.xx.." },
+  { "Bayati maqam",      TUNING_24EDO,  8, "x..x..x...x...x.xx..x..." },
+  { "Hijaz maqam",       TUNING_24EDO,  8, "x.x.....x.x...x.xx..x..." },
+  { "8-EDO",             TUNING_24EDO,  8, "x..x..x..x..x..x..x..x.." },
+  { "Wyschnegradsky",    TUNING_24EDO, 13, "x.x.x.x.x.xx.x.x.x.x.x.x" },
+  { "Diatonic",          TUNING_31EDO,  7, "x....x....x..x....x....x....x.." },
+  { "Pentatonic",        TUNING_31EDO,  5, "x....x....x.......x....x......." },
+  { "Harmonic",          TUNING_31EDO,  8, "x....x....x...x...x...x..x..x.." },
+  { "Mavila",            TUNING_31EDO,  9, "x....x..x..x..x....x..x..x..x.." },
+  { "Quartal",           TUNING_31EDO,  8, "x.x.x......x.x.x......x.x......" },
+  { "Orwell",            TUNING_31EDO,  9, "x...x..x...x..x...x..x...x..x.." },
+  { "Neutral",           TUNING_31EDO,  8, "x...x...x...x...x...x...x...x.." },
+  { "Miracle",           TUNING_31EDO, 10, "x...x..x..x..x..x..x..x..x..x.." },
+  { "Diatonic",          TUNING_41EDO,  7, "x......x......x..x......x......x......x.." },
+  { "Pentatonic",        TUNING_41EDO,  5, "x......x......x.........x......x........." },
+  { "Pure major",        TUNING_41EDO,  7, "x......x.....x...x......x.....x......x..." },
+  { "5-limit chromatic", TUNING_41EDO, 12, "x...x..x...x.x...x..x...x...x.x...x..x..." },
+  { "7-limit chromatic", TUNING_41EDO, 12, "x..x...x.x...x...x..x...x.x...x..x..x...x" },
+  { "Harmonic",          TUNING_41EDO, 12, "x....x...x...x...x...x..x..x..x..x..x.x.." },
+  { "Middle East-ish",   TUNING_41EDO,  7, "x......x....x......x....x....x......x...." },
+  { "Thai",              TUNING_41EDO,  7, "x.....x.....x.....x.....x.....x.....x...." },
+  { "Slendro",           TUNING_41EDO,  5, "x.......x.......x.......x.......x........" },
+  { "Pelog / Mavila",    TUNING_41EDO,  7, "x.......x....x....x.......x....x....x...." },
+  { "Diatonic",          TUNING_53EDO,  7, "x........x........x...x........x........x........x..." },
+  { "Pentatonic",        TUNING_53EDO,  5, "x........x........x............x........x............" },
+  { "Rast makam",        TUNING_53EDO,  8, "x........x.......x....x........x........x...x...x...." },
+  { "Usshak makam",      TUNING_53EDO,  8, "x......x.....x........x........x...x...x....x........" },
+  { "Hicaz makam",       TUNING_53EDO,  7, "x....x...........x....x........x...x........x........" },
+  { "Orwell",            TUNING_53EDO,  9, "x......x....x......x....x......x....x......x....x...." },
+  { "Sephiroth",         TUNING_53EDO, 10, "x.....x....x....x.....x....x....x.....x....x....x...." },
+  { "Smitonic",          TUNING_53EDO,  7, "x..........x..........x..x..........x..x..........x.." },
+  { "Slendric",          TUNING_53EDO, 11, "x......x..x......x..x......x..x......x..x......x..x.." },
+  { "Semiquartal",       TUNING_53EDO,  9, "x........x.x........x.x........x.x........x.x........" },
+  { "Diatonic",          TUNING_72EDO,  7, "x...........x...........x.....x...........x...........x...........x....." },
+  { "Pentatonic",        TUNING_72EDO,  5, "x...........x...........x.................x...........x................." },
+  { "Ben Johnston",      TUNING_72EDO, 12, "x.....x.....x.....x....x....x....x........x.......x...x...x......x......" },
+  { "18-EDO",            TUNING_72EDO, 18, "x...x...x...x...x...x...x...x...x...x...x...x...x...x...x...x...x...x..." },
+  { "Miracle",           TUNING_72EDO, 21, "x....x.x....x.x....x.x.x....x.x....x.x....x.x....x.x....x.x....x.x....x." },
+  { "Marvolo",           TUNING_72EDO, 14, "x....x....x....x....x....x....x....x.x....x....x....x....x....x....x...." },
+  { "Catakleismic",      TUNING_72EDO, 15, "x...x......x...x...x...x......x...x...x...x......x...x...x...x......x..." },
+  { "Palace",            TUNING_72EDO,  7, "x.........x........x..........x...........x.........x........x.........." },
+  { "Lambda",            TUNING_BP,     9, "x.xx.xx.xx.xx" },
+  { "Super Meta Lydian", TUNING_ALPHA,  4, "x..x.x.x." },
+  { "Super Meta Lydian", TUNING_BETA,   4, "x..x..x..x." },
+  { "Super Meta Lydian", TUNING_GAMMA,  4, "x.....x....x....x..." },
+};
+
+static const uint32_t palettes[] = {     // checksum of the colour of every step
+  0x5E6B00C4,   // 12EDO
+  0x034127E3,   // 17EDO
+  0xB580CD95,   // 19EDO
+  0x4E87D9D8,   // 22EDO
+  0xCD52E894,   // 24EDO
+  0x8BEDB945,   // 31EDO
+  0x4BA60FBF,   // 41EDO
+  0x316E2395,   // 53EDO
+  0x2FC87888,   // 72EDO
+  0x86AD7581,   // BP
+  0xF375E236,   // ALPHA
+  0x19F8D6A8,   // BETA
+  0xF300DA51,   // GAMMA
+};
+
+#define COUNT(a) (sizeof(a) / sizeof(a[0]))
+
+static uint32_t checksum(uint32_t h, const void* p, size_t n) {    // FNV-1a
+  const uint8_t* b = (const uint8_t*)p;
+  for (size_t i = 0; i < n; i++) {
+    h ^= b[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+#define CHECKSUM_START 2166136261u
+
+static void testTunings() {
+  CHECK_EQUAL(COUNT(tunings), TUNINGCOUNT);
+  CHECK_EQUAL(COUNT(tuningOptions), TUNINGCOUNT);
+  for (uint8_t t = 0; t < TUNINGCOUNT; t++) {
+    const tuningDef& d = tuningOptions[t];
+    CHECK(strcmp(d.name, tunings[t].name) == 0);
+    CHECK_EQUAL(d.cycleLength, tunings[t].cycleLength);
+    CHECK(fabsf(d.stepSize - tunings[t].stepSize) < 0.0001f);
+    uint32_t h = CHECKSUM_START;
+    for (uint8_t k = 0; k < d.cycleLength; k++) {
+      h = checksum(h, d.keyChoices[k].name, strlen(d.keyChoices[k].name) + 1);
+      h = checksum(h, &d.keyChoices[k].stepsFromA, 1);
+    }
+    CHECK_EQUAL(h, tunings[t].keys);
+  }
+}
+
+static void testLayouts() {
+  CHECK_EQUAL(layoutCount, COUNT(layouts));
+  for (uint8_t l = 0; l < layoutCount; l++) {
+    const layoutDef& d = layoutOptions[l];
+    CHECK(strcmp(d.name, layouts[l].name) == 0);
+    CHECK_EQUAL(d.isPortrait, layouts[l].isPortrait);
+    CHECK_EQUAL(d.hexMiddleC, layouts[l].hexMiddleC);
+    CHECK_EQUAL(d.acrossSteps, layouts[l].acrossSteps);
+    CHECK_EQUAL(d.dnLeftSteps, layouts[l].dnLeftSteps);
+    CHECK_EQUAL(d.tuning, layouts[l].tuning);
+  }
+  // each tuning's layouts start where the layout menu looks for them
+  presetDef p = { "test", 0, 0, 0, 0, 0 };
+  for (p.tuningIndex = 0; p.tuningIndex < TUNINGCOUNT; p.tuningIndex++) {
+    int first = p.layoutsBegin();
+    CHECK_EQUAL(layoutOptions[first].tuning, p.tuningIndex);
+    CHECK((first == 0) || (layoutOptions[first - 1].tuning < p.tuningIndex));
+  }
+}
+
+static void testScales() {
+  CHECK_EQUAL(scaleCount, COUNT(scales));
+  for (uint8_t s = 0; s < scaleCount; s++) {
+    const scaleDef& d = scaleOptions[s];
+    CHECK(strcmp(d.name, scales[s].name) == 0);
+    CHECK_EQUAL(d.tuning, scales[s].tuning);
+    CHECK_EQUAL(d.stepCount, scales[s].stepCount);
+    std::string degrees;
+    if (d.tuning != ALL_TUNINGS) {
+      for (uint8_t n = 0; n < tuningOptions[d.tuning].cycleLength; n++) {
+        degrees += d.hasDegree(n) ? 'x' : '.';
+      }
+    }
+    if (degrees != scales[s].degrees) {
+      printf("%s:%d: scale %d (%s) takes in %s, expected %s\n",
+        __FILE__, __LINE__, s, d.name, degrees.c_str(), scales[s].degrees);
+      testFailures++;
+    }
+  }
+}
+
+static void testPalettes() {
+  CHECK_EQUAL(COUNT(palette), TUNINGCOUNT);
+  for (uint8_t t = 0; t < TUNINGCOUNT; t++) {
+    CHECK_EQUAL(palette[t].colorCount, tuningOptions[t].cycleLength);
+    uint32_t h = CHECKSUM_START;
+    for (uint8_t k = 0; k < palette[t].colorCount; k++) {
+      colorDef c = palette[t].getColor(k);
+      int32_t hue = (int32_t)(c.hue * 100 + 0.5f);
+      h = checksum(h, &hue, sizeof(hue));
+      h = checksum(h, &c.sat, 1);
+      h = checksum(h, &c.val, 1);
+    }
+    CHECK_EQUAL(h, palettes[t]);
+  }
+}
+
+int main() {
+  testTunings();
+  testLayouts();
+  testScales();
+  testPalettes();
+  return TEST_RESULT();
+}
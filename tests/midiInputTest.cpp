@@ -0,0 +1,218 @@
+/*
+  src/midiInput.h: the input queue, SysEx command parsing,
+  and choosing which hex plays an incoming note. Then a
+  recorded byte stream, split into messages the way the
+  MIDI library does it (running status, realtime bytes in
+  the middle of other messages, SysEx), queued as the
+  sketch reads it and acted on as readMIDI() does.
+*/
+#include <string>
+#include "hostTest.h"
+#include "midiInput.h"
+
+static void testQueue() {
+  midiInQueue q;
+  midiInEvent e = {};
+  CHECK(!q.pop(e));
+  for (int i = 0; i < MIDI_IN_QUEUE_SIZE; i++) {
+    CHECK(q.push(MIDI_IN_NOTE_ON, 1, i, 100));
+  }
+  CHECK(q.full());
+  CHECK(!q.push(MIDI_IN_NOTE_ON, 1, 99, 100));
+  CHECK_EQUAL(q.dropped, 1);
+  for (int i = 0; i < MIDI_IN_QUEUE_SIZE; i++) {
+    CHECK(q.pop(e));
+    CHECK_EQUAL(e.data1, i);
+  }
+  CHECK(!q.pop(e));
+  // keeps its order as the counters wrap
+  for (int i = 0; i < 1000; i++) {
+    CHECK(q.push(MIDI_IN_NOTE_OFF, 2, i & 127, 0));
+    CHECK(q.pop(e));
+    CHECK_EQUAL(e.type, MIDI_IN_NOTE_OFF);
+    CHECK_EQUAL(e.data1, i & 127);
+  }
+}
+
+static void testSysEx() {
+  sysExCommand c;
+  // with and without the F0 / F7 the MIDI library may leave on
+  const uint8_t tuning[] = { 0xF0, 0x7D, 'H', 'T', 0x00, 0x05, 0xF7 };
+  CHECK(midiInQueue::parseSysExCommand(tuning, sizeof(tuning), c));
+  CHECK_EQUAL(c.cmd, SYSEX_CMD_TUNING);
+  CHECK_EQUAL(c.value, 5);
+  CHECK(midiInQueue::parseSysExCommand(tuning + 1, sizeof(tuning) - 2, c));
+  CHECK_EQUAL(c.value, 5);
+  // key of C in 12 EDO is 9 steps below A
+  const uint8_t keyC[] = { 0xF0, 0x7D, 'H', 'K', 0x3F, 0x77, 0xF7 };
+  CHECK(midiInQueue::parseSysExCommand(keyC, sizeof(keyC), c));
+  CHECK_EQUAL(c.cmd, SYSEX_CMD_KEY);
+  CHECK_EQUAL(c.value - SYSEX_TRANSPOSE_ZERO, -9);
+  // transpose up 2
+  const uint8_t up2[] = { 0xF0, 0x7D, 'H', 'X', 0x40, 0x02, 0xF7 };
+  CHECK(midiInQueue::parseSysExCommand(up2, sizeof(up2), c));
+  CHECK_EQUAL(c.value - SYSEX_TRANSPOSE_ZERO, 2);
+
+  const uint8_t otherMaker[] = { 0xF0, 0x7E, 'H', 'T', 0x00, 0x05, 0xF7 };
+  CHECK(!midiInQueue::parseSysExCommand(otherMaker, sizeof(otherMaker), c));
+  const uint8_t otherDevice[] = { 0xF0, 0x7D, 'Q', 'T', 0x00, 0x05, 0xF7 };
+  CHECK(!midiInQueue::parseSysExCommand(otherDevice, sizeof(otherDevice), c));
+  const uint8_t notSevenBit[] = { 0xF0, 0x7D, 'H', 'T', 0x80, 0x05, 0xF7 };
+  CHECK(!midiInQueue::parseSysExCommand(notSevenBit, sizeof(notSevenBit), c));
+  const uint8_t tooLong[] = { 0xF0, 0x7D, 'H', 'D', 0x00, 0x00, 0x01, 0x02, 0xF7 };
+  CHECK(!midiInQueue::parseSysExCommand(tooLong, sizeof(tooLong), c));
+
+  // through the slots
+  midiInQueue q;
+  CHECK(q.pushSysEx(tuning, sizeof(tuning)));
+  CHECK(q.pushSysEx(keyC, sizeof(keyC)));
+  CHECK(!q.pushSysEx(up2, sizeof(up2)));            // both slots taken
+  uint8_t big[MIDI_IN_SYSEX_SIZE + 1] = { 0xF0 };
+  CHECK(!q.pushSysEx(big, sizeof(big)));
+  CHECK_EQUAL(q.dropped, 2);
+  midiInEvent e = {};
+  CHECK(q.pop(e));
+  CHECK_EQUAL(e.type, MIDI_IN_SYSEX);
+  CHECK(q.takeSysExCommand(e.data1, c));
+  CHECK_EQUAL(c.cmd, SYSEX_CMD_TUNING);
+  CHECK(q.pushSysEx(up2, sizeof(up2)));             // the slot is free again
+  CHECK(q.pop(e));
+  CHECK(q.takeSysExCommand(e.data1, c));
+  CHECK_EQUAL(c.cmd, SYSEX_CMD_KEY);
+  CHECK(q.pop(e));
+  CHECK(q.takeSysExCommand(e.data1, c));
+  CHECK_EQUAL(c.cmd, SYSEX_CMD_TRANSPOSE);
+}
+
+static void testNoteToHex() {
+  noteToHexMap m;
+  CHECK_EQUAL(m.hexFor(60), MIDI_IN_NO_HEX);
+  m.offer(60, 10, 0, 8);
+  m.offer(60, 11, 0, 3);       // in tune, and nearer the middle
+  m.offer(60, 12, 0, 3);       // a tie goes to the first
+  m.offer(60, 13, 20, 0);      // in the middle, but out of tune
+  CHECK_EQUAL(m.hexFor(60), 11);
+  m.offer(61, 20, 50, 0);
+  m.offer(61, 21, 10, 9);
+  CHECK_EQUAL(m.hexFor(61), 21);
+  CHECK_EQUAL(m.hexFor(61 + 128), 21);
+  CHECK_EQUAL(m.hexFor(62), MIDI_IN_NO_HEX);
+  m.clear();
+  CHECK_EQUAL(m.hexFor(60), MIDI_IN_NO_HEX);
+}
+
+/*
+  Splits bytes into messages as the MIDI library does.
+  Realtime bytes (0xF8 and up) are handed on the moment
+  they arrive, even in the middle of another message, as
+  the sketch's clock handlers get them; everything else is
+  pushed into the queue when it is complete.
+*/
+class byteStreamParser {
+  public:
+    byteStreamParser(midiInQueue& q) : queue(q) {}
+    void parse(uint8_t b) {
+      if (b >= 0xF8) {
+        realtime += (char)b;
+        return;
+      }
+      if (b == 0xF0) {
+        sysExLength = 0;
+        inSysEx = true;
+        runningStatus = 0;
+      }
+      if (inSysEx) {
+        if (sysExLength < sizeof(sysEx)) sysEx[sysExLength] = b;
+        sysExLength++;
+        if (b == 0xF7) {
+          inSysEx = false;
+          queue.pushMessage(MIDI_IN_SYSEX, 0, 0, 0, sysEx, sysExLength);
+        }
+        return;
+      }
+      if (b & 0x80) {
+        runningStatus = (b < 0xF0) ? b : 0;    // system common messages cancel running status
+        have = 0;
+        return;
+      }
+      if (!runningStatus) return;
+      data[have++] = b;
+      uint8_t kind = runningStatus & 0xF0;
+      uint8_t needs = ((kind == 0xC0) || (kind == 0xD0)) ? 1 : 2;
+      if (have == needs) {
+        queue.pushMessage(kind, (runningStatus & 0x0F) + 1, data[0], (needs == 2) ? data[1] : 0, 0, 0);
+        have = 0;
+      }
+    }
+    std::string realtime;      // in the order they arrived
+  private:
+    midiInQueue& queue;
+    uint8_t runningStatus = 0;
+    uint8_t data[2] = {};
+    uint8_t have = 0;
+    bool inSysEx = false;
+    uint8_t sysEx[64] = {};
+    uint16_t sysExLength = 0;
+};
+
+static const uint8_t stream[] = {
+  0xFA,                                   // start
+  0x90, 60, 100,                          // note on, channel 1
+  64, 0xF8, 90,                           // running status, a clock tick inside it
+  0xF8,
+  0xB0, 1, 64,                            // mod wheel, left out
+  0x99, 36, 127,                          // note on, channel 10
+  36, 0,                                  // running status, velocity 0 is note off
+  0xF0, 0x7D, 'H', 'T', 0xF8, 0x00, 0x05, 0xF7,   // tuning 5, a tick inside the SysEx
+  0x81, 60, 0xF8, 64,                     // note off, channel 2
+  0xC0, 5, 7,                             // program change twice, left out
+  0xF0, 0x7E, 0x7F, 0x09, 0x01, 0xF7,     // someone else's SysEx: queued, not a command
+  0x90, 64, 0,                            // note off by velocity 0
+  0xFC,                                   // stop
+};
+
+static void testByteStream() {
+  midiInQueue q;
+  byteStreamParser parser(q);
+  for (uint8_t b : stream) parser.parse(b);
+  CHECK(parser.realtime == "\xFA\xF8\xF8\xF8\xF8\xFC");
+  CHECK_EQUAL(q.dropped, 0);
+  // as readMIDI() acts on the queue
+  std::string played;
+  int commands = 0;
+  int16_t tuning = -1;
+  midiInEvent e;
+  while (q.pop(e)) {
+    switch (e.type) {
+      case MIDI_IN_NOTE_ON:
+        played += "+" + std::to_string(e.channel) + ":" + std::to_string(e.data1) + " ";
+        break;
+      case MIDI_IN_NOTE_OFF:
+        played += "-" + std::to_string(e.channel) + ":" + std::to_string(e.data1) + " ";
+        break;
+      case MIDI_IN_SYSEX: {
+        sysExCommand c;
+        if (q.takeSysExCommand(e.data1, c)) {
+          commands++;
+          if (c.cmd == SYSEX_CMD_TUNING) tuning = c.value;
+        }
+        played += "sysex ";
+        break;
+      }
+      default:
+        played += "? ";
+        break;
+    }
+  }
+  CHECK(played == "+1:60 +1:64 +10:36 -10:36 sysex -2:60 sysex -1:64 ");
+  CHECK_EQUAL(commands, 1);
+  CHECK_EQUAL(tuning, 5);
+}
+
+int main() {
+  testQueue();
+  testSysEx();
+  testNoteToHex();
+  testByteStream();
+  return TEST_RESULT();
+}
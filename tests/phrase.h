@@ -0,0 +1,25 @@
+/*
+  The phrase the renders play, and fmVoiceTest checks:
+  three-note chords, each sounding for a second and then
+  silent for half a second, changing each time round.
+*/
+#pragma once
+#include <stdint.h>
+#include "benchmark.h"
+
+#define PHRASE_VOICES 3
+#define PHRASE_CHORDS 4
+#define PHRASE_NOTE_SAMPLES (POLL_SAMPLE_RATE * 3 / 2)   // from the start of one chord to the next
+#define PHRASE_ON_SAMPLES POLL_SAMPLE_RATE               // how long each one sounds
+
+static const double phraseChords[PHRASE_CHORDS][PHRASE_VOICES] = {
+  { 261.63, 329.63, 392.00 }, { 220.00, 261.63, 329.63 },
+  { 174.61, 220.00, 261.63 }, { 196.00, 246.94, 293.66 } };
+
+// the chord playing at sample n, whether or not it is sounding yet
+inline const double* phraseChordAt(uint32_t n) {
+  return phraseChords[(n / PHRASE_NOTE_SAMPLES) % PHRASE_CHORDS];
+}
+inline bool phraseSounding(uint32_t n) {
+  return (n % PHRASE_NOTE_SAMPLES) < PHRASE_ON_SAMPLES;
+}
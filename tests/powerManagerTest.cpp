@@ -0,0 +1,152 @@
+/*
+  src/powerManager.h, played through recorded traces of
+  what the board was doing: when keys went down, voices
+  sounded, the menu was open or the looper ran. The
+  policy is updated once per key scan, as in the sketch,
+  and straight away when an incoming note or the looper
+  starts something between scans. The board must be at
+  full speed whenever anything is going on, must never
+  slow down within POWER_IDLE_AFTER of it, and should be
+  idle for the rest of each long pause.
+*/
+#include "hostTest.h"
+#include "powerManager.h"
+
+#define POWER_IDLE_AFTER 2000000     // as in the sketch
+#define SCAN_PERIOD 4000
+
+struct traceStep {
+  uint32_t ms;             // from the start of the trace
+  uint8_t busy;            // POWER_BUSY_ flags from then on
+};
+
+struct replayResult {
+  uint32_t busyNotFull;    // updates with something going on that didn't get full speed
+  uint32_t idleTooSoon;    // updates that were idle within POWER_IDLE_AFTER of the last activity
+  uint32_t idleCount;
+  uint64_t idle;           // microseconds
+};
+
+static replayResult replay(powerPolicy& p, const traceStep* trace, int steps, uint32_t endMs) {
+  replayResult r = {};
+  uint64_t end = (uint64_t)endMs * 1000;
+  uint64_t nextScan = 0;
+  uint64_t lastBusy = 0;
+  uint8_t busy = 0;
+  int next = 0;
+  while (true) {
+    uint64_t event = (next < steps) ? (uint64_t)trace[next].ms * 1000 : UINT64_MAX;
+    uint64_t now = (event < nextScan) ? event : nextScan;
+    if (now > end) break;
+    if (now == event) {
+      busy = trace[next++].busy;
+    } else {
+      nextScan += SCAN_PERIOD;
+    }
+    uint8_t mode = p.update(now, busy);
+    if (busy) {
+      lastBusy = now;
+      if (mode != POWER_FULL) r.busyNotFull++;
+    } else if ((mode == POWER_IDLE) && (now - lastBusy < POWER_IDLE_AFTER)) {
+      r.idleTooSoon++;
+    }
+  }
+  r.idleCount = p.idleCount;
+  r.idle = p.totalIdle(end);
+  return r;
+}
+
+static void expectIdle(const replayResult& r, uint32_t count, uint64_t idle, int line) {
+  uint64_t slack = (uint64_t)count * SCAN_PERIOD;     // each pause is timed from a scan
+  if (r.busyNotFull || r.idleTooSoon || (r.idleCount != count) || (r.idle + slack < idle) || (r.idle > idle + slack)) {
+    printf("%s:%d: idle %u times for %llu us (expected %u, %llu), %u busy updates slow, %u idle too soon\n",
+      __FILE__, line, (unsigned)r.idleCount, (unsigned long long)r.idle, (unsigned)count,
+      (unsigned long long)idle, (unsigned)r.busyNotFull, (unsigned)r.idleTooSoon);
+    testFailures++;
+  }
+}
+
+/*
+  A short set: two phrases with a breath between, a long
+  pause, a note played in over MIDI between two scans, a
+  minute of the looper, then nothing.
+*/
+static const traceStep set[] = {
+  {     0, POWER_BUSY_KEYS | POWER_BUSY_VOICES },
+  {   300, POWER_BUSY_VOICES },
+  {  1500, POWER_BUSY_KEYS | POWER_BUSY_VOICES },
+  {  1800, POWER_BUSY_VOICES },
+  {  3000, 0 },
+  {  4900, POWER_BUSY_KEYS | POWER_BUSY_VOICES },    // the breath: too short to slow down
+  {  5200, 0 },
+  { 40001, POWER_BUSY_VOICES },                      // incoming
+  { 41000, 0 },
+  { 70002, POWER_BUSY_LOOPER },
+  { 130002, 0 },
+};
+
+static void testSet() {
+  powerPolicy p(POWER_IDLE_AFTER);
+  replayResult r = replay(p, set, sizeof(set) / sizeof(set[0]), 150000);
+  uint64_t idle = (40001000 - 5200000 - POWER_IDLE_AFTER)
+    + (70002000 - 41000000 - POWER_IDLE_AFTER)
+    + (150000000 - 130002000 - POWER_IDLE_AFTER);
+  expectIdle(r, 3, idle, __LINE__);
+}
+
+// the menu in use keeps it awake, with no keys or voices at all
+static const traceStep menu[] = {
+  {     0, POWER_BUSY_SCREEN },
+  { 10000, 0 },
+  { 20000, POWER_BUSY_KEYS },
+  { 20100, 0 },
+};
+
+static void testMenu() {
+  powerPolicy p(POWER_IDLE_AFTER);
+  replayResult r = replay(p, menu, sizeof(menu) / sizeof(menu[0]), 25000);
+  uint64_t idle = (20000000 - 10000000 - POWER_IDLE_AFTER) + (25000000 - 20100000 - POWER_IDLE_AFTER);
+  expectIdle(r, 2, idle, __LINE__);
+}
+
+// steady playing, never quiet for long enough
+static void testNeverIdle() {
+  traceStep busy[200];
+  for (int i = 0; i < 100; i++) {
+    busy[2 * i] = { (uint32_t)i * 2000, POWER_BUSY_KEYS | POWER_BUSY_VOICES };
+    busy[2 * i + 1] = { (uint32_t)i * 2000 + 400, 0 };
+  }
+  powerPolicy p(POWER_IDLE_AFTER);
+  replayResult r = replay(p, busy, 200, 200000);
+  expectIdle(r, 0, 0, __LINE__);
+}
+
+// when the clock can't be changed, it stays at full speed and tries again later
+static void testRefused() {
+  powerPolicy p(POWER_IDLE_AFTER);
+  CHECK_EQUAL(p.update(0, POWER_BUSY_KEYS), POWER_FULL);
+  CHECK_EQUAL(p.update(POWER_IDLE_AFTER, 0), POWER_IDLE);
+  p.refused(POWER_IDLE_AFTER);
+  CHECK_EQUAL(p.mode, POWER_FULL);
+  CHECK_EQUAL(p.idleCount, 0);
+  CHECK_EQUAL(p.refusals, 1);
+  CHECK_EQUAL(p.totalIdle(POWER_IDLE_AFTER + 1000), 0);
+  CHECK_EQUAL(p.update(2 * POWER_IDLE_AFTER - 1, 0), POWER_FULL);   // not every scan
+  CHECK_EQUAL(p.update(2 * POWER_IDLE_AFTER, 0), POWER_IDLE);
+  CHECK_EQUAL(p.idleCount, 1);
+  CHECK_EQUAL(p.update(2 * POWER_IDLE_AFTER + 500, POWER_BUSY_VOICES), POWER_FULL);
+  CHECK_EQUAL(p.totalIdle(3 * POWER_IDLE_AFTER), 500);
+  // refused on the way back up: the policy is already at full speed
+  p.refused(2 * POWER_IDLE_AFTER + 500);
+  CHECK_EQUAL(p.mode, POWER_FULL);
+  CHECK_EQUAL(p.idleCount, 1);
+  CHECK_EQUAL(p.refusals, 2);
+}
+
+int main() {
+  testSet();
+  testMenu();
+  testNeverIdle();
+  testRefused();
+  return TEST_RESULT();
+}
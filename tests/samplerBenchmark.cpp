@@ -0,0 +1,95 @@
+/*
+  src/sampler.h: time per sample of eight sampler voices,
+  the synth's polyphony, reading a bank in a memory-mapped
+  file, mixed the way the synth interrupt does it, scaled
+  to the board (see benchmark.h). Run by hand:
+    build/samplerBenchmark
+  Returns non-zero if anything won't fit the budget.
+
+  On the board the voices read uncached flash, which this
+  computer can't time. Each read copies SAMPLER_BLOCK + 2
+  samples, a word at a time; a word from uncached flash
+  takes about FLASH_WORD_US (some 20 QSPI clocks at
+  66 MHz, in the continuous read mode the boot stage sets
+  up). The voices count their reads (see sampler.h), so
+  ten seconds of each chord are played first to find the
+  reads per sample, on average and at worst, and their
+  cost is added in.
+*/
+#include "benchmark.h"
+#include "mappedBank.h"
+
+#define BENCH_SAMPLES 2000000
+#define VOICES 8                 // POLYPHONY_LIMIT
+#define BANK_BYTES (4 << 20)
+#define FLASH_WORD_US 0.35
+#define PREFETCH_US (FLASH_WORD_US * (SAMPLER_BLOCK + 2) / 2)
+
+struct benchVoice {
+  samplerVoice sample;
+  uint8_t eq;
+};
+static benchVoice voice[VOICES];
+static sampleBank bank;
+
+static void sample() {
+  uint32_t mix = 0;
+  int8_t fetches = SAMPLER_FETCHES;
+  for (int i = 0; i < VOICES; i++) {
+    uint16_t p = voice[i].sample.next(fetches);
+    mix += p * voice[i].eq;
+  }
+  benchmarkSink = mix;
+}
+
+// flash reads in each sample, as the voices count them
+struct fetchStats {
+  double average;
+  int worst;
+};
+static fetchStats countFetches(uint32_t samples) {
+  fetchStats f = { 0, 0 };
+  uint32_t total = 0;
+  for (uint32_t n = 0; n < samples; n++) {
+    int8_t fetches = SAMPLER_FETCHES;
+    for (int i = 0; i < VOICES; i++) voice[i].sample.next(fetches);
+    int used = SAMPLER_FETCHES - fetches;
+    total += used;
+    if (used > f.worst) f.worst = used;
+  }
+  f.average = (double)total / samples;
+  return f;
+}
+
+// a chord spread evenly over a number of octaves up from C3
+static void play(double octaves) {
+  for (int i = 0; i < VOICES; i++) {
+    float hz = 130.81f * exp2f((octaves * i) / (VOICES - 1));
+    voice[i].sample.start(bank, hz, POLL_SAMPLE_RATE);
+    voice[i].eq = 4 + (i & 3);
+  }
+}
+
+int main() {
+  mappedFlash flash(BANK_BYTES);
+  sampleBankBuilder b;
+  if (!flash.map || !b.begin(flash, BANK_BYTES)) return 1;
+  for (uint8_t note = 48; note <= 84; note += 12) {     // a zone an octave, with long loops
+    memoryWav w = memoryWav::sine(note, 44100, 88200, 2, 16, true);
+    if (!b.add(w, flash, 440.0f)) return 1;
+  }
+  if (!b.finish(flash) || !bank.attach(flash.map, BANK_BYTES)) return 1;
+
+  bool fits = true;
+  const double spread[] = { 1.0, 2.0, 4.0 };
+  const char* what[] = { "8 voices, over an octave", "8 voices, over 2 octaves", "8 voices, over 4 octaves" };
+  for (int n = 0; n < 3; n++) {
+    play(spread[n]);
+    fetchStats f = countFetches(10 * POLL_SAMPLE_RATE);
+    play(spread[n]);
+    double t = hostNanosPerCall(sample, BENCH_SAMPLES);
+    fits &= reportPerSample(what[n], t + f.average * PREFETCH_US * 1000.0 / HOST_SPEEDUP);
+    fits &= reportPerSample("  the worst sample", t + f.worst * PREFETCH_US * 1000.0 / HOST_SPEEDUP);
+  }
+  return fits ? 0 : 1;
+}
@@ -0,0 +1,245 @@
+/*
+  src/sampler.h: builds a bank from WAV files made in
+  memory into a memory-mapped file standing in for the
+  flash (see mappedBank.h), attaches to the mapping as
+  the sketch does to flash, and plays it: each zone's
+  samples and loop come through, and a voice plays at
+  the pitch it is asked for. Then damaged files, which
+  must be turned away (or read as far as they go)
+  rather than sending the chunk walk round for ever, and
+  files that fail part way through their samples, which
+  must be left out without spoiling the files after them.
+*/
+#include "hostTest.h"
+#include "mappedBank.h"
+
+#define BANK_BYTES (1 << 20)
+#define OUTPUT_RATE 41667.0f    // the synth's sample rate
+
+/*
+  A voice's pitch, from the upward zero crossings in its
+  first 0.15 s (shorter than the shortest zone), and
+  whether it has finished by the end of a second. A
+  crossing counts once the wave has gone well below 0,
+  so a wobble about 0 isn't counted twice.
+*/
+static float measureHz(sampleBank& bank, float hz, bool& done) {
+  samplerVoice v;
+  v.start(bank, hz, OUTPUT_RATE);
+  uint32_t crossings = 0;
+  uint32_t first = 0;
+  uint32_t last = 0;
+  bool below = false;
+  for (uint32_t i = 0; i < (uint32_t)OUTPUT_RATE; i++) {
+    int8_t fetches = SAMPLER_FETCHES;
+    int32_t s = (int32_t)v.next(fetches) - 32768;
+    if (s < -1000) {
+      below = true;
+    } else if (below && (s >= 0) && (i < 0.15f * OUTPUT_RATE)) {
+      below = false;
+      if (!crossings++) first = i;
+      last = i;
+    }
+  }
+  done = v.isDone();
+  return (crossings > 1) ? (crossings - 1) * OUTPUT_RATE / (last - first) : 0;
+}
+
+static void testBuildAndPlay() {
+  mappedFlash flash(BANK_BYTES);
+  CHECK(flash.map);
+  sampleBankBuilder b;
+  CHECK(b.begin(flash, BANK_BYTES));
+  memoryWav stereo = memoryWav::sine(60, 44100, 20000, 2, 16, true);
+  memoryWav eightBit = memoryWav::sine(72, 22050, 5001, 1, 8, false);
+  memoryWav deep = memoryWav::sine(48, 48000, 8000, 1, 24, false);
+  CHECK(b.add(stereo, flash, 100.0f));            // the smpl chunk's root wins
+  CHECK(b.add(eightBit, flash, 523.251f));
+  CHECK(b.add(deep, flash, 130.813f));
+  CHECK(b.finish(flash));
+  CHECK_EQUAL(b.zoneCount(), 3);
+
+  sampleBank bank;
+  CHECK(bank.attach(flash.map, BANK_BYTES));
+  CHECK_EQUAL(bank.zoneCount(), 3);
+  const sampleZone& z0 = bank.zone(0);
+  CHECK_EQUAL(z0.length, 20000);
+  CHECK_EQUAL(z0.sampleRate, 44100);
+  CHECK_EQUAL(z0.loopStart, 5000);
+  CHECK_EQUAL(z0.loopEnd, 5000 + 3371);           // 20 cycles of 261.63 Hz at 44.1 kHz
+  CHECK((z0.rootMilliHz >= 261625) && (z0.rootMilliHz <= 261627));
+  CHECK_EQUAL(bank.zone(1).length, 5001);
+  CHECK_EQUAL(bank.zone(1).loopEnd, 0);
+  CHECK_EQUAL(bank.zone(1).rootMilliHz, 523251);
+  CHECK_EQUAL(bank.zone(2).length, 8000);
+  for (uint8_t z = 0; z < 3; z++) {
+    CHECK(bank.zone(z).offset >= SAMPLER_DATA_START);
+    CHECK_EQUAL(bank.zone(z).offset % (2 * SAMPLER_BLOCK), 0);
+  }
+  // the samples as written, mixed down and cut to 16 bits
+  memoryWav check = memoryWav::sine(60, 44100, 20000, 1, 16, false);
+  const int16_t* s = bank.samples(0);
+  uint32_t wrong = 0;
+  for (uint32_t i = 0; i < 20000; i++) {
+    int16_t expected = check.d[44 + 2 * i] | (check.d[45 + 2 * i] << 8);
+    if (s[i] != expected) wrong++;
+  }
+  CHECK_EQUAL(wrong, 0);
+  for (uint32_t i = 20000; i < 20000 + SAMPLER_BLOCK; i++) CHECK_EQUAL(s[i], 0);   // the silence after it
+
+  // each note plays the nearest zone, at its own pitch; the looped zone keeps going
+  const float notes[] = { 246.94f, 261.63f, 329.63f, 523.25f, 130.81f };
+  for (float hz : notes) {
+    bool done;
+    float got = measureHz(bank, hz, done);
+    if ((got < hz * 0.99f) || (got > hz * 1.01f)) {
+      printf("%s:%d: %.2f Hz played at %.2f Hz\n", __FILE__, __LINE__, hz, got);
+      testFailures++;
+    }
+    uint8_t z = bank.zoneFor(hz);
+    CHECK_EQUAL(done, bank.zone(z).loopEnd == 0);
+  }
+
+  /*
+    Blocks read ahead of time play the same as blocks read
+    as they're needed, through the loop and at any pitch;
+    and however many reads the voice is allowed, it never
+    needs more than one in a sample.
+  */
+  const float pitches[] = { 261.63f, 370.0f, 190.0f, 523.25f, 98.0f };
+  for (float hz : pitches) {
+    samplerVoice early, late;
+    early.start(bank, hz, OUTPUT_RATE);
+    late.start(bank, hz, OUTPUT_RATE);
+    uint32_t differ = 0;
+    int worst = 0;
+    for (uint32_t i = 0; i < (uint32_t)OUTPUT_RATE; i++) {
+      int8_t plenty = 8;
+      int8_t none = 0;
+      if (early.next(plenty) != late.next(none)) differ++;
+      if (8 - plenty > worst) worst = 8 - plenty;
+    }
+    CHECK_EQUAL(differ, 0);
+    CHECK(worst <= 1);
+  }
+
+  // the sketch looks for a bank whether or not one is there
+  uint32_t firstZone = bank.zone(0).offset;
+  flash.map[0] ^= 1;
+  CHECK(!bank.attach(flash.map, BANK_BYTES));
+  flash.map[0] ^= 1;
+  CHECK(!bank.attach(flash.map, firstZone));         // too small for the zones it lists
+  CHECK(bank.attach(flash.map, BANK_BYTES));
+}
+
+// a chunk put in before "data", with a given size
+static memoryWav withChunkBeforeData(uint32_t size) {
+  memoryWav good = memoryWav::sine(69, 44100, 1000, 1, 16, false);
+  memoryWav w;
+  w.d.assign(good.d.begin(), good.d.begin() + 36);        // RIFF header and fmt
+  w.tag("LIST");
+  w.u32(size);
+  w.u32(0);
+  w.d.insert(w.d.end(), good.d.begin() + 36, good.d.end());
+  return w;
+}
+
+static void testDamagedFiles() {
+  mappedFlash flash(BANK_BYTES);
+  sampleBankBuilder b;
+  CHECK(b.begin(flash, BANK_BYTES));
+  memoryWav ok = withChunkBeforeData(4);
+  CHECK(b.add(ok, flash, 440.0f));
+  // sizes that used to wrap the walk back onto the same chunk, or before it
+  memoryWav sameAgain = withChunkBeforeData(0xFFFFFFF8);
+  CHECK(!b.add(sameAgain, flash, 440.0f));
+  memoryWav back = withChunkBeforeData(0xFFFFFFE0);
+  CHECK(!b.add(back, flash, 440.0f));
+  memoryWav past = withChunkBeforeData(0x10000);
+  CHECK(!b.add(past, flash, 440.0f));
+  // data written as a stream, with no length: read to the end of the file
+  memoryWav stream = memoryWav::sine(69, 44100, 1000, 1, 16, false);
+  stream.set32(40, 0xFFFFFFFF);
+  CHECK(b.add(stream, flash, 440.0f));
+  // cut short in the middle of a frame: the whole frames that are there
+  memoryWav cut = memoryWav::sine(69, 44100, 1000, 2, 16, false);
+  cut.d.resize(44 + 4 * 600 + 2);
+  CHECK(b.add(cut, flash, 440.0f));
+  // a chunk header that doesn't fit
+  memoryWav stub = memoryWav::sine(69, 44100, 1000, 1, 16, false);
+  stub.d.resize(40);
+  CHECK(!b.add(stub, flash, 440.0f));
+  memoryWav notWav = memoryWav::sine(69, 44100, 1000, 1, 16, false);
+  notWav.d[8] = 'X';
+  CHECK(!b.add(notWav, flash, 440.0f));
+  memoryWav twelveBit = memoryWav::sine(69, 44100, 1000, 1, 16, false);
+  twelveBit.d[34] = 12;
+  CHECK(!b.add(twelveBit, flash, 440.0f));
+  CHECK(b.finish(flash));
+
+  sampleBank bank;
+  CHECK(bank.attach(flash.map, BANK_BYTES));
+  CHECK_EQUAL(bank.zoneCount(), 3);
+  CHECK_EQUAL(bank.zone(0).length, 1000);
+  CHECK_EQUAL(bank.zone(1).length, 1000);
+  CHECK_EQUAL(bank.zone(2).length, 600);
+}
+
+// a file that stops reading (a card pulled out, say) after so many bytes
+class failingWav : public memoryWav {
+  public:
+    failingWav(const memoryWav& w, uint32_t _budget) : memoryWav(w) {
+      budget = _budget;
+    }
+    uint32_t read(uint8_t* buffer, uint32_t bytes) {
+      if (bytes > budget) bytes = budget;
+      budget -= bytes;
+      return memoryWav::read(buffer, bytes);
+    }
+  private:
+    uint32_t budget;
+};
+
+static void testFailsPartWay() {
+  mappedFlash flash(BANK_BYTES);
+  sampleBankBuilder b;
+  CHECK(b.begin(flash, BANK_BYTES));
+  memoryWav first = memoryWav::sine(57, 44100, 1001, 1, 16, false);
+  CHECK(b.add(first, flash, 440.0f));
+  uint32_t used = b.bytesUsed();
+  // fails before any of it is programmed: the next file goes where it would have
+  failingWav early(memoryWav::sine(60, 44100, 3000, 1, 16, false), 44 + 2 * 40);
+  CHECK(!b.add(early, flash, 440.0f));
+  CHECK_EQUAL(b.bytesUsed(), used);
+  // fails several pages in: the next file starts on a block after it
+  failingWav late(memoryWav::sine(64, 44100, 3000, 1, 16, false), 44 + 2 * 1500);
+  CHECK(!b.add(late, flash, 440.0f));
+  CHECK(b.bytesUsed() > used + SAMPLER_PAGE);
+  memoryWav good = memoryWav::sine(69, 44100, 2000, 1, 16, false);
+  CHECK(b.add(good, flash, 440.0f));
+  CHECK(b.finish(flash));
+
+  sampleBank bank;
+  CHECK(bank.attach(flash.map, BANK_BYTES));
+  CHECK_EQUAL(bank.zoneCount(), 2);
+  const memoryWav* files[] = { &first, &good };
+  for (uint8_t z = 0; z < 2; z++) {
+    CHECK_EQUAL(bank.zone(z).offset % (2 * SAMPLER_BLOCK), 0);
+    const int16_t* s = bank.samples(z);
+    uint32_t wrong = 0;
+    for (uint32_t i = 0; i < bank.zone(z).length; i++) {
+      int16_t expected = files[z]->d[44 + 2 * i] | (files[z]->d[45 + 2 * i] << 8);
+      if (s[i] != expected) wrong++;
+    }
+    CHECK_EQUAL(wrong, 0);
+    for (uint32_t i = bank.zone(z).length; i < bank.zone(z).length + SAMPLER_BLOCK; i++) CHECK_EQUAL(s[i], 0);
+  }
+  CHECK_EQUAL(bank.zone(1).length, 2000);
+}
+
+int main() {
+  testBuildAndPlay();
+  testDamagedFiles();
+  testFailsPartWay();
+  return TEST_RESULT();
+}
@@ -0,0 +1,153 @@
+/*
+  src/scanCalibration.h, against a simulated key matrix:
+  each column and row has its own time to recover, with a
+  little jitter from one read to the next, and a key can
+  be held down to make a line stick.
+*/
+#include <string.h>
+#include "hostTest.h"
+#include "scanCalibration.h"
+
+#define SIM_COLS 10
+#define SIM_ROWS 16
+
+struct simulatedMatrix {
+  uint16_t recovery[SIM_COLS][SIM_ROWS];    // microseconds, before jitter
+  uint8_t jitter;
+  int heldCol;
+  int heldRow;
+  uint32_t seed;
+  uint32_t reads;
+  simulatedMatrix() {
+    jitter = 1;
+    heldCol = -1;
+    heldRow = -1;
+    seed = 12345;
+    reads = 0;
+    for (int c = 0; c < SIM_COLS; c++) {
+      for (int r = 0; r < SIM_ROWS; r++) {
+        recovery[c][r] = 3 + (c % 3) + (r / 5);    // 3 to 8
+      }
+    }
+  }
+  uint16_t noise() {
+    seed = seed * 1664525 + 1013904223;
+    return (seed >> 16) % (jitter + 1);
+  }
+  uint16_t actual(uint8_t c, uint8_t r) {
+    return recovery[c][r] + noise();
+  }
+  uint16_t recoveryTime(uint8_t c, uint8_t r) {
+    reads++;
+    if ((c == heldCol) && (r == heldRow)) return SCAN_CAL_STUCK;
+    return actual(c, r);
+  }
+  bool readsClean(uint8_t c, uint8_t r, uint8_t settle) {
+    reads++;
+    if ((c == heldCol) && (r == heldRow)) return false;
+    return settle >= actual(c, r);
+  }
+};
+
+static void testGroups() {
+  scanCalibration sixteen(SIM_COLS, 16);
+  int size[SCAN_ROW_GROUPS] = {};
+  for (int r = 0; r < 16; r++) size[sixteen.groupOf(r)]++;
+  for (int g = 0; g < SCAN_ROW_GROUPS; g++) CHECK_EQUAL(size[g], 4);
+  scanCalibration fourteen(SIM_COLS, 14);
+  int expected[SCAN_ROW_GROUPS] = { 4, 3, 4, 3 };
+  int size14[SCAN_ROW_GROUPS] = {};
+  for (int r = 0; r < 14; r++) size14[fourteen.groupOf(r)]++;
+  for (int g = 0; g < SCAN_ROW_GROUPS; g++) CHECK_EQUAL(size14[g], expected[g]);
+}
+
+static void testMargin() {
+  CHECK_EQUAL(scanCalibration::withMargin(0), 1);
+  CHECK_EQUAL(scanCalibration::withMargin(4), 7);
+  CHECK_EQUAL(scanCalibration::withMargin(100), SCAN_MAX_SETTLE);
+}
+
+// every delay must cover the slowest line in its segment, and read clean
+static void testCalibrate() {
+  simulatedMatrix m;
+  scanCalibration cal(SIM_COLS, SIM_ROWS);
+  CHECK(cal.calibrate(m));
+  for (int c = 0; c < SIM_COLS; c++) {
+    for (int r = 0; r < SIM_ROWS; r++) {
+      CHECK(cal.delayFor(c, r) >= m.recovery[c][r] + m.jitter);
+      CHECK(cal.delayFor(c, r) <= SCAN_MAX_SETTLE);
+    }
+  }
+  // faster than one worst-case delay everywhere
+  CHECK(cal.totalSettle() < (uint32_t)SIM_COLS * SIM_ROWS * SCAN_DEFAULT_SETTLE);
+  // and no false reads at the chosen delays
+  for (int pass = 0; pass < 100; pass++) {
+    for (int c = 0; c < SIM_COLS; c++) {
+      for (int r = 0; r < SIM_ROWS; r++) {
+        CHECK(m.readsClean(c, r, cal.delayFor(c, r)));
+      }
+    }
+  }
+}
+
+// a line that needs more than the margin gives is caught by the confirmation reads
+static void testConfirmRaisesDelay() {
+  scanCalibration cal(SIM_COLS, SIM_ROWS);
+  struct slowToConfirm : simulatedMatrix {
+    bool readsClean(uint8_t c, uint8_t r, uint8_t settle) {
+      return settle >= 2 * actual(c, r);     // measures quick, but needs twice as long
+    }
+  } s;
+  s.jitter = 0;
+  CHECK(cal.calibrate(s));
+  for (int c = 0; c < SIM_COLS; c++) {
+    for (int r = 0; r < SIM_ROWS; r++) {
+      CHECK(cal.delayFor(c, r) >= 2 * s.recovery[c][r]);
+    }
+  }
+}
+
+static void testHeldKey() {
+  simulatedMatrix m;
+  scanCalibration cal(SIM_COLS, SIM_ROWS);
+  CHECK(cal.calibrate(m));
+  uint8_t before[SCAN_MAX_COLS][SCAN_ROW_GROUPS];
+  memcpy(before, cal.settle, sizeof(before));
+  m.heldCol = 7;
+  m.heldRow = 9;
+  for (int c = 0; c < SIM_COLS; c++) m.recovery[c][0] = 20;   // would change the profile
+  CHECK(!cal.calibrate(m));
+  CHECK(!memcmp(before, cal.settle, sizeof(before)));          // kept as it was
+  CHECK(!cal.verifyColumn(m, 7));
+  CHECK(!memcmp(before, cal.settle, sizeof(before)));
+}
+
+static void testVerifyOnlyRaises() {
+  simulatedMatrix m;
+  scanCalibration cal(SIM_COLS, SIM_ROWS);
+  CHECK(cal.calibrate(m));
+  uint8_t slowBefore = cal.delayFor(2, 15);
+  uint8_t other = cal.delayFor(3, 15);
+  m.recovery[2][15] += 6;                                      // got slower
+  CHECK(cal.verifyColumn(m, 2));
+  CHECK(cal.delayFor(2, 15) > slowBefore);
+  CHECK_EQUAL(cal.delayFor(3, 15), other);
+  for (int c = 0; c < SIM_COLS; c++) {
+    for (int r = 0; r < SIM_ROWS; r++) {
+      m.recovery[c][r] = 1;                                    // got faster
+    }
+  }
+  uint8_t raised = cal.delayFor(2, 15);
+  CHECK(!cal.verifyColumn(m, 2));
+  CHECK_EQUAL(cal.delayFor(2, 15), raised);
+}
+
+int main() {
+  testGroups();
+  testMargin();
+  testCalibrate();
+  testConfirmRaisesDelay();
+  testHeldKey();
+  testVerifyOnlyRaises();
+  return TEST_RESULT();
+}
@@ -0,0 +1,202 @@
+/*
+  src/taskScheduler.h, against a virtual clock that only
+  moves when the test (or a task) moves it: which task
+  runs first, when one is held back for a higher priority
+  task, deadlines moved with setDeadline(), and the
+  counts of missed deadlines and runs over budget.
+*/
+#include <string>
+#include "hostTest.h"
+#include "taskScheduler.h"
+
+struct virtualClock {
+  uint64_t t;
+  uint64_t now() {
+    return t;
+  }
+};
+
+static virtualClock clk;
+static taskScheduler s;
+static std::string ran;          // one letter per run, in order
+static uint32_t cost;            // microseconds each run of taskSlow takes
+static uint8_t selfTask;
+
+static void taskA() { ran += 'a'; }
+static void taskB() { ran += 'b'; }
+static void taskC() { ran += 'c'; }
+static void taskSlow() {
+  ran += 's';
+  clk.t += cost;
+}
+static void taskMovesItself() {
+  ran += 'm';
+  s.setDeadline(selfTask, clk.t + 250);
+}
+
+static void reset(uint64_t now) {
+  clk.t = now;
+  s = taskScheduler();
+  ran.clear();
+  cost = 0;
+}
+// run whatever is due at time t
+static uint8_t runAt(uint64_t t) {
+  clk.t = t;
+  return s.runNext(clk);
+}
+
+static void testAdd() {
+  reset(5000);
+  uint8_t a = s.add("a", taskA, 1000, 1, 100, clk.t);
+  CHECK_EQUAL(a, 0);
+  CHECK_EQUAL(s.nextDeadline(), 6000);
+  CHECK_EQUAL(runAt(5999), TASK_NONE);
+  CHECK_EQUAL(runAt(6000), a);
+  CHECK_EQUAL(s.nextDeadline(), 7000);
+  CHECK_EQUAL(s.add("never", taskB, 0, 1, 100, clk.t), TASK_NONE);
+  for (int i = 1; i < TASK_MAX; i++) CHECK_EQUAL(s.add("b", taskB, 1000, 1, 100, clk.t), i);
+  CHECK_EQUAL(s.add("full", taskC, 1000, 1, 100, clk.t), TASK_NONE);
+  // a new period counts from now
+  s.setPeriod(a, 500, 6100);
+  CHECK_EQUAL(s.tasks[a].timer.getDeadline(), 6600);
+}
+
+static void testOrder() {
+  reset(0);
+  s.add("a", taskA, 1000, 1, 10, clk.t);
+  s.add("b", taskB, 1000, 5, 10, clk.t);
+  CHECK_EQUAL(runAt(1000), 1);           // higher priority first
+  CHECK_EQUAL(runAt(1000), 0);
+  CHECK_EQUAL(runAt(1000), TASK_NONE);   // one run per call, and none until due again
+  CHECK(ran == "ba");
+  // of equal priorities, the one that has waited longest
+  reset(0);
+  s.add("a", taskA, 1000, 2, 10, clk.t);
+  s.add("b", taskB, 500, 2, 10, clk.t);
+  s.add("c", taskC, 300, 1, 10, clk.t);
+  runAt(1000);
+  runAt(1000);
+  runAt(1000);
+  CHECK(ran == "bac");
+}
+
+static void testHeldBack() {
+  reset(0);
+  uint8_t lo = s.add("lo", taskA, 10000, 1, 500, 700);     // due at 10700
+  uint8_t hi = s.add("hi", taskB, 1000, 5, 100, 9800);     // due at 10800
+  CHECK_EQUAL(runAt(10700), TASK_NONE);  // would still be running when hi falls due
+  CHECK_EQUAL(runAt(10800), hi);
+  CHECK_EQUAL(runAt(10800), lo);         // hi's next run is a whole gap away
+  CHECK_EQUAL(s.tasks[lo].worstLate, 100);
+  CHECK_EQUAL(s.tasks[lo].missed, 0);
+  // a task too long to fit between hi's runs gains nothing by waiting
+  reset(0);
+  lo = s.add("lo", taskA, 10000, 1, 950, 700);
+  s.add("hi", taskB, 1000, 5, 100, 9800);
+  CHECK_EQUAL(runAt(10700), lo);
+  // nor does a task held back for a whole period
+  reset(0);
+  lo = s.add("lo", taskA, 2000, 1, 500, 0);                // due at 2000
+  s.add("hi", taskB, 1000, 5, 100, 3300);                  // due at 4300
+  CHECK_EQUAL(runAt(3999), TASK_NONE);
+  CHECK_EQUAL(runAt(4000), lo);
+  CHECK_EQUAL(s.tasks[lo].missed, 1);
+  CHECK_EQUAL(s.tasks[lo].timer.getDeadline(), 6000);      // picks up from now
+}
+
+// the looper's task, with a long period it never waits out; the clock has run a while
+#define PINNED_PERIOD 1000000
+#define T0 10000000
+
+static void testSetDeadline() {
+  reset(T0);
+  uint8_t hi = s.add("hi", taskB, PINNED_PERIOD, 7, 300, T0);
+  uint8_t lo = s.add("lo", taskA, 2000, 1, 500, T0);        // due at T0 + 2000
+  s.setDeadline(hi, T0 + 4300);
+  CHECK_EQUAL(s.nextDeadline(), T0 + 2000);
+  CHECK(s.tasks[hi].pinned);
+  // a pinned deadline holds a task back even when it is a period late
+  CHECK_EQUAL(runAt(T0 + 4000), TASK_NONE);
+  CHECK_EQUAL(runAt(T0 + 4300), hi);
+  CHECK(!s.tasks[hi].pinned);
+  CHECK_EQUAL(s.tasks[hi].timer.getDeadline(), T0 + 4300 + PINNED_PERIOD);
+  CHECK_EQUAL(runAt(T0 + 4300), lo);
+  CHECK_EQUAL(s.tasks[lo].missed, 1);
+  // but not two periods late
+  reset(T0);
+  hi = s.add("hi", taskB, PINNED_PERIOD, 7, 300, T0);
+  lo = s.add("lo", taskA, 2000, 1, 500, T0);
+  s.setDeadline(hi, T0 + 6100);
+  CHECK_EQUAL(runAt(T0 + 5999), TASK_NONE);
+  CHECK_EQUAL(runAt(T0 + 6000), lo);
+  CHECK_EQUAL(s.tasks[lo].missed, 2);
+  // a task can move its own next run
+  reset(T0);
+  selfTask = s.add("self", taskMovesItself, PINNED_PERIOD, 7, 300, T0);
+  s.setDeadline(selfTask, T0 + 1000);
+  CHECK_EQUAL(runAt(T0 + 1000), selfTask);
+  CHECK_EQUAL(s.nextDeadline(), T0 + 1250);
+  CHECK_EQUAL(runAt(T0 + 1249), TASK_NONE);
+  CHECK_EQUAL(runAt(T0 + 1250), selfTask);
+  CHECK(ran == "mm");
+  CHECK_EQUAL(s.tasks[selfTask].missed, 0);
+}
+
+static void testStats() {
+  reset(0);
+  uint8_t n = s.add("slow", taskSlow, 1000, 1, 100, 0);
+  cost = 150;
+  CHECK_EQUAL(runAt(3500), n);           // two deadlines went by
+  CHECK_EQUAL(s.tasks[n].missed, 2);
+  CHECK_EQUAL(s.tasks[n].worstLate, 2500);
+  CHECK_EQUAL(s.tasks[n].overBudget, 1);
+  CHECK_EQUAL(s.tasks[n].worstRun, 150);
+  CHECK_EQUAL(s.nextDeadline(), 4500);
+  cost = 50;
+  CHECK_EQUAL(runAt(4500), n);
+  CHECK_EQUAL(s.tasks[n].runs, 2);
+  CHECK_EQUAL(s.tasks[n].missed, 2);
+  CHECK_EQUAL(s.tasks[n].overBudget, 1);
+  CHECK_EQUAL(s.tasks[n].worstRun, 150);
+  CHECK_EQUAL(s.totalMissed(), 2);
+  CHECK_EQUAL(s.totalOverBudget(), 1);
+  s.resetStats(n);
+  CHECK_EQUAL(s.totalMissed(), 0);
+  CHECK_EQUAL(s.tasks[n].worstRun, 0);
+}
+
+/*
+  Deadlines move on a period at a time, so time spent
+  running doesn't add up: a second of a 1 ms task is a
+  thousand runs, none later than the wait for the higher
+  priority task it was held back for.
+*/
+static void testNoDrift() {
+  reset(0);
+  uint8_t n = s.add("slow", taskSlow, 1000, 1, 100, 0);
+  s.add("a", taskA, 333, 2, 20, 0);
+  cost = 37;
+  while (clk.t < 1000500) {
+    if (s.runNext(clk) == TASK_NONE) {
+      uint64_t next = s.nextDeadline();
+      clk.t = (next > clk.t) ? next : clk.t + 1;
+    } else {
+      clk.t += 3;
+    }
+  }
+  CHECK_EQUAL(s.tasks[n].runs, 1000);
+  CHECK_EQUAL(s.tasks[n].missed, 0);
+  CHECK(s.tasks[n].worstLate <= 100 + 3);
+  CHECK_EQUAL(s.totalMissed(), 0);
+}
+
+int main() {
+  testAdd();
+  testOrder();
+  testHeldBack();
+  testSetDeadline();
+  testStats();
+  testNoDrift();
+  return TEST_RESULT();
+}
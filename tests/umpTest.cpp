@@ -0,0 +1,109 @@
+/*
+  src/ump.h: MIDI 2.0 packets against reference words
+  worked out by hand from the UMP spec (word 0 first, as
+  sent, most significant byte first), the spec's scaling
+  of MIDI 1.0 values, and handing out note numbers.
+*/
+#include "hostTest.h"
+#include "ump.h"
+
+static void checkPacket(const uint32_t* got, uint8_t count, uint32_t w0, uint32_t w1, int line) {
+  if ((count != 2) || (got[0] != w0) || (got[1] != w1)) {
+    printf("%s:%d: packet %08X %08X (%d words), expected %08X %08X\n", __FILE__, line,
+      (unsigned)got[0], (unsigned)got[1], count, (unsigned)w0, (unsigned)w1);
+    testFailures++;
+  }
+}
+#define CHECK_PACKET(words, count, w0, w1) checkPacket(words, count, w0, w1, __LINE__)
+
+static void testPackets() {
+  uint32_t w[2];
+  // 4 = MIDI 2.0 voice, group 0, note on ch 1, note 60, attribute 3 (pitch 7.9); velocity max, pitch 60.0
+  uint8_t n = umpNoteOn(w, 0, 0, 60, 0xFFFF, 60 << 9);
+  CHECK_PACKET(w, n, 0x40903C03, 0xFFFF7800);
+  // group 1, note off ch 3, note 64, no attribute, velocity half
+  n = umpNoteOff(w, 1, 2, 64, 0x8000);
+  CHECK_PACKET(w, n, 0x41824000, 0x80000000);
+  // group 0, per-note pitch bend ch 16, note 61, centre
+  n = umpPerNotePitchBend(w, 0, 15, 61, UMP_PITCH_BEND_CENTER);
+  CHECK_PACKET(w, n, 0x406F3D00, 0x80000000);
+  // out of range fields are masked rather than spilling into their neighbours
+  n = umpNoteOn(w, 0x1F, 0x12, 0xBC, 0x1234, 0x5678);
+  CHECK_PACKET(w, n, 0x4F923C03, 0x12345678);
+}
+
+static void testScaleUp() {
+  CHECK_EQUAL(umpScaleUp(0, 7, 16), 0x0000);
+  CHECK_EQUAL(umpScaleUp(1, 7, 16), 0x0200);
+  CHECK_EQUAL(umpScaleUp(64, 7, 16), 0x8000);     // centre to centre
+  CHECK_EQUAL(umpScaleUp(100, 7, 16), 0xC924);
+  CHECK_EQUAL(umpScaleUp(127, 7, 16), 0xFFFF);    // top to top
+  CHECK_EQUAL(umpScaleUp(8192, 14, 32), 0x80000000UL);
+  CHECK_EQUAL(umpScaleUp(16383, 14, 32), 0xFFFFFFFFUL);
+  CHECK_EQUAL(umpScaleUp(0, 14, 32), 0);
+  // never goes down as the input goes up
+  uint32_t last = 0;
+  for (uint32_t v = 0; v < 128; v++) {
+    uint32_t s = umpScaleUp(v, 7, 16);
+    CHECK(s >= last);
+    last = s;
+  }
+}
+
+static void testPitch() {
+  CHECK_EQUAL(umpPitch79(60, 0, 2), 60 << 9);
+  CHECK_EQUAL(umpPitch79(60, 4096, 2), 61 << 9);              // half the range of 2 semitones
+  CHECK_EQUAL(umpPitch79(60, -8192, 2), 58 << 9);             // the whole range down
+  CHECK_EQUAL(umpPitch79(60, 8191, 48), (60 << 9) + (8191 * 48) / 16);
+  CHECK_EQUAL(umpPitch79(0, -8192, 48), 0);                   // clamped
+  CHECK_EQUAL(umpPitch79(127, 8191, 48), 0xFFFF);
+}
+
+static void testTracker() {
+  umpNoteTracker t(2, 16);
+  uint8_t ch, note;
+  bool seen[17] = {};
+  // empty channels first, so a MIDI 1.0 copy can bend each note on its own
+  for (int i = 0; i < 15; i++) {
+    CHECK(t.claim(60, ch, note));
+    CHECK(ch >= 2 && ch <= 16);
+    CHECK(!seen[ch]);
+    seen[ch] = true;
+    CHECK_EQUAL(note, 60);
+  }
+  // then channels share: 61 is free on every channel
+  CHECK(t.claim(61, ch, note));
+  CHECK_EQUAL(note, 61);
+  // all 15 channels have 60, so the next 60 gets the nearest free number
+  uint8_t ch2, note2;
+  CHECK(t.claim(60, ch2, note2));
+  CHECK((note2 == 59) || (note2 == 61));
+  CHECK(!((ch2 == ch) && (note2 == note)));
+  CHECK(t.isUsed(ch2, note2));
+  t.release(ch2, note2);
+  CHECK(!t.isUsed(ch2, note2));
+  t.release(ch2, note2);                 // twice does no harm
+  t.release(0, 60);                      // nor a bad channel
+  // a freed channel isn't the next one handed out
+  umpNoteTracker r(2, 4);
+  CHECK(r.claim(60, ch, note));
+  CHECK_EQUAL(ch, 2);
+  r.release(ch, note);
+  CHECK(r.claim(62, ch, note));
+  CHECK_EQUAL(ch, 3);
+  // full
+  umpNoteTracker one(5, 5);
+  for (int i = 0; i < 128; i++) {
+    CHECK(one.claim(64, ch, note));
+    CHECK_EQUAL(ch, 5);
+  }
+  CHECK(!one.claim(64, ch, note));
+}
+
+int main() {
+  testPackets();
+  testScaleUp();
+  testPitch();
+  testTracker();
+  return TEST_RESULT();
+}
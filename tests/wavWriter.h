@@ -0,0 +1,62 @@
+/*
+  Writes 16-bit mono WAV files, for the renders: the
+  header is written with the lengths left at 0 and filled
+  in by close(), once the number of samples is known.
+*/
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+
+class wavWriter {
+  public:
+    wavWriter() {
+      f = nullptr;
+      count = 0;
+    }
+    bool open(const char* path, uint32_t sampleRate) {
+      f = fopen(path, "wb");
+      if (!f) return false;
+      count = 0;
+      fwrite("RIFF", 1, 4, f);
+      word32(0);
+      fwrite("WAVEfmt ", 1, 8, f);
+      word32(16);
+      word16(1);                 // PCM
+      word16(1);                 // mono
+      word32(sampleRate);
+      word32(sampleRate * 2);    // bytes per second
+      word16(2);                 // bytes per sample
+      word16(16);
+      fwrite("data", 1, 4, f);
+      word32(0);
+      return true;
+    }
+    void write(int32_t sample) {
+      if (sample > 32767) sample = 32767;
+      if (sample < -32768) sample = -32768;
+      word16((uint16_t)sample);
+      count++;
+    }
+    bool close() {
+      if (!f) return false;
+      fseek(f, 4, SEEK_SET);
+      word32(36 + count * 2);
+      fseek(f, 40, SEEK_SET);
+      word32(count * 2);
+      bool ok = !ferror(f);
+      fclose(f);
+      f = nullptr;
+      return ok;
+    }
+  private:
+    FILE* f;
+    uint32_t count;
+    void word16(uint16_t v) {
+      uint8_t b[2] = { (uint8_t)v, (uint8_t)(v >> 8) };
+      fwrite(b, 1, 2, f);
+    }
+    void word32(uint32_t v) {
+      word16((uint16_t)v);
+      word16((uint16_t)(v >> 16));
+    }
+};
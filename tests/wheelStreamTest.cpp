@@ -0,0 +1,144 @@
+/*
+  src/wheelStream.h: the glide curves start and end where
+  they should and never turn back, a glide gets to its
+  target on time (up or down, along any curve), 14-bit
+  modulation sends its top half only when it changes, and
+  a port's byte budget paces a stream of messages to its
+  rate, lets one send overdraw it, and refills up to the
+  burst and no further.
+*/
+#include "hostTest.h"
+#include "wheelStream.h"
+
+static const uint8_t curves[] = { WHEEL_CURVE_LINEAR, WHEEL_CURVE_EASE, WHEEL_CURVE_SMOOTH };
+
+static void testCurves() {
+  for (uint8_t c : curves) {
+    CHECK_EQUAL(wheelCurve(c, 0), 0);
+    CHECK_EQUAL(wheelCurve(c, WHEEL_CURVE_ONE), WHEEL_CURVE_ONE);
+    CHECK_EQUAL(wheelCurve(c, WHEEL_CURVE_ONE + 5000), WHEEL_CURVE_ONE);
+    uint32_t last = 0;
+    uint32_t backwards = 0;
+    for (uint32_t u = 0; u <= WHEEL_CURVE_ONE; u++) {
+      uint32_t v = wheelCurve(c, u);
+      if ((v < last) || (v > WHEEL_CURVE_ONE)) backwards++;
+      last = v;
+    }
+    CHECK_EQUAL(backwards, 0);
+  }
+  // ease is ahead of linear all the way; smooth is half way at half time
+  CHECK(wheelCurve(WHEEL_CURVE_EASE, WHEEL_CURVE_ONE / 4) > WHEEL_CURVE_ONE / 4);
+  CHECK_EQUAL(wheelCurve(WHEEL_CURVE_SMOOTH, WHEEL_CURVE_ONE / 2), WHEEL_CURVE_ONE / 2);
+  CHECK(wheelCurve(WHEEL_CURVE_SMOOTH, WHEEL_CURVE_ONE / 8) < WHEEL_CURVE_ONE / 8);
+}
+
+// each curve, up and down, read every 4 ms as the wheels task does
+static void testGlide() {
+  const uint64_t start = 1000000;
+  const uint32_t duration = 250000;
+  const int16_t ends[][2] = { { 0, 16383 }, { 8191, -8192 }, { 100, 101 } };
+  for (uint8_t c : curves) {
+    for (auto& e : ends) {
+      wheelGlide g;
+      g.jumpTo(e[0]);
+      CHECK_EQUAL(g.valueAt(start, c), e[0]);
+      g.moveTo(e[0], e[1], start, duration);
+      CHECK_EQUAL(g.target(), e[1]);
+      CHECK_EQUAL(g.valueAt(start, c), e[0]);
+      int16_t last = e[0];
+      uint32_t wrongWay = 0;
+      for (uint64_t t = start; t < start + duration; t += 4000) {
+        int16_t v = g.valueAt(t, c);
+        if ((e[1] > e[0]) ? ((v < last) || (v > e[1])) : ((v > last) || (v < e[1]))) wrongWay++;
+        last = v;
+      }
+      CHECK_EQUAL(wrongWay, 0);
+      CHECK_EQUAL(g.valueAt(start + duration, c), e[1]);
+      CHECK_EQUAL(g.valueAt(start + 10 * duration, c), e[1]);
+    }
+  }
+  // a new move starts from wherever the last one had got to
+  wheelGlide g;
+  g.moveTo(0, 16000, 0, 100000);
+  int16_t halfway = g.valueAt(50000, WHEEL_CURVE_LINEAR);
+  CHECK_EQUAL(halfway, 8000);
+  g.moveTo(halfway, 0, 50000, 100000);
+  CHECK_EQUAL(g.valueAt(50000, WHEEL_CURVE_LINEAR), 8000);
+  CHECK_EQUAL(g.valueAt(150000, WHEEL_CURVE_LINEAR), 0);
+  // no duration is a jump
+  g.moveTo(0, 5000, 200000, 0);
+  CHECK_EQUAL(g.valueAt(200000, WHEEL_CURVE_EASE), 5000);
+}
+
+static void testCC14() {
+  CHECK_EQUAL(cc14Parts(CC14_NEVER_SENT, 0), CC14_MSB);
+  CHECK_EQUAL(cc14Parts(CC14_NEVER_SENT, 0x1234), CC14_MSB | CC14_LSB);
+  CHECK_EQUAL(cc14Parts(0x1234, 0x1234), 0);
+  CHECK_EQUAL(cc14Parts(0x1234, 0x1235), CC14_LSB);           // same top half
+  CHECK_EQUAL(cc14Parts(0x1235, 0x1200), CC14_LSB);
+  CHECK_EQUAL(cc14Parts(0x1234, 0x1280), CC14_MSB);           // the receiver zeroes the bottom half itself
+  CHECK_EQUAL(cc14Parts(0x1234, 0x1281), CC14_MSB | CC14_LSB);
+  CHECK_EQUAL(cc14Bytes(0), 0);
+  CHECK_EQUAL(cc14Bytes(CC14_LSB), 3);
+  CHECK_EQUAL(cc14Bytes(CC14_MSB | CC14_LSB), 6);
+  // a sweep over the whole range sends the top half once per change of it
+  int16_t sent = CC14_NEVER_SENT;
+  uint32_t msb = 0;
+  uint32_t lsb = 0;
+  for (int16_t v = 0; v <= 16383; v++) {
+    uint8_t parts = cc14Parts(sent, v);
+    if (parts & CC14_MSB) msb++;
+    if (parts & CC14_LSB) lsb++;
+    sent = v;
+  }
+  CHECK_EQUAL(msb, 128);
+  CHECK_EQUAL(lsb, 16384 - 128);
+}
+
+#define RATE 800        // bytes a second, as the sketch gives the serial port
+#define BURST 12
+
+static void testBudget() {
+  byteBudget b(RATE, BURST);
+  // the burst, then one send that overdraws it, then nothing
+  CHECK(b.spend(0, 6));
+  CHECK(b.spend(0, 6));
+  CHECK(b.spend(0, 6));
+  CHECK(!b.spend(0, 3));
+  // 6 bytes of debt take 7.5 ms to pay off
+  CHECK(!b.spend(7499, 3));
+  CHECK(b.spend(7500, 3));
+  // a clock read a moment earlier doesn't refill or break it
+  CHECK(!b.spend(7000, 3));
+  // a message that can't wait goes into debt, and the wheels wait longer for it
+  b.charge(7500, 6);
+  CHECK(!b.spend(7500 + 3750 + 7499, 3));
+  CHECK(b.spend(7500 + 3750 + 7500, 3));
+  // a long rest refills only up to the burst
+  byteBudget rested(RATE, BURST);
+  CHECK(rested.spend(0, BURST));
+  uint32_t sends = 0;
+  while (rested.spend(10000000, 1)) sends++;
+  CHECK_EQUAL(sends, BURST + 1);
+}
+
+// a wheel moving all the time, offered a 3 byte message every 100 us for ten seconds
+static void testPacing() {
+  byteBudget b(RATE, BURST);
+  uint32_t bytes = 0;
+  uint64_t t = 0;
+  for (; t <= 10000000; t += 100) {
+    if (b.spend(t, 3)) bytes += 3;
+  }
+  uint32_t expected = RATE * 10 + BURST;
+  CHECK((bytes >= expected - 3) && (bytes <= expected + 3));
+}
+
+int main() {
+  testCurves();
+  testGlide();
+  testCC14();
+  testBudget();
+  testPacing();
+  return TEST_RESULT();
+}
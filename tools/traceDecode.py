@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+"""
+  Decoder for HexBoard event traces (see src/traceRecorder.h).
+
+  Usage:
+    python3 traceDecode.py trace.bin              # text timeline
+    python3 traceDecode.py trace.bin --chrome out.json
+                                                  # for chrome://tracing or ui.perfetto.dev
+
+  The input can be the /trace.bin file saved on the board, or a raw
+  capture of the serial port after selecting "Send trace"; anything
+  before the "HXTR" header (e.g. log text) is skipped.
+"""
+import argparse
+import json
+import struct
+import sys
+
+EVENT_NAMES = {
+    1: "press", 2: "release", 3: "midi on", 4: "midi off",
+    5: "ch alloc", 6: "ch free", 7: "voice on", 8: "voice off",
+    9: "wheel", 10: "mark", 11: "dropped",
+}
+WHEEL_NAMES = {0: "mod", 1: "pitch bend", 2: "velocity"}
+DROPPED_NAMES = {0: "no MPE channel", 1: "no synth voice", 2: "arpeggiator full"}
+
+
+def parse(data):
+    start = data.find(b"HXTR")
+    if start < 0:
+        sys.exit("no trace header found")
+    version, rings, ringSize, dumpTime = struct.unpack_from("<BBHQ", data, start + 4)
+    if version != 1:
+        sys.exit("unsupported trace format version %d" % version)
+    pos = start + 16
+    events = []
+    for core in range(rings):
+        total, count = struct.unpack_from("<II", data, pos)
+        pos += 8
+        for _ in range(count):
+            t, kind, a, b = struct.unpack_from("<IBBh", data, pos)
+            pos += 8
+            events.append((t, core, kind, a, b))
+    # timestamps are the low 32 bits of the microsecond timer;
+    # unwrap them relative to the time of the dump
+    dumpLow = dumpTime & 0xFFFFFFFF
+    unwrapped = []
+    for t, core, kind, a, b in events:
+        age = (dumpLow - t) & 0xFFFFFFFF
+        unwrapped.append((dumpTime - age, core, kind, a, b))
+    unwrapped.sort(key=lambda e: e[0])
+    return unwrapped
+
+
+def describe(kind, a, b):
+    if kind in (1, 2):
+        return "hex %d" % a
+    if kind in (3, 4):
+        return "note %d ch %d vel %d" % (a, (b >> 8) & 0xFF, b & 0xFF)
+    if kind in (5, 6):
+        return "ch %d hex %d" % (a, b)
+    if kind in (7, 8):
+        return "voice %d hex %d" % (a, b)
+    if kind == 9:
+        return "%s = %d" % (WHEEL_NAMES.get(a, str(a)), b)
+    if kind == 11:
+        return "%s, hex %d" % (DROPPED_NAMES.get(a, str(a)), b)
+    return "a=%d b=%d" % (a, b)
+
+
+def timeline(events):
+    if not events:
+        return
+    t0 = events[0][0]
+    for t, core, kind, a, b in events:
+        print("%12.3f ms  core%d  %-9s %s" % ((t - t0) / 1000.0, core + 1,
+              EVENT_NAMES.get(kind, "type %d" % kind), describe(kind, a, b)))
+
+
+def chrome(events):
+    out = []
+    open_spans = {}
+    spans = {1: ("keys", 2), 3: ("MIDI", 4), 7: ("synth", 8)}   # begin kind -> (track, end kind)
+    ends = {end: (begin, track) for begin, (track, end) in spans.items()}
+    def key(begin, a, b):   # the same MIDI note can sound on several channels at once
+        return (begin, a, (b >> 8) & 0xFF if begin == 3 else 0)
+    for t, core, kind, a, b in events:
+        if kind in spans:
+            open_spans[key(kind, a, b)] = (t, b)
+        elif kind in ends:
+            begin, track = ends[kind]
+            if key(begin, a, b) in open_spans:
+                t0, b0 = open_spans.pop(key(begin, a, b))
+                out.append({"name": describe(begin, a, b0), "cat": track, "ph": "X",
+                            "ts": t0, "dur": t - t0, "pid": 1, "tid": track})
+        else:
+            out.append({"name": EVENT_NAMES.get(kind, "type %d" % kind), "cat": "event",
+                        "ph": "i", "s": "t", "ts": t, "pid": 1, "tid": "core%d" % (core + 1),
+                        "args": {"detail": describe(kind, a, b)}})
+    for (kind, a, _), (t0, b0) in open_spans.items():   # still held when the trace was taken
+        out.append({"name": describe(kind, a, b0) + " (held)", "cat": spans[kind][0], "ph": "B",
+                    "ts": t0, "pid": 1, "tid": spans[kind][0]})
+    return {"traceEvents": out, "displayTimeUnit": "ms"}
+
+
+def main():
+    p = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    p.add_argument("trace")
+    p.add_argument("--chrome", metavar="JSON", help="write Chrome trace event JSON to this file")
+    args = p.parse_args()
+    with open(args.trace, "rb") as f:
+        events = parse(f.read())
+    if args.chrome:
+        with open(args.chrome, "w") as f:
+            json.dump(chrome(events), f)
+    else:
+        timeline(events)
+
+
+if __name__ == "__main__":
+    main()